@@ -4,19 +4,89 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include "config.h"
+#include "checksum.h"
+
+typedef enum buf_pool_id //缓冲池编号
+{
+    BUF_POOL_MTU,   // MTU级缓冲池，容量BUF_MTU_SIZE
+    BUF_POOL_JUMBO, // 巨型缓冲池，容量BUF_MAX_LEN
+    BUF_POOL_NUM,   // 缓冲池数量
+} buf_pool_id_t;
+
+typedef struct buf_block //缓冲池中的一块数据区，数据紧随其后
+{
+    struct buf_block *next; // 空闲链表中的下一块
+    uint32_t ref;           // 引用计数，共享该块的buf数量
+    struct buf_pool *pool;  // 所属缓冲池
+} buf_block_t;
+
+typedef enum buf_csum //数据包的校验和状态
+{
+    BUF_CSUM_NONE,        // 接收时未经校验，发送时校验和已填好
+    BUF_CSUM_UNNECESSARY, // 接收时驱动已校验过全部校验和，各层无需再校验
+    BUF_CSUM_PARTIAL,     // 发送时校验和待驱动填写，该处已存放伪头部的累加和
+} buf_csum_t;
 
 typedef struct buf //协议栈的通用数据包buffer, 可以在头部装卸数据，以供协议头的添加和去除
 {
-    size_t len;                   // 包中有效数据大小
-    uint8_t *data;                // 包的数据起始地址
-    uint8_t payload[BUF_MAX_LEN]; // 最大负载数据量
+    size_t len;          // 包中有效数据大小
+    uint8_t *data;       // 包的数据起始地址
+    uint8_t *payload;    // 数据区起始地址
+    size_t size;         // 数据区容量
+    buf_block_t *block;  // 数据区所属的缓冲池块，NULL表示外部提供的数据区，多个buf可共享同一块
+    struct buf *next;    // 链式buffer的下一段，NULL表示最后一段
+    uint8_t csum;        // 校验和状态，见buf_csum_t，链式buffer以第一段为准
+    uint16_t csum_offset;// BUF_CSUM_PARTIAL时，校验和字段相对csum_start的偏移
+    uint32_t csum_start; // BUF_CSUM_PARTIAL时，从data起算的校验和计算起点，增删头部时随之调整
 } buf_t;
 
+typedef struct buf_pool_stats //缓冲池统计信息
+{
+    size_t size;      // 每个buf的容量
+    size_t total;     // buf总数
+    size_t in_use;    // 正在使用的buf数
+    size_t peak;      // 使用数峰值
+    size_t allocs;    // 累计分配次数
+    size_t exhausted; // 因池耗尽而分配失败的次数
+} buf_pool_stats_t;
+
+typedef struct buf_pool //缓冲池，每个池由一段预分配的连续内存切分为等长的块，用空闲链表管理
+{
+    buf_block_t *free;      // 空闲链表头
+    uint8_t *arena;         // 预分配的内存
+    size_t stride;          // 相邻两块的间距
+    buf_pool_stats_t stats; // 统计信息
+} buf_pool_t;
+
+#define BUF_INITIALIZER(storage) {0, (storage), (storage), sizeof(storage), NULL, NULL} //用静态数组初始化buf
+#define BUF_VIEW(ptr, n) {(n), (uint8_t *)(ptr), (uint8_t *)(ptr), (n), NULL, NULL}    //引用一段外部数据的buf，不拷贝
+
 int buf_init(buf_t *buf, size_t len);
 int buf_add_header(buf_t *buf, size_t len);
 int buf_remove_header(buf_t *buf, size_t len);
 int buf_add_padding(buf_t *buf, size_t len);
 int buf_remove_padding(buf_t *buf, size_t len);
 void buf_copy(void *pdst, const void *psrc, size_t len);
+int buf_clone(buf_t *dst, const buf_t *src);
+int buf_cow(buf_t *buf);
+size_t buf_chain_len(const buf_t *buf);
+int buf_slice(const buf_t *buf, size_t offset, size_t len, buf_t *segs, size_t max);
+int buf_linearize(buf_t *buf);
+size_t buf_gather(const buf_t *buf, uint8_t *dst);
+uint16_t buf_checksum16(const buf_t *buf);
+void buf_checksum_add(checksum_ctx_t *ctx, const buf_t *buf);
+void buf_checksum_partial(buf_t *buf, size_t start, size_t offset);
+int buf_checksum_complete(buf_t *buf);
+size_t buf_gather_complete(const buf_t *buf, uint8_t *dst);
+void buf_pool_init();
+int buf_pool_create(buf_pool_t *pools);
+void buf_pool_destroy(buf_pool_t *pools);
+void buf_pool_use(buf_pool_t *pools);
+buf_pool_t *buf_pool_current(buf_pool_id_t id);
+int buf_alloc_pool(buf_t *buf, buf_pool_id_t id, size_t len);
+int buf_alloc(buf_t *buf, size_t len);
+void buf_free(void *pbuf);
+void buf_pool_stats(buf_pool_id_t id, buf_pool_stats_t *stats);
+void buf_pool_print();
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,48 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum checksum_impl //校验和的实现
+{
+    CHECKSUM_SCALAR, // 逐字累加，所有平台可用
+    CHECKSUM_SSE2,   // 128位向量累加
+    CHECKSUM_AVX2,   // 256位向量累加
+    CHECKSUM_IMPL_NUM,
+} checksum_impl_t;
+
+typedef struct checksum_ctx //分段累加的校验和上下文
+{
+    uint64_t sum;  // 已累加的和，未折叠
+    size_t offset; // 已累加的字节数，奇数时下一段的字节在16位字中的位置互换
+} checksum_ctx_t;
+
+uint16_t checksum16(uint16_t *data, size_t len);
+void checksum_init(checksum_ctx_t *ctx);
+void checksum_add(checksum_ctx_t *ctx, const void *data, size_t len);
+void checksum_add_copy(checksum_ctx_t *ctx, void *dst, const void *src, size_t len);
+void checksum_merge(checksum_ctx_t *ctx, const checksum_ctx_t *part);
+void checksum_pseudo(checksum_ctx_t *ctx, const uint8_t *src_ip, const uint8_t *dst_ip, uint8_t protocol, uint16_t len);
+uint16_t checksum_finish(checksum_ctx_t *ctx);
+uint64_t checksum_sum(const void *data, size_t len);
+uint64_t checksum_copy(void *dst, const void *src, size_t len);
+int checksum_impl_supported(checksum_impl_t impl);
+int checksum_select(checksum_impl_t impl);
+checksum_impl_t checksum_current();
+const char *checksum_impl_name(checksum_impl_t impl);
+
+/**
+ * @brief 把累加和折叠为16位反码和，不取反
+ *
+ * @param sum 累加和
+ * @return uint16_t 16位反码和
+ */
+static inline uint16_t checksum_fold(uint64_t sum)
+{
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)sum;
+}
+
+#endif
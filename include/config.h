@@ -8,6 +8,7 @@
 #define UDP
 #define TCP
 #define HTTP
+// #define NET_STATIC_DISPATCH //协议分发直接调用上面启用的协议的处理程序，而非经由注册的函数指针
 
 
 #ifdef TEST
@@ -34,12 +35,71 @@
 
 #define ETHERNET_MAX_TRANSPORT_UNIT 1500 //以太网最大传输单元
 
+#define DRIVER_DEFAULT "pcap"   //未用driver_select选择时使用的网卡后端
+#define DRIVER_MEMORY_SLOTS 256 //内存网卡收发队列的槽数，须为2的幂
+// #define DRIVER_IF_NAME "veth0" //定义时packet、xdp与uring-packet后端直接使用该网卡，否则按ip选择同网段的网卡
+#define DRIVER_PACKET_BLOCK_SIZE (1 << 18) //packet后端收发环每块的字节数，须为页大小的整数倍
+#define DRIVER_PACKET_FRAME_SIZE 2048      //packet后端发送环每帧的字节数，须整除块大小
+#define DRIVER_PACKET_RX_BLOCKS 64         //packet后端接收环的块数
+#define DRIVER_PACKET_TX_BLOCKS 4          //packet后端发送环的块数
+#define DRIVER_PACKET_BLOCK_TOV_MS 1       //接收块未满时交给用户的超时（毫秒），决定低负载时的延迟
+#define DRIVER_XDP_QUEUE 0                 //xdp后端绑定的网卡接收队列，其他队列的帧仍交给内核
+#define DRIVER_XDP_FILL_SIZE 512           //xdp后端填充环与接收环的大小，即交给内核待接收的缓冲池块数，须为2的幂
+#define DRIVER_XDP_TX_FRAMES 64            //xdp后端发送环与完成环的大小，即预留作发送帧的缓冲池块数，须为2的幂
+#define DRIVER_TAP_NAME "tap0"             //tap后端打开的网卡名，不存在时创建
+#define DRIVER_TAP_QUEUES 4                //tap后端的队列数，大于1时使用多队列TAP，每个发送线程固定用一个队列
+// #define DRIVER_TAP_HOST_IP "10.0.0.1"      //定义时为内核一侧的tap网卡配置该地址，应与本机ip同网段
+#define DRIVER_TAP_HOST_MASK "255.255.255.0" //内核一侧tap网卡的子网掩码
+#define DRIVER_URING_RX_BUFS 256           //uring后端交给内核待接收的缓冲池块数，须为2的幂
+#define DRIVER_URING_TX_SLOTS 64           //uring后端预留作发送的缓冲池块数，即同时在途的发送数，须为2的幂
+// #define DRIVER_URING_SQPOLL             //定义时由内核线程轮询提交队列，稳态收发不需要系统调用，但多占一个CPU
+
+#define NET_BURST 32 //一次轮询最多接收的帧数，各层按组批量处理
+#define NET_TIMER_MAX 16 //协议栈定时器的最大个数
+
+#define LOOP_FD_MAX 16 //事件循环可监听的应用文件描述符个数
+#define LOOP_POLL_MS 1 //驱动没有可等待的文件描述符时，事件循环的轮询间隔（毫秒）
+// #define LOOP_BUSY_POLL_CPU 3 //定义时主循环绑定到该CPU并忙轮询，不再休眠等待事件
+#define LOOP_LATENCY_US 50      //忙轮询空闲退避时允许增加的最大延迟（微秒）
+#define LOOP_PAUSE_SPINS 64     //忙轮询退避的第二阶段，每轮执行的pause指令数
+#define LOOP_REPORT_SEC 10      //忙轮询时报告忙闲比的周期（秒）
+
+// #define RSS_WORKERS 4 //定义时主线程只收包，按流哈希把帧分给该数量的工作线程，各自运行一个协议栈实例
+#define RSS_WORKER_MAX 64   //工作线程的最大个数
+#define RSS_RING_SIZE 64    //收包线程到每个工作线程的队列槽数，须为2的幂，在途的帧占用收包线程的缓冲池
+#define RSS_RETA_SIZE 128   //哈希值到工作线程的重定向表大小，须为2的幂
+#define RSS_IDLE_SPINS 1024 //工作线程队列空时先自旋的轮数，之后每轮让出CPU
+
+#define RING_COMMIT_SPINS 256 //多生产者等待先预留者提交时先自旋的轮数，之后每轮让出CPU
+// #define PIPELINE //定义时收包、协议处理与应用处理分别在主线程、协议线程与应用线程中进行
+#define PIPELINE_RING_SIZE 256   //流水线各级之间的队列槽数，须为2的幂
+#define PIPELINE_PENDING_MAX 64  //每个连接在途（已发出、协议线程尚未完成）的应用命令数上限
+#define PIPELINE_PORT_MAX 8      //流水线模式下监听的tcp端口数
+#define PIPELINE_WRITE_CHUNK 512 //协议线程每次写入tcp发送缓存的最大长度
+#define PIPELINE_IDLE_SPINS 1024 //协议线程与应用线程空闲时先自旋的轮数，之后每轮让出CPU
+
+#if defined(PIPELINE) && defined(RSS_WORKERS)
+#error "PIPELINE and RSS_WORKERS cannot be defined at the same time"
+#endif
+
 #define ARP_TIMEOUT_SEC (60 * 5) //arp表过期时间
 #define ARP_MIN_INTERVAL 1       //向相同地址发送arp请求的最小间隔
+#define ARP_AGING_MS 1000        //arp老化定时器的周期（毫秒），回收超时的arp表项与等待回应超时的数据包
 
 #define IP_DEFALUT_TTL 64 //IP默认TTL
 
-#define BUF_MAX_LEN (2 * UINT16_MAX + UINT8_MAX) //buf最大长度
+#define TCP_MAX_CONNECT 16 //tcp同时存在的最大连接数，超出时按LRU淘汰，巨型缓冲池按此预留收发缓存
+
+#define BUF_MAX_LEN (2 * UINT16_MAX + UINT8_MAX) //buf最大长度，即巨型buf的容量
+#define BUF_HEADROOM 128                         //buf头部预留空间，用于添加eth/ip/tcp等协议头
+#define BUF_MTU_SIZE 2048                        //MTU级buf的容量，可容纳预留空间与一个完整以太网帧
+#define BUF_POOL_MTU_NUM 1024                    //MTU级缓冲池的buf数量，xdp与uring后端的接收与发送帧也从中预留
+#define BUF_POOL_JUMBO_NUM (2 * TCP_MAX_CONNECT + 8) //巨型缓冲池的buf数量，每个tcp连接的收发缓存占2个，其余用于大数据报
+#define BUF_CHAIN_MAX 8                          //一个ip分片最多引用的buf段数
+#define BUF_COPYBREAK 256                        //不超过该长度的负载直接拷贝，超过则以链式buf引用
 
-#define MAP_MAX_LEN (16 * BUF_MAX_LEN) //map最大长度
+#define MAP_MAX_LEN (16 * BUF_MAX_LEN) //map默认的内存预算（字节），可用map_set_budget单独调整
+#define MAP_INIT_SIZE 8                //map首次插入时分配的容量，此后按2倍增长直至预算
+#define MAP_BATCH_MAX 64               //map_get_batch一趟处理的键数
+#define MAP_EVICT_SCAN 8               //淘汰时从淘汰链表头部起查找可直接淘汰的键值对的个数
 #endif
\ No newline at end of file
@@ -6,8 +6,56 @@
 #ifndef PCAP_BUF_SIZE
 #define PCAP_BUF_SIZE 1024
 #endif
+
+/**
+ * @brief 网卡后端的操作表，各后端的私有数据存放在net_stack->driver中，
+ *        各函数作用于当前协议栈实例，经由下面的driver_*函数调用
+ *        recv_burst收到的buf可以不拷贝地引用网卡的内存（block为NULL），只在下一次recv_burst之前有效
+ */
+typedef struct driver_ops
+{
+    const char *name;                         // 后端名，driver_select按名选择
+    int (*open)();                            // 打开网卡，成功为0，失败为-1
+    int (*recv_burst)(buf_t *bufs, int n);    // 接收最多n个数据包到新分配的buf中，返回收到的个数，错误为-1
+    int (*send_burst)(buf_t **bufs, int n);   // 发送一组数据包，返回发送成功的个数，buf仍归调用者
+    void (*flush)();                          // 通知网卡发送send_burst暂存的数据包，NULL表示send_burst立即发送
+    int (*get_fd)();                          // 可等待数据包到达的文件描述符，不支持为-1
+    int (*caps)();                            // 校验和卸载能力，NET_CAP_*的组合
+    int (*mtu)();                             // 能收发的最大ip数据包长度
+    void (*close)();                          // 关闭网卡
+} driver_ops_t;
+
+extern const driver_ops_t driver_pcap;
+extern const driver_ops_t driver_memory;
+#ifdef __linux__
+extern const driver_ops_t driver_packet;
+extern const driver_ops_t driver_xdp;
+extern const driver_ops_t driver_tap;
+extern const driver_ops_t driver_uring_tap;
+extern const driver_ops_t driver_uring_packet;
+#endif
+
+const driver_ops_t *driver_lookup(const char *name);
+int driver_select(const char *name);
+const char *driver_name();
 int driver_open();
 int driver_recv(buf_t *buf);
+int driver_recv_burst(buf_t *bufs, int n);
+int driver_recv_burst_pooled(buf_t *bufs, int n);
 int driver_send(buf_t *buf);
+int driver_send_burst(buf_t **bufs, int n);
+void driver_flush();
+int driver_caps();
+int driver_mtu();
+int driver_get_fd();
 void driver_close();
-#endif
\ No newline at end of file
+
+int driver_memory_inject(net_stack_t *stack, const void *frame, size_t len);
+size_t driver_memory_take(net_stack_t *stack, void *frame, size_t size);
+#ifdef __linux__
+int driver_find_if(uint8_t *ip, char *if_name);
+int driver_packet_filter(int fd);
+int driver_tap_queue(const char *name);
+int driver_tap_up(const char *name, int *mtu);
+#endif
+#endif
@@ -7,5 +7,6 @@
 
 int http_server_open(uint16_t port);
 void http_server_run(void);
+int http_server_pending(void);
 
 #endif
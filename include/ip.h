@@ -25,6 +25,7 @@ typedef struct ip_hdr
 #define IP_VERSION_4 4             //ipv4
 #define IP_MORE_FRAGMENT (1 << 13) //ip分片mf位
 void ip_in(buf_t *buf, uint8_t *src_mac);
+void ip_in_burst(buf_t **bufs, uint8_t **src_macs, int n);
 void ip_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol);
 void ip_init();
 #endif
\ No newline at end of file
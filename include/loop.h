@@ -0,0 +1,25 @@
+#ifndef LOOP_H
+#define LOOP_H
+
+#include "net.h"
+
+typedef void (*loop_handler_t)(int fd, void *arg);
+
+typedef struct loop_stats //事件循环的忙闲统计
+{
+    uint64_t elapsed_ns; // 统计的总时长
+    uint64_t busy_ns;    // 其中处理数据包、定时器与应用事件的时长，其余为空闲
+    uint64_t polls;      // 轮询协议栈的次数
+    uint64_t sleeps;     // 休眠的次数
+} loop_stats_t;
+
+int loop_init();
+int loop_add_fd(int fd, loop_handler_t handler, void *arg);
+int loop_del_fd(int fd);
+int loop_run_once(int max_wait_ms);
+int loop_pin_cpu(int cpu);
+void loop_set_busy_poll(uint64_t latency_us);
+void loop_get_stats(loop_stats_t *stats, int reset);
+void loop_report(void *arg);
+void loop_close();
+#endif
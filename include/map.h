@@ -3,28 +3,203 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include "config.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 typedef void (*map_constuctor_t)(void *dst, const void *src, size_t len);
+typedef void (*map_destructor_t)(void *value);
 typedef void (*map_entry_handler_t)(void *key, void *value, time_t *timestamp);
+typedef int (*map_evict_check_t)(void *key, void *value);    //返回非0表示该键值对可直接淘汰，无需通知其持有者
+typedef void (*map_evict_handler_t)(void *key, void *value); //淘汰仍在使用的键值对前调用，在析构之前通知其持有者
 
-typedef struct map //协议栈的通用泛型map，即键值对的容器，支持超时时间与非平凡值类型
+typedef enum map_policy //map已满时的淘汰策略
+{
+    MAP_EVICT_REFUSE, //只回收已超时的键值对，否则拒绝插入
+    MAP_EVICT_LRU,    //淘汰最久未访问的键值对
+    MAP_EVICT_OLDEST, //淘汰更新时间最早的键值对
+} map_policy_t;
+
+#define MAP_CHUNK_NUM 32 //键值对数组的最大段数，第0段容纳MAP_INIT_SIZE个，此后第k段容纳MAP_INIT_SIZE<<(k-1)个
+
+typedef struct map_bucket //哈希索引的桶
+{
+    uint32_t hash; //键的哈希值
+    uint32_t slot; //键值对的物理位置加1，0为空桶，UINT32_MAX为已删除
+} map_bucket_t;
+
+typedef struct map //协议栈的通用泛型map，即键值对的容器，支持超时时间与非平凡值类型，以开放寻址哈希表索引
 {
     size_t key_len;                    //键的长度
     size_t value_len;                  //值的长度
     size_t size;                       //当前大小
-    size_t max_size;                   //最大容量
+    size_t max_size;                   //最大容量，由构造参数与内存预算共同决定
+    size_t size_limit;                 //构造时指定的容量上限，0为不限
+    size_t capacity;                   //当前已分配的容量
+    size_t budget;                     //内存预算（字节）
     time_t timeout;                    //超时时间，0为永不超时
     map_constuctor_t value_constuctor; //形如memcpy的值构造函数，用于拷贝非平凡数据结构到容器中，如buf_copy
-    uint8_t data[MAP_MAX_LEN];         //数据
+    map_destructor_t value_destructor; //值析构函数，在值被删除、覆盖或超时回收时调用，如buf_free，可为NULL
+    size_t used;                       //已使用过的物理位置数，遍历只需扫描到此处
+    size_t free_num;                   //空闲位置栈中的位置数
+    size_t bucket_num;                 //哈希索引的桶数，为2的幂
+    size_t tombstones;                 //哈希索引中已删除桶的数量
+    uint8_t *chunks[MAP_CHUNK_NUM];    //键值对数组，按段在堆上分配，扩容只追加新段，已有的键值对不会移动
+    map_bucket_t *buckets;             //哈希索引，堆上分配
+    uint32_t *free_slots;              //被删除后可复用的物理位置栈，堆上分配
+    map_policy_t policy;               //淘汰策略
+    size_t evictions;                  //淘汰的未超时键值对数量
+    map_evict_check_t evict_check;     //判断键值对可否直接淘汰，为NULL则都不可
+    map_evict_handler_t evict_handler; //淘汰仍在使用的键值对前的回调，可为NULL
+    uint32_t *list_prev, *list_next;   //按物理位置索引的侵入式淘汰链表，头部最先淘汰
+    uint32_t list_head, list_tail;     //淘汰链表的头尾
 } map_t;
 
-void map_init(map_t *map, size_t key_len, size_t value_len, size_t max_len, time_t timeout, map_constuctor_t value_constuctor);
+/**
+ * @brief 第pos个物理位置的键值对，布局为[键][值][更新时间]
+ *
+ * @param map 所属map
+ * @param pos 位置，小于已分配的容量
+ * @return uint8_t* 键值对指针
+ */
+static inline uint8_t *map_entry_at(const map_t *map, size_t pos)
+{
+    size_t n = pos / MAP_INIT_SIZE;
+    unsigned k = n ? 64 - __builtin_clzll(n) : 0;
+    size_t base = k ? (size_t)MAP_INIT_SIZE << (k - 1) : 0;
+    return map->chunks[k] + (pos - base) * (map->key_len + map->value_len + sizeof(time_t));
+}
+
+void map_init(map_t *map, size_t key_len, size_t value_len, size_t max_size, time_t timeout, map_constuctor_t value_constuctor, map_destructor_t value_destructor);
 size_t map_size(map_t *map);
 void *map_get(map_t *map, const void *key);
+size_t map_get_batch(map_t *map, const void *const *keys, size_t n, void **values);
 int map_set(map_t *map, const void *key, const void *value);
 void map_delete(map_t *map, const void *key);
 void map_foreach(map_t *map, map_entry_handler_t handler);
+size_t map_expire(map_t *map);
+void map_set_policy(map_t *map, map_policy_t policy);
+void map_set_evict_handler(map_t *map, map_evict_check_t check, map_evict_handler_t handler);
+size_t map_evictions(map_t *map);
+int map_set_budget(map_t *map, size_t budget);
+size_t map_memory(map_t *map);
+void map_free(map_t *map);
+void *map_bucket_hit(map_t *map, map_bucket_t *bucket);
+
+/**
+ * @brief 长度不超过8字节的键的哈希值，键按内存中的字节装入整数，与map_hash对同一键的结果一致
+ *
+ * @param key 键的字节装入的整数
+ * @param len 键的长度
+ * @return uint32_t 哈希值
+ */
+static inline uint32_t map_hash_word(uint64_t key, size_t len)
+{
+    uint64_t h = (0x9E3779B97F4A7C15ULL ^ len ^ key) * 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return (uint32_t)h;
+}
+
+/**
+ * @brief 一次比较从第i个桶开始的一组桶的哈希值，SSE2下一组为4个桶，否则为1个
+ *
+ * @param map 所属map
+ * @param i 起始桶
+ * @param hash 要比较的哈希值
+ * @param step 输出，探测序列需要继续时为本组的桶数，遇到空桶则为0
+ * @return unsigned 哈希值相同的有效桶，第b个桶对应第2b位，只包含第一个空桶之前的桶
+ */
+static inline unsigned map_group_match(const map_t *map, size_t i, uint32_t hash, size_t *step)
+{
+#ifdef __SSE2__
+    if (i + 4 <= map->bucket_num)
+    {
+        // 每个桶是[hash, slot]两个32位字，两次加载覆盖4个桶，偶数位是hash，奇数位是slot
+        __m128i lo = _mm_loadu_si128((const __m128i *)&map->buckets[i]);
+        __m128i hi = _mm_loadu_si128((const __m128i *)&map->buckets[i + 2]);
+        __m128i h = _mm_set1_epi32((int)hash), zero = _mm_setzero_si128(), ones = _mm_set1_epi32(-1);
+        unsigned eq = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lo, h))) |
+                      _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(hi, h))) << 4;
+        unsigned empty = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lo, zero))) |
+                         _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(hi, zero))) << 4;
+        unsigned deleted = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lo, ones))) |
+                           _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(hi, ones))) << 4;
+        unsigned match = eq & ~((empty | deleted) >> 1) & 0x55;
+        empty = (empty >> 1) & 0x55;
+        *step = 4;
+        if (empty)
+        {
+            match &= (empty & -empty) - 1;
+            *step = 0;
+        }
+        return match;
+    }
+#endif
+    const map_bucket_t *bucket = &map->buckets[i];
+    *step = bucket->slot != 0;
+    return bucket->slot != 0 && bucket->slot != UINT32_MAX && bucket->hash == hash;
+}
+
+/**
+ * @brief 生成定长整数键的map特化版本，键以整数传入，查找时内联哈希并以整数比较键
+ *        生成的函数操作普通的map_t，要求其key_len等于sizeof(type)，可与通用接口混用
+ *
+ * @param name 函数名前缀
+ * @param type 键的整数类型
+ */
+#define MAP_DEFINE_FIXED(name, type)                                                               \
+    static inline type name##_key(const void *p)                                                   \
+    {                                                                                              \
+        type key;                                                                                  \
+        memcpy(&key, p, sizeof(type));                                                             \
+        return key;                                                                                \
+    }                                                                                              \
+    static inline map_bucket_t *name##_find(map_t *map, type key)                                  \
+    {                                                                                              \
+        if (map->bucket_num == 0)                                                                  \
+            return NULL;                                                                           \
+        uint32_t hash = map_hash_word(key, sizeof(type));                                          \
+        size_t mask = map->bucket_num - 1;                                                         \
+        size_t i = hash & mask, step;                                                              \
+        map_bucket_t *home = &map->buckets[i]; /* 装载因子不超过0.5，多数键在首个桶命中 */         \
+        if (home->slot == 0)                                                                       \
+            return NULL;                                                                           \
+        if (home->hash == hash && home->slot != UINT32_MAX &&                                      \
+            name##_key(map_entry_at(map, home->slot - 1)) == key)                                  \
+            return home;                                                                           \
+        for (i = (i + 1) & mask;; i = (i + step) & mask)                                           \
+        {                                                                                          \
+            for (unsigned match = map_group_match(map, i, hash, &step); match; match &= match - 1) \
+            {                                                                                      \
+                map_bucket_t *bucket = &map->buckets[i + (__builtin_ctz(match) >> 1)];             \
+                if (name##_key(map_entry_at(map, bucket->slot - 1)) == key)                        \
+                    return bucket;                                                                 \
+            }                                                                                      \
+            if (step == 0)                                                                         \
+                return NULL;                                                                       \
+        }                                                                                          \
+    }                                                                                              \
+    static inline void *name##_get(map_t *map, type key)                                           \
+    {                                                                                              \
+        map_bucket_t *bucket = name##_find(map, key);                                              \
+        return bucket ? map_bucket_hit(map, bucket) : NULL;                                        \
+    }                                                                                              \
+    static inline int name##_set(map_t *map, type key, const void *value)                          \
+    {                                                                                              \
+        return map_set(map, &key, value);                                                          \
+    }                                                                                              \
+    static inline void name##_delete(map_t *map, type key)                                         \
+    {                                                                                              \
+        map_delete(map, &key);                                                                     \
+    }
+
+MAP_DEFINE_FIXED(map16, uint16_t) //端口号、协议号
+MAP_DEFINE_FIXED(map32, uint32_t) //IPv4地址
+MAP_DEFINE_FIXED(map64, uint64_t) //tcp_key_t
 
 #endif
\ No newline at end of file
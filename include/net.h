@@ -17,16 +17,95 @@ typedef enum net_protocol
 } net_protocol_t;
 
 typedef void (*net_handler_t)(buf_t *buf, uint8_t *src);
+typedef void (*net_burst_handler_t)(buf_t **bufs, uint8_t **srcs, int n);
+typedef void (*net_timer_handler_t)(void *arg);
+
+typedef struct net_stats //一个协议收到的数据包统计
+{
+    uint64_t packets; // 交给该协议的数据包数
+    uint64_t bytes;   // 交给该协议的字节数，不含下层头部
+} net_stats_t;
+
+#define NET_IP_PROTOCOL_NUM 256 //ip协议号的个数，协议号直接作为分发表下标
+#define NET_ETHER_SLOTS 16      //以太网类型分发表的槽数，须为2的幂
+#define NET_ETHER_MIN 0x0600    //以太网类型的最小值，更小的值是802.3帧的长度字段
+/**
+ * @brief 以太网类型到分发表槽位的哈希，对ARP、IP、IPv6、VLAN、RARP、LLDP、MPLS等常用类型无冲突
+ */
+#define NET_ETHER_HASH(type) ((((type) >> 8) ^ (type)) & (NET_ETHER_SLOTS - 1))
+
+#define NET_DEADLINE_NONE UINT64_MAX //net_next_deadline的返回值，表示没有待处理的定时器
 
 #define NET_MAC_LEN 6 //mac地址长度
 #define NET_IP_LEN 4  //ip地址长度
 
-extern uint8_t net_if_mac[NET_MAC_LEN];
-extern uint8_t net_if_ip[NET_IP_LEN];
-extern buf_t rxbuf, txbuf; //一个buf足够单线程使用
+#define NET_CAP_TX_CSUM 0x1 //驱动能填写BUF_CSUM_PARTIAL数据包的校验和
+#define NET_CAP_RX_CSUM 0x2 //驱动能校验收到的数据包，校验通过的标记为BUF_CSUM_UNNECESSARY
+
+typedef struct net_entry //分发表的一项
+{
+    uint16_t protocol;         // 协议号，以太网类型分发表中用于确认命中
+    net_handler_t handler;     // 处理程序，NULL表示未注册
+    net_burst_handler_t burst; // 批量处理程序，NULL表示逐个调用handler
+    net_stats_t stats;         // 收包统计
+} net_entry_t;
+
+typedef struct net_timer //协议栈定时器
+{
+    uint64_t deadline;           // 到期时间，net_now_ns的时基，0表示空闲
+    uint64_t interval;           // 周期（纳秒），0表示一次性
+    net_timer_handler_t handler; // 到期时调用的函数
+    void *arg;                   // 传给handler的参数
+} net_timer_t;
+
+typedef struct net_stack //协议栈实例，包含一个协议栈的全部状态，各实例互不共享，可在不同线程中并行运行
+{
+    uint8_t if_mac[NET_MAC_LEN];                   // 网卡MAC地址
+    uint8_t if_ip[NET_IP_LEN];                     // 网卡IP地址
+    int if_caps;                                   // 网卡的校验和卸载能力，NET_CAP_*的组合，打开网卡后由驱动给出，清零可关闭卸载
+    uint16_t if_mtu;                               // 网卡能收发的最大ip数据包长度，打开网卡后由驱动给出
+    const struct driver_ops *driver_ops;           // 网卡后端，NULL为DRIVER_DEFAULT，driver_select选择
+    void *driver;                                  // 驱动的私有数据
+    int (*rx_poll)();                              // 收包处理函数，NULL为ethernet_poll，返回处理的帧数
+    buf_t rxbuf, txbuf;                            // 网卡接收和发送缓冲区，一个buf足够单线程使用
+    uint16_t ip_id;                                // 下一个发送的ip数据包id
+    int backlog;                                   // 上一次轮询收满了NET_BURST帧，驱动中可能还有积压
+    int tx_batch;                                  // 非0时驱动暂存发出的帧，由net_poll或自行轮询的线程在每轮结束时driver_flush，为0时每次发送立即通知网卡
+    int arp_learn_only;                            // 只从收到的arp包学习映射，不应答请求也不在启动时宣告，用于与其他实例共用网卡的实例
+    net_entry_t ip_table[NET_IP_PROTOCOL_NUM];     // ip协议分发表，以协议号为下标
+    net_entry_t ether_table[NET_ETHER_SLOTS];      // 以太网类型分发表，以NET_ETHER_HASH为下标
+    net_timer_t timers[NET_TIMER_MAX];             // 定时器表
+    map_t arp_table;                               // arp表<ip,mac>
+    map_t arp_buf;                                 // arp缓存<ip,buf>，等待arp回应的数据包
+    map_t udp_table;                               // udp端口表<port,handler>
+    map_t tcp_table;                               // tcp端口表<port,handler>
+    map_t connect_table;                           // tcp连接表<tcp_key_t,tcp_connect_t>
+    buf_t tcp_tx_seg;                              // tcp发送时引用发送缓存的buf段
+    struct http_fifo *http_fifo;                   // http服务器等待处理的连接，http_server_open时分配
+    buf_pool_t pools[BUF_POOL_NUM];                // 本实例的缓冲池，默认实例使用静态缓冲池
+} __attribute__((aligned(64))) net_stack_t;
+
+/**
+ * @brief 当前线程正在运行的协议栈实例，各层通过它访问协议栈状态，
+ *        初始为默认实例，其地址与MAC由config.h给出
+ */
+extern _Thread_local net_stack_t *net_stack;
 
+net_stack_t *net_stack_create(const uint8_t *mac, const uint8_t *ip);
+void net_stack_enter(net_stack_t *stack);
+void net_stack_destroy(net_stack_t *stack);
 int net_init();
-void net_poll();
+void net_init_shared(const net_stack_t *owner);
+int net_poll();
+uint64_t net_next_deadline();
+int net_timer_add(uint64_t delay_ms, uint64_t interval_ms, net_timer_handler_t handler, void *arg);
+void net_timer_cancel(int id);
+int net_timer_run();
 int net_in(buf_t *buf, uint16_t protocol, uint8_t *src);
-void net_add_protocol(uint16_t protocol, net_handler_t handler);
+int net_in_burst(buf_t **bufs, uint8_t **srcs, int n, uint16_t protocol);
+int net_ip_in(buf_t *buf, uint8_t protocol, uint8_t *src);
+int net_ip_in_burst(buf_t **bufs, uint8_t **srcs, int n, uint8_t protocol);
+int net_add_protocol(uint16_t protocol, net_handler_t handler);
+int net_add_protocol_burst(uint16_t protocol, net_burst_handler_t handler);
+int net_protocol_stats(uint16_t protocol, net_stats_t *stats);
 #endif
\ No newline at end of file
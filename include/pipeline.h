@@ -0,0 +1,24 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "net.h"
+#include "tcp.h"
+
+typedef struct pipeline_conn //应用线程看到的tcp连接，只有地址与端口，连接本身由协议线程持有
+{
+    uint8_t ip[NET_IP_LEN]; // 对端ip
+    uint16_t remote_port;   // 对端端口
+    uint16_t local_port;    // 本地端口
+} pipeline_conn_t;
+
+#define PIPELINE_AGAIN -2 //pipeline_tcp_write与pipeline_tcp_close的返回值，连接在途的命令已达PIPELINE_PENDING_MAX，须稍后重试
+
+typedef void (*pipeline_setup_t)();
+typedef void (*pipeline_tcp_handler_t)(const pipeline_conn_t *conn, connect_state_t state, const uint8_t *data, size_t len);
+
+int pipeline_tcp_open(uint16_t port, pipeline_tcp_handler_t handler);
+int pipeline_start(pipeline_setup_t setup);
+int pipeline_tcp_write(const pipeline_conn_t *conn, const uint8_t *data, size_t len);
+int pipeline_tcp_close(const pipeline_conn_t *conn);
+void pipeline_stop();
+#endif
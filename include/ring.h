@@ -0,0 +1,130 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+#include "config.h"
+#include "utils.h"
+
+/**
+ * @brief 单消费者的无锁环形队列，元素按值拷贝，生产者与消费者的下标各占一个cache line
+ *        单生产者用ring_push_burst写入，多生产者用ring_mp_push_burst写入，一个队列只用其中一种
+ */
+typedef struct ring
+{
+    size_t head __attribute__((aligned(64))); // 已提交的写入位置，消费者可以读到此处
+    size_t reserve;                           // 多生产者已预留的写入位置，单生产者不使用
+    size_t tail_cache;                        // 单生产者上次读到的tail，减少对消费者cache line的访问
+    size_t tail __attribute__((aligned(64))); // 下一个读取位置，只由消费者修改
+    size_t head_cache;                        // 消费者上次读到的head
+    uint8_t *slots __attribute__((aligned(64)));
+    size_t mask;      // 槽数减1，槽数为2的幂
+    size_t elem_size; // 元素长度
+} ring_t;
+
+int ring_init(ring_t *ring, size_t count, size_t elem_size);
+void ring_free(ring_t *ring);
+
+/**
+ * @brief 生产者写入一组元素，空间不足时只写入能容纳的部分
+ *
+ * @param ring 队列
+ * @param elems 元素数组
+ * @param n 元素个数
+ * @return size_t 写入的元素个数
+ */
+static inline size_t ring_push_burst(ring_t *ring, const void *elems, size_t n)
+{
+    size_t head = ring->head, size = ring->mask + 1;
+    if (head - ring->tail_cache + n > size)
+    {
+        ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (head - ring->tail_cache + n > size)
+            n = size - (head - ring->tail_cache);
+    }
+    const uint8_t *src = elems;
+    for (size_t i = 0; i < n; i++)
+        memcpy(ring->slots + ((head + i) & ring->mask) * ring->elem_size, src + i * ring->elem_size, ring->elem_size);
+    __atomic_store_n(&ring->head, head + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+/**
+ * @brief 多个生产者之一写入一组元素，空间不足时只写入能容纳的部分
+ *        先原子地预留槽位再拷贝，按预留顺序提交，提交前消费者读不到这些元素
+ *
+ * @param ring 队列
+ * @param elems 元素数组
+ * @param n 元素个数
+ * @return size_t 写入的元素个数
+ */
+static inline size_t ring_mp_push_burst(ring_t *ring, const void *elems, size_t n)
+{
+    size_t size = ring->mask + 1, start, m;
+    do
+    {
+        start = __atomic_load_n(&ring->reserve, __ATOMIC_RELAXED);
+        size_t space = size - (start - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+        m = n < space ? n : space;
+        if (m == 0)
+            return 0;
+    } while (!__atomic_compare_exchange_n(&ring->reserve, &start, start + m, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    const uint8_t *src = elems;
+    for (size_t i = 0; i < m; i++)
+        memcpy(ring->slots + ((start + i) & ring->mask) * ring->elem_size, src + i * ring->elem_size, ring->elem_size);
+    for (int spins = 0; __atomic_load_n(&ring->head, __ATOMIC_RELAXED) != start; spins++) // 等先预留的生产者提交
+        if (spins < RING_COMMIT_SPINS)
+            cpu_relax();
+        else
+            sched_yield(); // 先预留的生产者可能被调度出去，CPU数少于线程数时不能一直自旋
+    __atomic_store_n(&ring->head, start + m, __ATOMIC_RELEASE);
+    return m;
+}
+
+/**
+ * @brief 单生产者可写入的元素个数，只是一个快照
+ *
+ * @param ring 队列
+ * @return size_t 空闲的槽数
+ */
+static inline size_t ring_space(ring_t *ring)
+{
+    return ring->mask + 1 - (ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+}
+
+/**
+ * @brief 消费者读出一组元素
+ *
+ * @param ring 队列
+ * @param elems 出口参数，元素数组
+ * @param n 最多读出的元素个数
+ * @return size_t 读出的元素个数，队列为空时为0
+ */
+static inline size_t ring_pop_burst(ring_t *ring, void *elems, size_t n)
+{
+    size_t tail = ring->tail;
+    if (ring->head_cache - tail < n)
+    {
+        ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (ring->head_cache - tail < n)
+            n = ring->head_cache - tail;
+    }
+    uint8_t *dst = elems;
+    for (size_t i = 0; i < n; i++)
+        memcpy(dst + i * ring->elem_size, ring->slots + ((tail + i) & ring->mask) * ring->elem_size, ring->elem_size);
+    __atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+/**
+ * @brief 队列中的元素个数，只是一个快照
+ *
+ * @param ring 队列
+ * @return size_t 元素个数
+ */
+static inline size_t ring_count(ring_t *ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+#endif
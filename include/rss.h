@@ -0,0 +1,24 @@
+#ifndef RSS_H
+#define RSS_H
+
+#include "net.h"
+
+#define RSS_ALL -1 //rss_worker_of的返回值，表示帧需交给每个工作线程，如ARP
+
+typedef void (*rss_setup_t)(int worker);
+
+typedef struct rss_stats //一个工作线程的统计
+{
+    uint64_t packets; // 工作线程处理的帧数
+    uint64_t drops;   // 因队列满而丢弃的帧数
+} rss_stats_t;
+
+uint32_t rss_hash(const uint8_t *tuple, size_t len);
+int rss_worker_of(const buf_t *buf);
+int rss_start(int workers, rss_setup_t setup);
+int rss_steer(buf_t *bufs, int n);
+int rss_poll();
+void rss_reclaim();
+void rss_get_stats(int worker, rss_stats_t *stats);
+void rss_stop();
+#endif
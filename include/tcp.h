@@ -35,21 +35,12 @@ typedef struct tcp_hdr {
     uint16_t urgent_pointer16;
 } tcp_hdr_t;
 
-typedef struct tcp_peso_hdr {
-    uint8_t src_ip[4];    // 源IP地址
-    uint8_t dst_ip[4];    // 目的IP地址
-    uint8_t placeholder;  // 必须置0,用于填充对齐
-    uint8_t protocol;     // 协议号
-    uint16_t total_len16; // 整个数据包的长度
-} tcp_peso_hdr_t;
-
 #pragma pack()
 
-
 typedef enum tcp_state {
     // 不使用状态 TCP_CLOSED,
     TCP_LISTEN = 0, /* 初始化的状态，没有分配缓存。处于这个状态时 tcp_connect_t 其他字段全是无效的
-                        其他状态rx_buf、tx_buf都在堆上动态分配了缓存，因此释放时要调用释放函数。
+                        其他状态rx_buf、tx_buf都从缓冲池分配了缓存，因此释放时要调用释放函数。
                     */
     TCP_SYN_SEND,
     TCP_SYN_RCVD,
@@ -77,8 +68,8 @@ typedef struct tcp_connect {
     uint16_t remote_mss;
     uint16_t remote_win;
     void* handler;
-    buf_t* rx_buf; // 接收缓存
-    buf_t* tx_buf; // 发送缓存
+    buf_t rx_buf; // 接收缓存
+    buf_t tx_buf; // 发送缓存
 } tcp_connect_t;
 
 static const tcp_connect_t CONNECT_LISTEN = {
@@ -102,6 +93,8 @@ void tcp_close(uint16_t port);
 void tcp_connect_close(tcp_connect_t* connect);
 size_t tcp_connect_write(tcp_connect_t* connect, const uint8_t* data, size_t len);
 size_t tcp_connect_read(tcp_connect_t* connect, uint8_t* data, size_t len);
+size_t tcp_connect_flush(tcp_connect_t* connect);
+tcp_connect_t *tcp_connect_find(uint8_t *ip, uint16_t remote_port, uint16_t local_port);
 void tcp_in(buf_t* buf, uint8_t* src_ip);
 
 #endif
@@ -3,8 +3,7 @@
 
 #include <stdint.h>
 #include <time.h>
-
-uint16_t checksum16(uint16_t *data, size_t len);
+#include "checksum.h"
 
 #define constswap16(x) ((((x)&0xFF) << 8) | (((x) >> 8) & 0xFF)) //为16位数据交换大小端
 //为16位数据交换大小端
@@ -24,6 +23,38 @@ static inline uint32_t min32(uint32_t a, uint32_t b) {
     return a < b ? a : b;
 }
 
+static inline uint64_t min64(uint64_t a, uint64_t b) {
+    return a < b ? a : b;
+}
+
+//自旋等待时提示CPU降低功耗并让出超线程的执行资源
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ volatile("yield");
+#endif
+}
+
+extern _Thread_local uint64_t net_clock_ns; //协议栈时钟的缓存值，单位纳秒，0表示尚未初始化，每个线程各自缓存
+
+void net_clock_update();
+
+//协议栈时钟，纳秒，每次net_poll更新一次
+static inline uint64_t net_now_ns() {
+    if (!net_clock_ns)
+        net_clock_update();
+    return net_clock_ns;
+}
+//协议栈时钟，毫秒
+static inline uint64_t net_now_ms() {
+    return net_now_ns() / 1000000;
+}
+//协议栈时钟，秒，与time(NULL)同基准
+static inline time_t net_now() {
+    return (time_t)(net_now_ns() / 1000000000);
+}
+
 char *iptos(uint8_t *ip);
 char *mactos(uint8_t *mac);
 char *timetos(time_t timestamp);
@@ -4,18 +4,6 @@
 #include "arp.h"
 #include "ethernet.h"
 
-/**
- * @brief arp地址转换表，<ip,mac>的容器
- *
- */
-map_t arp_table;
-
-/**
- * @brief arp buffer，<ip,buf_t>的容器
- *
- */
-map_t arp_buf;
-
 /**
  * @brief 打印一条arp表项
  *
@@ -35,7 +23,7 @@ void arp_entry_print(void *ip, void *mac, time_t *timestamp)
 void arp_print()
 {
     printf("===ARP TABLE BEGIN===\n");
-    map_foreach(&arp_table, arp_entry_print);
+    map_foreach(&net_stack->arp_table, arp_entry_print);
     printf("===ARP TABLE  END ===\n");
 }
 
@@ -47,23 +35,24 @@ void arp_print()
 void arp_req(uint8_t *target_ip)
 {
     // 防止用于发送数据包的txbuf(尚未缓存至arp_buf)被破坏而不使用txbuf
-    buf_t *tbuf = (buf_t *)malloc(sizeof(buf_t));
-    buf_init(tbuf, sizeof(arp_pkt_t));
-    arp_pkt_t *pkt = (arp_pkt_t *)tbuf->data;
+    buf_t tbuf;
+    if (buf_alloc(&tbuf, sizeof(arp_pkt_t)) == -1)
+        return;
+    arp_pkt_t *pkt = (arp_pkt_t *)tbuf.data;
 
     pkt->hw_type16 = constswap16(ARP_HW_ETHER);
     pkt->pro_type16 = constswap16(NET_PROTOCOL_IP);
     pkt->hw_len = NET_MAC_LEN;
     pkt->pro_len = NET_IP_LEN;
     pkt->opcode16 = constswap16(ARP_REQUEST);
-    memcpy(pkt->sender_mac, net_if_mac, NET_MAC_LEN);
-    memcpy(pkt->sender_ip, net_if_ip, NET_IP_LEN);
+    memcpy(pkt->sender_mac, net_stack->if_mac, NET_MAC_LEN);
+    memcpy(pkt->sender_ip, net_stack->if_ip, NET_IP_LEN);
     memset(pkt->target_mac, 0, NET_MAC_LEN);
     memcpy(pkt->target_ip, target_ip, NET_IP_LEN);
-    buf_add_padding(tbuf, ETHERNET_MIN_TRANSPORT_UNIT - sizeof(arp_pkt_t));
+    buf_add_padding(&tbuf, ETHERNET_MIN_TRANSPORT_UNIT - sizeof(arp_pkt_t));
 
-    ethernet_out(tbuf, ether_broadcast_mac, NET_PROTOCOL_ARP);
-    free(tbuf);
+    ethernet_out(&tbuf, ether_broadcast_mac, NET_PROTOCOL_ARP);
+    buf_free(&tbuf);
 }
 
 /**
@@ -74,7 +63,7 @@ void arp_req(uint8_t *target_ip)
  */
 void arp_resp(uint8_t *target_ip, uint8_t *target_mac)
 {
-    buf_t *buf = &txbuf;
+    buf_t *buf = &net_stack->txbuf;
     buf_init(buf, sizeof(arp_pkt_t));
     arp_pkt_t *pkt = (arp_pkt_t *)buf->data;
 
@@ -83,8 +72,8 @@ void arp_resp(uint8_t *target_ip, uint8_t *target_mac)
     pkt->hw_len = NET_MAC_LEN;
     pkt->pro_len = NET_IP_LEN;
     pkt->opcode16 = constswap16(ARP_REPLY);
-    memcpy(pkt->sender_mac, net_if_mac, NET_MAC_LEN);
-    memcpy(pkt->sender_ip, net_if_ip, NET_IP_LEN);
+    memcpy(pkt->sender_mac, net_stack->if_mac, NET_MAC_LEN);
+    memcpy(pkt->sender_ip, net_stack->if_ip, NET_IP_LEN);
     memcpy(pkt->target_mac, target_mac, NET_MAC_LEN);
     memcpy(pkt->target_ip, target_ip, NET_IP_LEN);
     buf_add_padding(buf, ETHERNET_MIN_TRANSPORT_UNIT - sizeof(arp_pkt_t));
@@ -113,19 +102,20 @@ void arp_in(buf_t *buf, uint8_t *src_mac)
         return;
 
     uint8_t *src_ip = hdr->sender_ip;
-    if (map_set(&arp_table, src_ip, src_mac) == -1)
+    if (map_set(&net_stack->arp_table, src_ip, src_mac) == -1)
         return;
 
-    buf_t *cache = map_get(&arp_buf, src_ip);
+    buf_t *cache = map32_get(&net_stack->arp_buf, map32_key(src_ip));
     if (cache == NULL)
     {
-        if (opcode == ARP_REQUEST && !memcmp(hdr->target_ip, net_if_ip, NET_IP_LEN))
+        if (opcode == ARP_REQUEST && !net_stack->arp_learn_only && !memcmp(hdr->target_ip, net_stack->if_ip, NET_IP_LEN))
             arp_resp(src_ip, src_mac);
     }
     else
     {
-        ethernet_out(cache, src_mac, constswap16(hdr->pro_type16));
-        map_delete(&arp_buf, src_ip);
+        if (cache->payload && buf_cow(cache) == 0) // 缓存时缓冲池耗尽则只删除
+            ethernet_out(cache, src_mac, constswap16(hdr->pro_type16));
+        map_delete(&net_stack->arp_buf, src_ip);
     }
 }
 
@@ -138,29 +128,43 @@ void arp_in(buf_t *buf, uint8_t *src_mac)
  */
 void arp_out(buf_t *buf, uint8_t *ip)
 {
-    uint8_t *mac = map_get(&arp_table, ip);
-    if (!memcmp(ip, net_if_ip, NET_IP_LEN))
-        mac = net_if_mac;
+    uint8_t *mac = map32_get(&net_stack->arp_table, map32_key(ip));
+    if (!memcmp(ip, net_stack->if_ip, NET_IP_LEN))
+        mac = net_stack->if_mac;
 
     if (mac == NULL)
     {
-        buf_t *cache = map_get(&arp_buf, ip);
+        buf_t *cache = map32_get(&net_stack->arp_buf, map32_key(ip));
         if (cache == NULL)
             arp_req(ip);
-        map_set(&arp_buf, ip, buf);
+        map_set(&net_stack->arp_buf, ip, buf);
     }
     else
         ethernet_out(buf, mac, NET_PROTOCOL_IP);
 }
 
+/**
+ * @brief arp的老化定时器，回收超时的arp表项，以及等待回应超时而缓存的数据包
+ *
+ * @param arg 未使用
+ */
+static void arp_aging(void *arg)
+{
+    map_expire(&net_stack->arp_table);
+    map_expire(&net_stack->arp_buf);
+}
+
 /**
  * @brief 初始化arp协议
  *
  */
 void arp_init()
 {
-    map_init(&arp_table, NET_IP_LEN, NET_MAC_LEN, 0, ARP_TIMEOUT_SEC, NULL);
-    map_init(&arp_buf, NET_IP_LEN, sizeof(buf_t), 0, ARP_MIN_INTERVAL, buf_copy);
+    map_init(&net_stack->arp_table, NET_IP_LEN, NET_MAC_LEN, 0, ARP_TIMEOUT_SEC, NULL, NULL);
+    map_set_policy(&net_stack->arp_table, MAP_EVICT_LRU);
+    map_init(&net_stack->arp_buf, NET_IP_LEN, sizeof(buf_t), 0, ARP_MIN_INTERVAL, buf_copy, buf_free);
     net_add_protocol(NET_PROTOCOL_ARP, arp_in);
-    arp_req(net_if_ip);
+    net_timer_add(ARP_AGING_MS, ARP_AGING_MS, arp_aging, NULL);
+    if (!net_stack->arp_learn_only)
+        arp_req(net_stack->if_ip);
 }
\ No newline at end of file
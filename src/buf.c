@@ -1,4 +1,5 @@
 #include "buf.h"
+#include "utils.h"
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
@@ -6,8 +7,10 @@
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wformat="
 #pragma GCC diagnostic ignored "-Wformat-extra-args"
+static int buf_pool_local(const buf_block_t *block);
 /**
  * @brief 初始化buffer为给定的长度，用于装载数据包
+ *        数据前预留BUF_HEADROOM字节，供之后添加协议头，链上的后续段被断开
  * 
  * @param buf 要初始化的buffer
  * @param len 数据初始长度
@@ -15,14 +18,16 @@
  */
 int buf_init(buf_t *buf, size_t len)
 {
-    if (len >= BUF_MAX_LEN / 2)
+    if (buf->payload == NULL || len + BUF_HEADROOM >= buf->size)
     {
         fprintf(stderr, "Error in buf_init:%zu\n", len);
         return -1;
     }
 
     buf->len = len;
-    buf->data = buf->payload + BUF_MAX_LEN / 2 - len;
+    buf->data = buf->payload + BUF_HEADROOM;
+    buf->next = NULL;
+    buf->csum = BUF_CSUM_NONE;
     return 0;
 }
 
@@ -42,6 +47,8 @@ int buf_add_header(buf_t *buf, size_t len)
     }
     buf->len += len;
     buf->data -= len;
+    if (buf->csum == BUF_CSUM_PARTIAL)
+        buf->csum_start += len;
     return 0;
 }
 
@@ -61,6 +68,13 @@ int buf_remove_header(buf_t *buf, size_t len)
     }
     buf->len -= len;
     buf->data += len;
+    if (buf->csum == BUF_CSUM_PARTIAL)
+    {
+        if (buf->csum_start < len)
+            buf->csum = BUF_CSUM_NONE; // 待填写校验和的部分已被去除
+        else
+            buf->csum_start -= len;
+    }
     return 0;
 }
 
@@ -73,7 +87,7 @@ int buf_remove_header(buf_t *buf, size_t len)
  */
 int buf_add_padding(buf_t *buf, size_t len)
 {
-    if (buf->data + buf->len + len >= buf->payload + BUF_MAX_LEN)
+    if (buf->data + buf->len + len >= buf->payload + buf->size)
     {
         fprintf(stderr, "Error in buf_add_padding:%zu+%zu\n", buf->len, len);
         return -1;
@@ -102,7 +116,35 @@ int buf_remove_padding(buf_t *buf, size_t len)
 }
 
 /**
- * @brief buf拷贝构造函数
+ * @brief buf深拷贝，从缓冲池中为目的buffer分配独占的数据区，只拷贝有效数据
+ *        链式buffer会被合并为一段
+ * 
+ * @param dst 目的buffer
+ * @param src 源buffer
+ * @return int 成功为0，缓冲池耗尽为-1
+ */
+int buf_clone(buf_t *dst, const buf_t *src)
+{
+    assert(src->data >= src->payload);
+    assert(src->data + src->len <= src->payload + src->size);
+    size_t headroom = src->data - src->payload;
+    size_t len = buf_chain_len(src);
+    if (buf_alloc(dst, len) == -1)
+        return -1;
+    if (headroom + len < dst->size)
+        dst->data = dst->payload + headroom; // 保持与源buffer相同的头部空间
+    buf_gather(src, dst->data);
+    dst->csum = src->csum;
+    dst->csum_start = src->csum_start;
+    dst->csum_offset = src->csum_offset;
+    return 0;
+}
+
+/**
+ * @brief buf拷贝构造函数，单段且属于当前线程缓冲池的buffer只增加引用计数与源buffer共享数据区，
+ *        外部数据区、链式或其他线程缓冲池的buffer则深拷贝到当前线程的缓冲池中，
+ *        使引用计数与空闲链表只由一个线程修改。缓冲池耗尽时目的buffer为空，数据区为NULL
+ *        共享后写入前需调用buf_cow
  * 
  * @param pdst 目的buffer
  * @param psrc 源buffer
@@ -112,12 +154,472 @@ void buf_copy(void *pdst, const void *psrc, size_t len)
 {
     buf_t *dst = pdst;
     const buf_t *src = psrc;
-    assert(src->data >= src->payload);
-    assert(src->len <= BUF_MAX_LEN);
-    assert(src->data + src->len < src->payload + BUF_MAX_LEN);
-    dst->len = src->len;
-    dst->data = dst->payload + (src->data - src->payload);
-    memcpy(dst->payload, src->payload, BUF_MAX_LEN);
+    if (src->block && src->next == NULL && buf_pool_local(src->block))
+    {
+        src->block->ref++;
+        *dst = *src;
+        return;
+    }
+    if (buf_clone(dst, src) == -1)
+        memset(dst, 0, sizeof(buf_t));
+}
+
+/**
+ * @brief 写时复制，若数据区被多个buf共享，则为该buffer克隆一份独占的数据区
+ * 
+ * @param buf 要写入的buffer
+ * @return int 成功为0，缓冲池耗尽为-1
+ */
+int buf_cow(buf_t *buf)
+{
+    if (buf->block == NULL || buf->block->ref == 1)
+        return 0;
+    buf_t tmp;
+    if (buf_clone(&tmp, buf) == -1)
+        return -1;
+    buf_free(buf);
+    *buf = tmp;
+    return 0;
+}
+
+/**
+ * @brief 获取链式buffer各段的总长度
+ * 
+ * @param buf 链的第一段
+ * @return size_t 总长度
+ */
+size_t buf_chain_len(const buf_t *buf)
+{
+    size_t len = 0;
+    for (; buf; buf = buf->next)
+        len += buf->len;
+    return len;
+}
+
+/**
+ * @brief 以不拷贝的方式引用链式buffer中的一段数据，生成的各段依次相连
+ *        生成的段不持有数据区，只在源buffer有效期间可用
+ * 
+ * @param buf 源buffer链
+ * @param offset 起始偏移
+ * @param len 引用的长度
+ * @param segs 出口参数，存放生成的段
+ * @param max segs的容量
+ * @return int 生成的段数，越界或容量不足为-1
+ */
+int buf_slice(const buf_t *buf, size_t offset, size_t len, buf_t *segs, size_t max)
+{
+    size_t n = 0;
+    for (; buf && offset >= buf->len; buf = buf->next)
+        offset -= buf->len;
+    for (; buf && len; buf = buf->next, offset = 0)
+    {
+        if (n == max)
+            return -1;
+        size_t l = buf->len - offset < len ? buf->len - offset : len;
+        buf_t *seg = &segs[n];
+        seg->data = seg->payload = buf->data + offset;
+        seg->len = seg->size = l;
+        seg->block = NULL;
+        seg->next = NULL;
+        seg->csum = BUF_CSUM_NONE;
+        if (n)
+            segs[n - 1].next = seg;
+        n++;
+        len -= l;
+    }
+    return len ? -1 : (int)n;
+}
+
+/**
+ * @brief 把链上后续段的数据拷贝到第一段的尾部，使buffer成为单段
+ * 
+ * @param buf 链的第一段
+ * @return int 成功为0，第一段尾部空间不足为-1
+ */
+int buf_linearize(buf_t *buf)
+{
+    if (buf->next == NULL)
+        return 0;
+    size_t len = buf_chain_len(buf->next);
+    if (buf->data + buf->len + len > buf->payload + buf->size)
+    {
+        fprintf(stderr, "Error in buf_linearize:%zu+%zu\n", buf->len, len);
+        return -1;
+    }
+    buf_gather(buf->next, buf->data + buf->len);
+    buf->len += len;
+    buf->next = NULL;
+    return 0;
+}
+
+/**
+ * @brief 把链式buffer各段的数据依次拷贝到连续的内存中
+ * 
+ * @param buf 链的第一段
+ * @param dst 目的地址，需能容纳buf_chain_len字节
+ * @return size_t 拷贝的总长度
+ */
+size_t buf_gather(const buf_t *buf, uint8_t *dst)
+{
+    size_t len = 0;
+    for (; buf; buf = buf->next)
+    {
+        memcpy(dst + len, buf->data, buf->len);
+        len += buf->len;
+    }
+    return len;
+}
+
+/**
+ * @brief 把链式buffer的各段依次累加到校验和上下文
+ * 
+ * @param ctx 校验和上下文
+ * @param buf 链的第一段
+ */
+void buf_checksum_add(checksum_ctx_t *ctx, const buf_t *buf)
+{
+    for (; buf; buf = buf->next)
+        checksum_add(ctx, buf->data, buf->len);
+}
+
+/**
+ * @brief 标记buffer的校验和由驱动填写，调用前校验和字段中应存放伪头部的累加和
+ * 
+ * @param buf 要发送的buffer
+ * @param start 从data起算的校验和计算起点
+ * @param offset 校验和字段相对start的偏移
+ */
+void buf_checksum_partial(buf_t *buf, size_t start, size_t offset)
+{
+    buf->csum = BUF_CSUM_PARTIAL;
+    buf->csum_start = start;
+    buf->csum_offset = offset;
+}
+
+/**
+ * @brief 内部函数，获取链式buffer中指定偏移处的字节
+ * 
+ * @param buf 链的第一段
+ * @param offset 偏移
+ * @return uint8_t* 字节地址，越界为NULL
+ */
+static uint8_t *buf_chain_at(buf_t *buf, size_t offset)
+{
+    for (; buf && offset >= buf->len; buf = buf->next)
+        offset -= buf->len;
+    return buf ? buf->data + offset : NULL;
+}
+
+/**
+ * @brief 由软件填写待驱动填写的校验和，用于驱动不支持或数据包需要分片时
+ * 
+ * @param buf 链的第一段
+ * @return int 成功为0，校验和字段越界为-1
+ */
+int buf_checksum_complete(buf_t *buf)
+{
+    if (buf->csum != BUF_CSUM_PARTIAL)
+        return 0;
+    checksum_ctx_t ctx;
+    checksum_init(&ctx);
+    size_t offset = buf->csum_start;
+    for (buf_t *seg = buf; seg; seg = seg->next)
+    {
+        if (offset < seg->len)
+            checksum_add(&ctx, seg->data + offset, seg->len - offset);
+        offset = offset > seg->len ? offset - seg->len : 0;
+    }
+    // 校验和字段在偶数偏移处，按内存顺序写入两个字节，允许字段跨段
+    uint16_t checksum = checksum_finish(&ctx);
+    uint8_t *lo = buf_chain_at(buf, buf->csum_start + buf->csum_offset);
+    uint8_t *hi = buf_chain_at(buf, buf->csum_start + buf->csum_offset + 1);
+    if (lo == NULL || hi == NULL)
+    {
+        fprintf(stderr, "Error in buf_checksum_complete:%u+%u\n", buf->csum_start, buf->csum_offset);
+        return -1;
+    }
+    memcpy(lo, &checksum, 1);
+    memcpy(hi, (uint8_t *)&checksum + 1, 1);
+    buf->csum = BUF_CSUM_NONE;
+    return 0;
+}
+
+/**
+ * @brief 把链式buffer聚合到连续内存中，若校验和待填写，则在拷贝的同时计算并填写到目的内存中
+ *        源buffer不被修改
+ * 
+ * @param buf 链的第一段
+ * @param dst 目的地址，需能容纳buf_chain_len字节
+ * @return size_t 拷贝的总长度
+ */
+size_t buf_gather_complete(const buf_t *buf, uint8_t *dst)
+{
+    if (buf->csum != BUF_CSUM_PARTIAL)
+        return buf_gather(buf, dst);
+    checksum_ctx_t ctx;
+    checksum_init(&ctx);
+    size_t start = buf->csum_start, field = buf->csum_start + buf->csum_offset;
+    size_t len = 0;
+    for (const buf_t *seg = buf; seg; seg = seg->next)
+    {
+        size_t skip = start > len ? start - len : 0; // 本段中位于计算起点之前的字节数
+        if (skip > seg->len)
+            skip = seg->len;
+        memcpy(dst + len, seg->data, skip);
+        checksum_add_copy(&ctx, dst + len + skip, seg->data + skip, seg->len - skip);
+        len += seg->len;
+    }
+    if (field + sizeof(uint16_t) <= len)
+    {
+        uint16_t checksum = checksum_finish(&ctx);
+        memcpy(dst + field, &checksum, sizeof(checksum));
+    }
+    return len;
+}
+
+/**
+ * @brief 计算链式buffer的16位校验和，与对各段拼接后调用checksum16的结果相同
+ * 
+ * @param buf 链的第一段
+ * @return uint16_t 校验和
+ */
+uint16_t buf_checksum16(const buf_t *buf)
+{
+    checksum_ctx_t ctx;
+    checksum_init(&ctx);
+    buf_checksum_add(&ctx, buf);
+    return checksum_finish(&ctx);
+}
+
+#define BUF_BLOCK_HDR_LEN ((sizeof(buf_block_t) + 63) & ~(size_t)63)                      //块头长度，按cache line对齐
+#define BUF_ARENA_ALIGN 4096 //缓冲池内存按页对齐，可整体注册给网卡（如AF_XDP的UMEM）
+#define BUF_ARENA_ROUND(len) (((len) + BUF_ARENA_ALIGN - 1) & ~(size_t)(BUF_ARENA_ALIGN - 1))
+#define BUF_ARENA_MTU_LEN BUF_ARENA_ROUND(BUF_POOL_MTU_NUM * (BUF_BLOCK_HDR_LEN + BUF_MTU_SIZE))                //MTU级缓冲池的内存大小
+#define BUF_ARENA_JUMBO_LEN BUF_ARENA_ROUND(BUF_POOL_JUMBO_NUM * (BUF_BLOCK_HDR_LEN + ((BUF_MAX_LEN + 63) & ~63))) //巨型缓冲池的内存大小
+
+static uint8_t buf_arena_mtu[BUF_ARENA_MTU_LEN] __attribute__((aligned(BUF_ARENA_ALIGN)));
+static uint8_t buf_arena_jumbo[BUF_ARENA_JUMBO_LEN] __attribute__((aligned(BUF_ARENA_ALIGN)));
+static buf_pool_t buf_pools_default[BUF_POOL_NUM];
+static int buf_pool_ready;
+
+/**
+ * @brief 当前线程分配buf所用的一组缓冲池，NULL表示默认的静态缓冲池
+ * 
+ */
+static _Thread_local buf_pool_t *buf_pools;
+
+/**
+ * @brief 数据区是否属于当前线程的缓冲池
+ * 
+ * @param block 数据区所属的缓冲池块
+ * @return int 属于为1，否则为0
+ */
+static int buf_pool_local(const buf_block_t *block)
+{
+    buf_pool_init();
+    return block->pool >= buf_pools && block->pool < buf_pools + BUF_POOL_NUM;
+}
+
+/**
+ * @brief 内部函数，把一段内存切分为buf块并串成空闲链表
+ * 
+ * @param pool 要初始化的池
+ * @param arena 预分配的内存
+ * @param num 块数
+ * @param size 每块数据区容量
+ */
+static void buf_pool_build(buf_pool_t *pool, uint8_t *arena, size_t num, size_t size)
+{
+    memset(pool, 0, sizeof(buf_pool_t));
+    pool->arena = arena;
+    pool->stride = BUF_BLOCK_HDR_LEN + ((size + 63) & ~(size_t)63);
+    pool->stats.size = size;
+    pool->stats.total = num;
+    for (size_t i = num; i > 0; i--)
+    {
+        buf_block_t *block = (buf_block_t *)(arena + (i - 1) * pool->stride);
+        block->pool = pool;
+        block->next = pool->free;
+        pool->free = block;
+    }
+}
+
+/**
+ * @brief 初始化默认的静态缓冲池，重复调用无副作用
+ *        默认缓冲池不加锁，只应由一个线程使用，其他线程用buf_pool_create创建各自的缓冲池
+ * 
+ */
+void buf_pool_init()
+{
+    if (!buf_pools)
+        buf_pools = buf_pools_default;
+    if (buf_pools != buf_pools_default || buf_pool_ready)
+        return;
+    buf_pool_build(&buf_pools_default[BUF_POOL_MTU], buf_arena_mtu, BUF_POOL_MTU_NUM, BUF_MTU_SIZE);
+    buf_pool_build(&buf_pools_default[BUF_POOL_JUMBO], buf_arena_jumbo, BUF_POOL_JUMBO_NUM, BUF_MAX_LEN);
+    buf_pool_ready = 1;
+}
+
+/**
+ * @brief 创建一组与默认缓冲池同样规格的缓冲池，内存从堆上分配
+ * 
+ * @param pools 要初始化的缓冲池，BUF_POOL_NUM个
+ * @return int 成功为0，内存不足为-1
+ */
+int buf_pool_create(buf_pool_t *pools)
+{
+    uint8_t *arena = aligned_alloc(BUF_ARENA_ALIGN, BUF_ARENA_MTU_LEN + BUF_ARENA_JUMBO_LEN);
+    if (arena == NULL)
+    {
+        fprintf(stderr, "Error in buf_pool_create.\n");
+        return -1;
+    }
+    buf_pool_build(&pools[BUF_POOL_MTU], arena, BUF_POOL_MTU_NUM, BUF_MTU_SIZE);
+    buf_pool_build(&pools[BUF_POOL_JUMBO], arena + BUF_ARENA_MTU_LEN, BUF_POOL_JUMBO_NUM, BUF_MAX_LEN);
+    return 0;
+}
+
+/**
+ * @brief 释放buf_pool_create创建的缓冲池，其中的buf应已全部释放
+ * 
+ * @param pools 要释放的缓冲池
+ */
+void buf_pool_destroy(buf_pool_t *pools)
+{
+    if (buf_pools == pools)
+        buf_pools = NULL;
+    free(pools[BUF_POOL_MTU].arena);
+    memset(pools, 0, BUF_POOL_NUM * sizeof(buf_pool_t));
+}
+
+/**
+ * @brief 设置当前线程此后分配buf所用的缓冲池，释放时总是归还到buf所属的缓冲池
+ * 
+ * @param pools buf_pool_create创建的缓冲池，NULL表示默认的静态缓冲池
+ */
+void buf_pool_use(buf_pool_t *pools)
+{
+    buf_pools = pools; // 默认缓冲池在首次分配时初始化
+}
+
+/**
+ * @brief 获取当前线程分配buf所用的缓冲池，可把其内存整体注册给网卡
+ * 
+ * @param id 缓冲池编号
+ * @return buf_pool_t* 缓冲池
+ */
+buf_pool_t *buf_pool_current(buf_pool_id_t id)
+{
+    buf_pool_init();
+    return &buf_pools[id];
+}
+
+/**
+ * @brief 从指定的缓冲池中分配一个buf，并初始化为给定的长度
+ * 
+ * @param buf 要初始化的buffer
+ * @param id 缓冲池编号
+ * @param len 数据初始长度
+ * @return int 成功为0，池耗尽或长度超出容量为-1
+ */
+int buf_alloc_pool(buf_t *buf, buf_pool_id_t id, size_t len)
+{
+    buf_pool_init();
+    buf_pool_t *pool = &buf_pools[id];
+    buf_block_t *block = pool->free;
+    if (block == NULL)
+    {
+        pool->stats.exhausted++;
+        return -1;
+    }
+    if (len + BUF_HEADROOM >= pool->stats.size)
+    {
+        fprintf(stderr, "Error in buf_alloc_pool:%zu\n", len);
+        return -1;
+    }
+    block->ref = 1;
+    buf->block = block;
+    buf->payload = (uint8_t *)block + BUF_BLOCK_HDR_LEN;
+    buf->size = pool->stats.size;
+    buf->len = len;
+    buf->data = buf->payload + BUF_HEADROOM;
+    buf->next = NULL;
+    buf->csum = BUF_CSUM_NONE;
+    pool->free = block->next;
+    pool->stats.allocs++;
+    if (++pool->stats.in_use > pool->stats.peak)
+        pool->stats.peak = pool->stats.in_use;
+    return 0;
+}
+
+/**
+ * @brief 从能容纳给定长度的最小缓冲池中分配一个buf，并初始化为给定的长度
+ * 
+ * @param buf 要初始化的buffer
+ * @param len 数据初始长度
+ * @return int 成功为0，失败为-1
+ */
+int buf_alloc(buf_t *buf, size_t len)
+{
+    if (len + BUF_HEADROOM < BUF_MTU_SIZE)
+        return buf_alloc_pool(buf, BUF_POOL_MTU, len);
+    return buf_alloc_pool(buf, BUF_POOL_JUMBO, len);
+}
+
+/**
+ * @brief 释放buf对数据区的引用，最后一个引用释放时把数据区归还缓冲池，外部提供数据区的buf不受影响
+ *        形式与map的值析构函数一致
+ * 
+ * @param pbuf 要释放的buffer
+ */
+void buf_free(void *pbuf)
+{
+    buf_t *buf = pbuf;
+    buf_block_t *block = buf->block;
+    if (block == NULL)
+        return;
+    if (--block->ref == 0)
+    {
+        buf_pool_t *pool = block->pool;
+        block->next = pool->free;
+        pool->free = block;
+        pool->stats.in_use--;
+    }
+    buf->block = NULL;
+    buf->next = NULL;
+    buf->payload = buf->data = NULL;
+    buf->size = buf->len = 0;
+}
+
+/**
+ * @brief 获取缓冲池的统计信息
+ * 
+ * @param id 缓冲池编号
+ * @param stats 出口参数，统计信息
+ */
+void buf_pool_stats(buf_pool_id_t id, buf_pool_stats_t *stats)
+{
+    buf_pool_init();
+    *stats = buf_pools[id].stats;
+}
+
+/**
+ * @brief 打印所有缓冲池的统计信息
+ * 
+ */
+void buf_pool_print()
+{
+    static const char *names[BUF_POOL_NUM] = {"mtu", "jumbo"};
+    buf_pool_init();
+    printf("===BUF POOL BEGIN===\n");
+    for (int i = 0; i < BUF_POOL_NUM; i++)
+    {
+        buf_pool_stats_t *stats = &buf_pools[i].stats;
+        printf("%-5s | size %zu | in use %zu/%zu | peak %zu | allocs %zu | exhausted %zu\n",
+               names[i], stats->size, stats->in_use, stats->total, stats->peak, stats->allocs, stats->exhausted);
+    }
+    printf("===BUF POOL  END ===\n");
 }
 
 #pragma GCC diagnostic pop
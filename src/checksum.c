@@ -0,0 +1,444 @@
+#include <string.h>
+#include "checksum.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CHECKSUM_X86
+#include <immintrin.h>
+#endif
+
+#define CHECKSUM_WIDEN_BLOCKS 32768 //向量累加多少块后扩展到64位，每个32位通道每块最多加两次0xFFFF，不会溢出
+
+typedef uint64_t (*checksum_sum_fn_t)(const uint8_t *data, size_t len);
+typedef uint64_t (*checksum_copy_fn_t)(uint8_t *dst, const uint8_t *src, size_t len);
+
+/**
+ * @brief 逐字累加，结果与最初的checksum16逐字相加完全相同
+ *        奇数长度时最后一个字节按数值累加
+ *
+ * @param data 数据
+ * @param len 长度
+ * @return uint64_t 未折叠的累加和
+ */
+static uint64_t checksum_sum_scalar(const uint8_t *data, size_t len)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i + 1 < len; i += 2)
+    {
+        uint16_t word;
+        memcpy(&word, data + i, sizeof(word));
+        sum += word;
+    }
+    if (len & 1)
+        sum += data[len - 1];
+    return sum;
+}
+
+/**
+ * @brief 逐字拷贝并累加，结果与checksum_sum_scalar相同
+ *
+ * @param dst 目的地址
+ * @param src 源地址
+ * @param len 长度
+ * @return uint64_t 未折叠的累加和
+ */
+static uint64_t checksum_copy_scalar(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i + 1 < len; i += 2)
+    {
+        uint16_t word;
+        memcpy(&word, src + i, sizeof(word));
+        memcpy(dst + i, &word, sizeof(word));
+        sum += word;
+    }
+    if (len & 1)
+        sum += dst[len - 1] = src[len - 1];
+    return sum;
+}
+
+#ifdef CHECKSUM_X86
+/**
+ * @brief SSE2实现，16位字零扩展到32位通道上累加，每CHECKSUM_WIDEN_BLOCKS块才扩展到64位一次
+ *
+ * @param data 数据
+ * @param len 长度
+ * @return uint64_t 未折叠的累加和
+ */
+__attribute__((target("sse2"))) static uint64_t checksum_sum_sse2(const uint8_t *data, size_t len)
+{
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t sum = 0;
+    while (len >= 16)
+    {
+        size_t blocks = len / 16 < CHECKSUM_WIDEN_BLOCKS ? len / 16 : CHECKSUM_WIDEN_BLOCKS;
+        __m128i acc0 = zero, acc1 = zero;
+        for (size_t i = 0; i < blocks; i++, data += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)data);
+            acc0 = _mm_add_epi32(acc0, _mm_unpacklo_epi16(v, zero));
+            acc1 = _mm_add_epi32(acc1, _mm_unpackhi_epi16(v, zero));
+        }
+        len -= blocks * 16;
+        __m128i wide = _mm_add_epi64(_mm_add_epi64(_mm_unpacklo_epi32(acc0, zero), _mm_unpackhi_epi32(acc0, zero)),
+                                     _mm_add_epi64(_mm_unpacklo_epi32(acc1, zero), _mm_unpackhi_epi32(acc1, zero)));
+        uint64_t lanes[2];
+        _mm_storeu_si128((__m128i *)lanes, wide);
+        sum += lanes[0] + lanes[1];
+    }
+    return sum + checksum_sum_scalar(data, len);
+}
+
+/**
+ * @brief AVX2实现，与SSE2实现相同，每次处理32字节
+ *
+ * @param data 数据
+ * @param len 长度
+ * @return uint64_t 未折叠的累加和
+ */
+__attribute__((target("avx2"))) static uint64_t checksum_sum_avx2(const uint8_t *data, size_t len)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t sum = 0;
+    while (len >= 32)
+    {
+        size_t blocks = len / 32 < CHECKSUM_WIDEN_BLOCKS ? len / 32 : CHECKSUM_WIDEN_BLOCKS;
+        __m256i acc0 = zero, acc1 = zero;
+        for (size_t i = 0; i < blocks; i++, data += 32)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)data);
+            acc0 = _mm256_add_epi32(acc0, _mm256_unpacklo_epi16(v, zero));
+            acc1 = _mm256_add_epi32(acc1, _mm256_unpackhi_epi16(v, zero));
+        }
+        len -= blocks * 32;
+        __m256i wide = _mm256_add_epi64(_mm256_add_epi64(_mm256_unpacklo_epi32(acc0, zero), _mm256_unpackhi_epi32(acc0, zero)),
+                                        _mm256_add_epi64(_mm256_unpacklo_epi32(acc1, zero), _mm256_unpackhi_epi32(acc1, zero)));
+        uint64_t lanes[4];
+        _mm256_storeu_si256((__m256i *)lanes, wide);
+        sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    return sum + checksum_sum_sse2(data, len);
+}
+
+/**
+ * @brief SSE2实现的拷贝并累加，累加方式与checksum_sum_sse2相同
+ *
+ * @param dst 目的地址
+ * @param src 源地址
+ * @param len 长度
+ * @return uint64_t 未折叠的累加和
+ */
+__attribute__((target("sse2"))) static uint64_t checksum_copy_sse2(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t sum = 0;
+    while (len >= 16)
+    {
+        size_t blocks = len / 16 < CHECKSUM_WIDEN_BLOCKS ? len / 16 : CHECKSUM_WIDEN_BLOCKS;
+        __m128i acc0 = zero, acc1 = zero;
+        for (size_t i = 0; i < blocks; i++, src += 16, dst += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)src);
+            _mm_storeu_si128((__m128i *)dst, v);
+            acc0 = _mm_add_epi32(acc0, _mm_unpacklo_epi16(v, zero));
+            acc1 = _mm_add_epi32(acc1, _mm_unpackhi_epi16(v, zero));
+        }
+        len -= blocks * 16;
+        __m128i wide = _mm_add_epi64(_mm_add_epi64(_mm_unpacklo_epi32(acc0, zero), _mm_unpackhi_epi32(acc0, zero)),
+                                     _mm_add_epi64(_mm_unpacklo_epi32(acc1, zero), _mm_unpackhi_epi32(acc1, zero)));
+        uint64_t lanes[2];
+        _mm_storeu_si128((__m128i *)lanes, wide);
+        sum += lanes[0] + lanes[1];
+    }
+    return sum + checksum_copy_scalar(dst, src, len);
+}
+
+/**
+ * @brief AVX2实现的拷贝并累加，累加方式与checksum_sum_avx2相同
+ *
+ * @param dst 目的地址
+ * @param src 源地址
+ * @param len 长度
+ * @return uint64_t 未折叠的累加和
+ */
+__attribute__((target("avx2"))) static uint64_t checksum_copy_avx2(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t sum = 0;
+    while (len >= 32)
+    {
+        size_t blocks = len / 32 < CHECKSUM_WIDEN_BLOCKS ? len / 32 : CHECKSUM_WIDEN_BLOCKS;
+        __m256i acc0 = zero, acc1 = zero;
+        for (size_t i = 0; i < blocks; i++, src += 32, dst += 32)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)src);
+            _mm256_storeu_si256((__m256i *)dst, v);
+            acc0 = _mm256_add_epi32(acc0, _mm256_unpacklo_epi16(v, zero));
+            acc1 = _mm256_add_epi32(acc1, _mm256_unpackhi_epi16(v, zero));
+        }
+        len -= blocks * 32;
+        __m256i wide = _mm256_add_epi64(_mm256_add_epi64(_mm256_unpacklo_epi32(acc0, zero), _mm256_unpackhi_epi32(acc0, zero)),
+                                        _mm256_add_epi64(_mm256_unpacklo_epi32(acc1, zero), _mm256_unpackhi_epi32(acc1, zero)));
+        uint64_t lanes[4];
+        _mm256_storeu_si256((__m256i *)lanes, wide);
+        sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    return sum + checksum_copy_sse2(dst, src, len);
+}
+#endif
+
+static uint64_t checksum_sum_detect(const uint8_t *data, size_t len);
+
+static const checksum_sum_fn_t checksum_sum_impls[CHECKSUM_IMPL_NUM] = {
+    checksum_sum_scalar,
+#ifdef CHECKSUM_X86
+    checksum_sum_sse2,
+    checksum_sum_avx2,
+#endif
+};
+
+static const checksum_copy_fn_t checksum_copy_impls[CHECKSUM_IMPL_NUM] = {
+    checksum_copy_scalar,
+#ifdef CHECKSUM_X86
+    checksum_copy_sse2,
+    checksum_copy_avx2,
+#endif
+};
+
+/**
+ * @brief 当前使用的实现，首次调用时按CPU支持情况选择
+ *
+ */
+static checksum_sum_fn_t checksum_sum_fn = checksum_sum_detect;
+static checksum_copy_fn_t checksum_copy_fn = NULL;
+static checksum_impl_t checksum_impl = CHECKSUM_SCALAR;
+
+/**
+ * @brief 读取当前的累加实现，各线程可能同时首次探测，用relaxed原子操作避免数据竞争
+ *
+ * @return checksum_sum_fn_t 累加实现
+ */
+static inline checksum_sum_fn_t checksum_sum_get()
+{
+    return __atomic_load_n(&checksum_sum_fn, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief 首次计算时探测CPU，选择可用的最快实现
+ *
+ * @param data 数据
+ * @param len 长度
+ * @return uint64_t 未折叠的累加和
+ */
+static uint64_t checksum_sum_detect(const uint8_t *data, size_t len)
+{
+    checksum_impl_t impl = CHECKSUM_IMPL_NUM;
+    while (!checksum_impl_supported(--impl))
+        ;
+    checksum_select(impl);
+    return checksum_sum_impls[impl](data, len);
+}
+
+/**
+ * @brief 判断CPU是否支持某种实现
+ *
+ * @param impl 实现
+ * @return int 支持为1，否则为0
+ */
+int checksum_impl_supported(checksum_impl_t impl)
+{
+    switch (impl)
+    {
+    case CHECKSUM_SCALAR:
+        return 1;
+#ifdef CHECKSUM_X86
+    case CHECKSUM_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case CHECKSUM_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief 指定使用的实现，用于测试与对比
+ *
+ * @param impl 实现
+ * @return int 成功为0，CPU不支持为-1
+ */
+int checksum_select(checksum_impl_t impl)
+{
+    if (!checksum_impl_supported(impl))
+        return -1;
+    __atomic_store_n(&checksum_impl, impl, __ATOMIC_RELAXED);
+    __atomic_store_n(&checksum_copy_fn, checksum_copy_impls[impl], __ATOMIC_RELAXED);
+    __atomic_store_n(&checksum_sum_fn, checksum_sum_impls[impl], __ATOMIC_RELAXED);
+    return 0;
+}
+
+/**
+ * @brief 获取当前使用的实现
+ *
+ * @return checksum_impl_t 实现
+ */
+checksum_impl_t checksum_current()
+{
+    if (checksum_sum_get() == checksum_sum_detect)
+        checksum_sum_detect(NULL, 0);
+    return __atomic_load_n(&checksum_impl, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief 拷贝数据，同时计算按16位字的累加和，只读一遍源数据
+ *
+ * @param dst 目的地址
+ * @param src 源地址
+ * @param len 长度
+ * @return uint64_t 未折叠的累加和，与checksum_sum(src, len)相同
+ */
+uint64_t checksum_copy(void *dst, const void *src, size_t len)
+{
+    checksum_copy_fn_t fn = __atomic_load_n(&checksum_copy_fn, __ATOMIC_RELAXED);
+    if (fn == NULL)
+    {
+        checksum_current();
+        fn = __atomic_load_n(&checksum_copy_fn, __ATOMIC_RELAXED);
+    }
+    return fn(dst, src, len);
+}
+
+/**
+ * @brief 获取实现的名称
+ *
+ * @param impl 实现
+ * @return const char* 名称
+ */
+const char *checksum_impl_name(checksum_impl_t impl)
+{
+    static const char *names[CHECKSUM_IMPL_NUM] = {"scalar", "sse2", "avx2"};
+    return impl < CHECKSUM_IMPL_NUM ? names[impl] : "unknown";
+}
+
+/**
+ * @brief 计算数据按16位字的累加和，不折叠，可用于分段累加
+ *
+ * @param data 数据
+ * @param len 长度
+ * @return uint64_t 累加和
+ */
+uint64_t checksum_sum(const void *data, size_t len)
+{
+    return checksum_sum_get()(data, len);
+}
+
+/**
+ * @brief 计算16位校验和
+ *
+ * @param buf 要计算的数据包
+ * @param len 要计算的长度
+ * @return uint16_t 校验和
+ */
+uint16_t checksum16(uint16_t *data, size_t len)
+{
+    return (uint16_t)~checksum_fold(checksum_sum_get()((const uint8_t *)data, len));
+}
+
+/**
+ * @brief 开始一次分段累加
+ *
+ * @param ctx 校验和上下文
+ */
+void checksum_init(checksum_ctx_t *ctx)
+{
+    ctx->sum = 0;
+    ctx->offset = 0;
+}
+
+/**
+ * @brief 内部函数，把从当前偏移开始的一段数据的累加和并入上下文
+ *
+ * @param ctx 校验和上下文
+ * @param sum 该段的累加和
+ * @param len 该段的长度
+ */
+static void checksum_add_sum(checksum_ctx_t *ctx, uint64_t sum, size_t len)
+{
+    uint16_t part = checksum_fold(sum);
+    if (ctx->offset & 1)
+        part = (uint16_t)(part << 8 | part >> 8); // 段从奇数偏移开始，字节在16位字中的位置互换
+    ctx->sum += part;
+    ctx->offset += len;
+}
+
+/**
+ * @brief 累加一段数据，各段依次累加的结果与拼接后一次计算相同
+ *
+ * @param ctx 校验和上下文
+ * @param data 数据
+ * @param len 长度
+ */
+void checksum_add(checksum_ctx_t *ctx, const void *data, size_t len)
+{
+    if (len)
+        checksum_add_sum(ctx, checksum_sum_get()(data, len), len);
+}
+
+/**
+ * @brief 拷贝一段数据并累加，等价于memcpy后再checksum_add
+ *
+ * @param ctx 校验和上下文
+ * @param dst 目的地址
+ * @param src 源地址
+ * @param len 长度
+ */
+void checksum_add_copy(checksum_ctx_t *ctx, void *dst, const void *src, size_t len)
+{
+    if (len)
+        checksum_add_sum(ctx, checksum_copy(dst, src, len), len);
+}
+
+/**
+ * @brief 把另一个上下文累加的数据接在后面，等价于依次累加两者的数据
+ *
+ * @param ctx 校验和上下文
+ * @param part 后一段数据的上下文
+ */
+void checksum_merge(checksum_ctx_t *ctx, const checksum_ctx_t *part)
+{
+    checksum_add_sum(ctx, part->sum, part->offset);
+}
+
+/**
+ * @brief 累加tcp/udp的ip伪头部，等价于累加[源ip][目的ip][0][协议号][长度]这12字节
+ *
+ * @param ctx 校验和上下文
+ * @param src_ip 源ip地址
+ * @param dst_ip 目的ip地址
+ * @param protocol 协议号
+ * @param len tcp/udp报文长度，主机字节序
+ */
+void checksum_pseudo(checksum_ctx_t *ctx, const uint8_t *src_ip, const uint8_t *dst_ip, uint8_t protocol, uint16_t len)
+{
+    uint8_t tail[4] = {0, protocol, len >> 8, len & 0xFF};
+    uint16_t words[6];
+    memcpy(words, src_ip, 4);
+    memcpy(words + 2, dst_ip, 4);
+    memcpy(words + 4, tail, 4);
+    uint64_t sum = 0;
+    for (int i = 0; i < 6; i++)
+        sum += words[i];
+    ctx->sum += sum; // 伪头部长度为偶数，不影响后续数据的字节位置
+    ctx->offset += sizeof(words);
+}
+
+/**
+ * @brief 结束累加，得到校验和
+ *
+ * @param ctx 校验和上下文
+ * @return uint16_t 校验和
+ */
+uint16_t checksum_finish(checksum_ctx_t *ctx)
+{
+    return (uint16_t)~checksum_fold(ctx->sum);
+}
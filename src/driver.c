@@ -1,195 +1,279 @@
-#include <pcap.h>
+#ifdef __linux__
+#include <errno.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#endif
 #include "driver.h"
 
-#ifdef _WIN32
-#include <tchar.h>
+static const driver_ops_t *const driver_table[] = { //可选的网卡后端
+    &driver_pcap,
+    &driver_memory,
+#ifdef __linux__
+    &driver_packet,
+    &driver_xdp,
+    &driver_tap,
+    &driver_uring_tap,
+    &driver_uring_packet,
+#endif
+};
+
 /**
- * @brief npcp官方提供的加载npcap的dll库函数
- * 
- * @return BOOL 是否成功
+ * @brief 按名查找网卡后端
+ *
+ * @param name 后端名
+ * @return const driver_ops_t* 后端，不存在为NULL
  */
-BOOL LoadNpcapDlls()
+const driver_ops_t *driver_lookup(const char *name)
 {
-    _TCHAR npcap_dir[512];
-    UINT len;
-    len = GetSystemDirectory(npcap_dir, 480);
-    if (!len)
-    {
-        fprintf(stderr, "Error in GetSystemDirectory: %lx", GetLastError());
-        return FALSE;
-    }
-    _tcscat_s(npcap_dir, 512, _T("\\Npcap"));
-    if (SetDllDirectory(npcap_dir) == 0)
-    {
-        fprintf(stderr, "Error in SetDllDirectory: %lx", GetLastError());
-        return FALSE;
-    }
-    return TRUE;
+    for (size_t i = 0; i < sizeof(driver_table) / sizeof(driver_table[0]); i++)
+        if (strcmp(driver_table[i]->name, name) == 0)
+            return driver_table[i];
+    return NULL;
 }
-#endif
-
-pcap_t *pcap;
-char pcap_errbuf[PCAP_ERRBUF_SIZE];
 
 /**
- * @brief 根据ip进行前缀匹配，选取最长前缀匹配的网卡
- * 
- * @param ip ip地址
- * @param if_name 出口参数，选取的网卡名
- * @param mask 出口参数，该网卡的掩码
- * @return int 成功为0，失败为-1
+ * @brief 内部函数，当前协议栈实例的网卡后端，未选择时为DRIVER_DEFAULT
+ *
+ * @return const driver_ops_t* 后端
  */
-int driver_find(uint8_t *ip, char *if_name, uint8_t *mask)
+static const driver_ops_t *driver_ops()
 {
-    pcap_if_t *alldevs;
-    pcap_if_t *d;
-    pcap_addr_t *a;
-    size_t i;
-    uint8_t match[PCAP_BUF_SIZE] = {0};
-    size_t if_num = 0;
-    uint32_t mask_all = PCAP_NETMASK_UNKNOWN;
-    if (pcap_findalldevs(&alldevs, pcap_errbuf) == -1)
-    {
-        fprintf(stderr, "Error in pcap_findalldevs: %s\n", pcap_errbuf);
-        return -1;
-    }
-
-    for (d = alldevs; d; d = d->next, if_num++)
-        for (a = d->addresses; a; a = a->next)
-            if (a->addr && a->addr->sa_family == AF_INET)
-            {
-                match[if_num] = ip_prefix_match(ip, (uint8_t *)&((struct sockaddr_in *)a->addr)->sin_addr.s_addr);
-                if (match[if_num] < ip_prefix_match((uint8_t *)&mask_all, (uint8_t *)&((struct sockaddr_in *)(a->netmask))->sin_addr.s_addr))
-                    match[if_num] = 0;
-            }
-    if (if_num == 0)
-    {
-        fprintf(stderr, "Error, no interface found.\n");
-        return -1;
-    }
-    uint8_t max_match = 0;
-    size_t max_if = 0;
-    for (i = 0; i < if_num; i++)
-        if (match[i] > max_match)
-            max_if = i, max_match = match[i];
-    if (max_match == 0)
-    {
-        fprintf(stderr, "Error, no interface found.\n");
-        return -1;
-    }
+    if (net_stack->driver_ops == NULL)
+        net_stack->driver_ops = driver_lookup(DRIVER_DEFAULT);
+    return net_stack->driver_ops;
+}
 
-    for (d = alldevs, i = 0; i < max_if; d = d->next, i++)
-        ;
-    if (max_match == 32)
+/**
+ * @brief 为当前协议栈实例选择网卡后端，需在net_init之前调用
+ *
+ * @param name 后端名
+ * @return int 成功为0，后端不存在或网卡已打开为-1
+ */
+int driver_select(const char *name)
+{
+    const driver_ops_t *ops = driver_lookup(name);
+    if (ops == NULL || net_stack->driver)
     {
-        fprintf(stderr, "Error, interface %s have the same ip %s with me.\n", d->name, iptos(net_if_ip));
+        fprintf(stderr, "Error in driver_select: %s, available:", name);
+        for (size_t i = 0; i < sizeof(driver_table) / sizeof(driver_table[0]); i++)
+            fprintf(stderr, " %s", driver_table[i]->name);
+        fprintf(stderr, "\n");
         return -1;
     }
-    for (a = d->addresses; a; a = a->next)
-        if (a->addr && a->addr->sa_family == AF_INET)
-            *(uint32_t *)mask = ((struct sockaddr_in *)(a->netmask))->sin_addr.s_addr;
-
-    strcpy(if_name, d->name);
+    net_stack->driver_ops = ops;
     return 0;
 }
 
+/**
+ * @brief 获取当前协议栈实例的网卡后端名
+ *
+ * @return const char* 后端名
+ */
+const char *driver_name()
+{
+    return driver_ops()->name;
+}
+
 /**
  * @brief 打开网卡
- * 
+ *
  * @return int 成功为0，失败为-1
  */
 int driver_open()
 {
-#ifdef _WIN32
-    /* Load Npcap and its functions. */
-    if (!LoadNpcapDlls())
-    {
-        fprintf(stderr, "Couldn't load Npcap\n");
-        return -1;
-    }
-#endif
-
-    char if_name[PCAP_BUF_SIZE];
-    uint32_t mask;
-    if (driver_find(net_if_ip, if_name, (uint8_t *)&mask) < 0)
-    {
-        fprintf(stderr, "Error in driver find.\n");
-        return -1;
-    }
-    printf("Using interface %s, my ip is %s.\n", if_name, iptos(net_if_ip));
-
-    if ((pcap = pcap_open_live(if_name, 65536, 1, 10, pcap_errbuf)) == NULL) //混杂模式打开网卡
-    {
-        fprintf(stderr, "Error in pcap_open_live.\n%s.\n", pcap_errbuf);
-        return -1;
-    }
-    if (pcap_setnonblock(pcap, 1, pcap_errbuf) < 0) //设置非阻塞模式
-    {
-        fprintf(stderr, "Error in pcap_setnonblock. %s.\n", pcap_errbuf);
-        return -1;
-    }
-    char filter_exp[PCAP_BUF_SIZE];
-    struct bpf_program fp;
-    uint8_t mac_addr[6] = NET_IF_MAC;
-    sprintf(filter_exp, //过滤数据包
-            "(ether dst %02x:%02x:%02x:%02x:%02x:%02x or ether broadcast) and (not ether src %02x:%02x:%02x:%02x:%02x:%02x)",
-            mac_addr[0], mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5],
-            mac_addr[0], mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5]);
-    if (pcap_compile(pcap, &fp, filter_exp, 0, mask) < 0)
-    {
-        fprintf(stderr, "Error in pcap_compile.\n%s.\n", pcap_geterr(pcap));
-        return -1;
-    }
-    if (pcap_setfilter(pcap, &fp) < 0)
-    {
-        fprintf(stderr, "Error in pcap_setfilter.\n%s.\n", pcap_geterr(pcap));
-        return -1;
-    }
-    return 0;
+    return driver_ops()->open();
 }
+
 /**
- * @brief 试图从网卡接收数据包
- * 
+ * @brief 试图从网卡接收一个数据包，拷贝到调用者提供的buf中
+ *
  * @param buf 收到的数据包
  * @return int 数据包的长度，未收到为0，错误为-1
  */
 int driver_recv(buf_t *buf)
 {
-    struct pcap_pkthdr *pkt_hdr;
-    const uint8_t *pkt_data;
-    int ret = pcap_next_ex(pcap, &pkt_hdr, &pkt_data);
-    if (ret == 0)
+    buf_t rx;
+    int ret = driver_ops()->recv_burst(&rx, 1);
+    if (ret <= 0)
+        return ret;
+    if (buf->data + rx.len > buf->payload + buf->size)
+    {
+        fprintf(stderr, "Error in driver_recv, packet too long: %zu.\n", rx.len);
+        buf_free(&rx);
         return 0;
-    else if (ret == 1)
+    }
+    memcpy(buf->data, rx.data, rx.len);
+    buf->len = rx.len;
+    buf->csum = rx.csum;
+    buf_free(&rx);
+    return buf->len;
+}
+
+/**
+ * @brief 试图从网卡连续接收多个数据包，每个数据包存放在从缓冲池新分配的buf中，由调用者释放
+ *
+ * @param bufs 出口参数，收到的数据包
+ * @param n 最多接收的数据包数
+ * @return int 收到的数据包数，未收到为0，错误为-1
+ */
+int driver_recv_burst(buf_t *bufs, int n)
+{
+    return driver_ops()->recv_burst(bufs, n);
+}
+
+/**
+ * @brief 与driver_recv_burst相同，但收到的buf都在当前线程的缓冲池中，
+ *        引用网卡内存的buf在此拷贝，可以保留或交给其他线程，由调用者释放
+ *
+ * @param bufs 出口参数，收到的数据包
+ * @param n 最多接收的数据包数
+ * @return int 收到的数据包数，未收到为0，错误为-1
+ */
+int driver_recv_burst_pooled(buf_t *bufs, int n)
+{
+    int m = driver_ops()->recv_burst(bufs, n), k = 0;
+    for (int i = 0; i < m; i++)
     {
-        memcpy(buf->data, pkt_data, pkt_hdr->len);
-        buf->len = pkt_hdr->len;
-        return pkt_hdr->len;
+        if (bufs[i].block == NULL)
+        {
+            buf_t view = bufs[i];
+            if (buf_clone(&bufs[k], &view) == -1)
+                continue; // 缓冲池耗尽，丢弃该包
+            bufs[k].csum = view.csum;
+        }
+        else
+            bufs[k] = bufs[i];
+        k++;
     }
-    fprintf(stderr, "Error in driver_recv.\n%s.\n", pcap_geterr(pcap));
-    return -1;
+    return m < 0 ? m : k;
 }
+
 /**
- * @brief 使用网卡发送一个数据包
- * 
- * @param buf 要发送的数据包
+ * @brief 使用网卡发送一个数据包，不在net_poll中（如应用在轮询之间发送）时立即通知网卡
+ *
+ * @param buf 要发送的数据包，可以是链式buf或待填写校验和的buf
  * @return int 成功为0，失败为-1
  */
 int driver_send(buf_t *buf)
 {
-    if (pcap_sendpacket(pcap, buf->data, buf->len) == -1)
-    {
-        fprintf(stderr, "Error in driver_send.\n%s.\n", pcap_geterr(pcap));
-        return -1;
-    }
+    return driver_send_burst(&buf, 1) == 1 ? 0 : -1;
+}
 
-    return 0;
+/**
+ * @brief 使用网卡发送一组数据包，不在net_poll中时立即通知网卡
+ *
+ * @param bufs 要发送的数据包
+ * @param n 数据包数
+ * @return int 发送成功的数据包数
+ */
+int driver_send_burst(buf_t **bufs, int n)
+{
+    int sent = driver_ops()->send_burst(bufs, n);
+    if (!net_stack->tx_batch)
+        driver_flush();
+    return sent;
+}
+
+/**
+ * @brief 通知网卡发送暂存的数据包，net_poll返回前调用，不经由net_poll处理的线程在每轮处理后调用
+ *
+ */
+void driver_flush()
+{
+    const driver_ops_t *ops = driver_ops();
+    if (ops->flush && net_stack->driver)
+        ops->flush();
 }
+
 /**
- * @brief 关闭网卡
- * 
+ * @brief 获取网卡的校验和卸载能力
+ *
+ * @return int NET_CAP_*的组合
+ */
+int driver_caps()
+{
+    return driver_ops()->caps();
+}
+
+/**
+ * @brief 获取网卡能收发的最大ip数据包长度
+ *
+ * @return int 长度
+ */
+int driver_mtu()
+{
+    return driver_ops()->mtu();
+}
+
+/**
+ * @brief 获取可用于select/poll/epoll等待数据包到达的文件描述符
+ *
+ * @return int 文件描述符，后端不支持时为-1，此时只能轮询
+ */
+int driver_get_fd()
+{
+    return driver_ops()->get_fd();
+}
+
+/**
+ * @brief 关闭网卡，未打开或与其他实例共用时什么也不做
+ *
  */
 void driver_close()
 {
-    pcap_close(pcap);
+    if (net_stack->driver)
+        driver_ops()->close();
+    net_stack->driver = NULL;
+}
+
+#ifdef __linux__
+/**
+ * @brief 供Linux后端按ip进行前缀匹配，选取最长前缀匹配的网卡，定义DRIVER_IF_NAME时直接使用它
+ *
+ * @param ip ip地址
+ * @param if_name 出口参数，选取的网卡名，长度为IF_NAMESIZE
+ * @return int 成功为0，失败为-1
+ */
+int driver_find_if(uint8_t *ip, char *if_name)
+{
+#ifdef DRIVER_IF_NAME
+    strncpy(if_name, DRIVER_IF_NAME, IF_NAMESIZE - 1);
+    return 0;
+#else
+    struct ifaddrs *ifs;
+    if (getifaddrs(&ifs) == -1)
+    {
+        fprintf(stderr, "Error in getifaddrs: %s\n", strerror(errno));
+        return -1;
+    }
+    uint8_t max_match = 0;
+    for (struct ifaddrs *a = ifs; a; a = a->ifa_next)
+    {
+        if (!a->ifa_addr || a->ifa_addr->sa_family != AF_INET || !a->ifa_netmask)
+            continue;
+        uint8_t *addr = (uint8_t *)&((struct sockaddr_in *)a->ifa_addr)->sin_addr.s_addr;
+        uint8_t *mask = (uint8_t *)&((struct sockaddr_in *)a->ifa_netmask)->sin_addr.s_addr;
+        uint8_t mask_all[NET_IP_LEN] = {0xFF, 0xFF, 0xFF, 0xFF};
+        uint8_t match = ip_prefix_match(ip, addr);
+        if (match < ip_prefix_match(mask_all, mask) || match <= max_match)
+            continue;
+        if (match == 32)
+        {
+            fprintf(stderr, "Error, interface %s have the same ip %s with me.\n", a->ifa_name, iptos(ip));
+            freeifaddrs(ifs);
+            return -1;
+        }
+        max_match = match;
+        strncpy(if_name, a->ifa_name, IF_NAMESIZE - 1);
+    }
+    freeifaddrs(ifs);
+    if (max_match == 0)
+    {
+        fprintf(stderr, "Error, no interface found.\n");
+        return -1;
+    }
+    return 0;
+#endif
 }
+#endif
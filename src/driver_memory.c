@@ -0,0 +1,180 @@
+#include "driver.h"
+#include "ethernet.h"
+#include "ring.h"
+
+typedef struct driver_memory_frame //内存网卡队列中的一帧
+{
+    size_t len;
+    uint8_t data[ETHERNET_MAX_TRANSPORT_UNIT + sizeof(ether_hdr_t)];
+} driver_memory_frame_t;
+
+typedef struct driver_memory //内存网卡，帧由其他线程注入与取走，不经过任何设备
+{
+    ring_t rx; // 注入的帧，可由多个线程注入，运行协议栈的线程接收
+    ring_t tx; // 发送的帧，共用网卡的各实例都可发送，队列满时丢弃，由一个线程取走
+} driver_memory_t;
+
+static _Thread_local driver_memory_frame_t driver_memory_frame; //发送与接收时拷贝帧的暂存区
+
+/**
+ * @brief 打开内存网卡，分配收发队列
+ *
+ * @return int 成功为0，内存不足为-1
+ */
+static int driver_memory_open()
+{
+    driver_memory_t *mem = malloc(sizeof(driver_memory_t));
+    if (mem == NULL || ring_init(&mem->rx, DRIVER_MEMORY_SLOTS, sizeof(driver_memory_frame_t)) == -1)
+    {
+        fprintf(stderr, "Error in driver_memory_open.\n");
+        free(mem);
+        return -1;
+    }
+    if (ring_init(&mem->tx, DRIVER_MEMORY_SLOTS, sizeof(driver_memory_frame_t)) == -1)
+    {
+        fprintf(stderr, "Error in driver_memory_open.\n");
+        ring_free(&mem->rx);
+        free(mem);
+        return -1;
+    }
+    net_stack->driver = mem;
+    return 0;
+}
+
+/**
+ * @brief 接收注入的帧，每帧存放在从缓冲池新分配的buf中，由调用者释放
+ *
+ * @param bufs 出口参数，收到的数据包
+ * @param n 最多接收的数据包数
+ * @return int 收到的数据包数
+ */
+static int driver_memory_recv_burst(buf_t *bufs, int n)
+{
+    driver_memory_t *mem = net_stack->driver;
+    driver_memory_frame_t *frame = &driver_memory_frame;
+    int i = 0;
+    while (i < n && ring_pop_burst(&mem->rx, frame, 1))
+    {
+        if (buf_alloc(&bufs[i], frame->len) == -1)
+            continue; // 缓冲池耗尽，丢弃该帧
+        memcpy(bufs[i].data, frame->data, frame->len);
+        i++;
+    }
+    return i;
+}
+
+/**
+ * @brief 把一组数据包放入发送队列，链式buf与待填写校验和的buf在拷贝时聚合并填写校验和
+ *        队列满时丢弃，与没有接收者的链路一样仍算作发送成功
+ *
+ * @param bufs 要发送的数据包
+ * @param n 数据包数
+ * @return int 发送成功的数据包数
+ */
+static int driver_memory_send_burst(buf_t **bufs, int n)
+{
+    driver_memory_t *mem = net_stack->driver;
+    driver_memory_frame_t *frame = &driver_memory_frame;
+    for (int i = 0; i < n; i++)
+    {
+        frame->len = buf_chain_len(bufs[i]);
+        if (frame->len > sizeof(frame->data))
+        {
+            fprintf(stderr, "Error in driver_memory_send_burst, packet too long: %zu.\n", frame->len);
+            return i;
+        }
+        buf_gather_complete(bufs[i], frame->data);
+        ring_mp_push_burst(&mem->tx, frame, 1);
+    }
+    return n;
+}
+
+/**
+ * @brief 内存网卡没有可等待的文件描述符
+ *
+ * @return int 总是-1
+ */
+static int driver_memory_get_fd()
+{
+    return -1;
+}
+
+/**
+ * @brief 发送时的校验和在拷贝到发送队列时填写，注入的帧不做校验
+ *
+ * @return int NET_CAP_*的组合
+ */
+static int driver_memory_caps()
+{
+    return NET_CAP_TX_CSUM;
+}
+
+/**
+ * @brief 队列中每帧的容量按以太网的最大传输单元
+ *
+ * @return int 长度
+ */
+static int driver_memory_mtu()
+{
+    return ETHERNET_MAX_TRANSPORT_UNIT;
+}
+
+/**
+ * @brief 关闭内存网卡，队列中剩余的帧被丢弃
+ *
+ */
+static void driver_memory_close()
+{
+    driver_memory_t *mem = net_stack->driver;
+    ring_free(&mem->rx);
+    ring_free(&mem->tx);
+    free(mem);
+}
+
+const driver_ops_t driver_memory = {
+    .name = "memory",
+    .open = driver_memory_open,
+    .recv_burst = driver_memory_recv_burst,
+    .send_burst = driver_memory_send_burst,
+    .get_fd = driver_memory_get_fd,
+    .caps = driver_memory_caps,
+    .mtu = driver_memory_mtu,
+    .close = driver_memory_close,
+};
+
+/**
+ * @brief 向使用内存网卡的协议栈实例注入一帧，可在任意线程中调用
+ *
+ * @param stack 协议栈实例，网卡需已打开
+ * @param frame 帧
+ * @param len 长度
+ * @return int 成功为0，网卡未打开、帧过长或队列满为-1
+ */
+int driver_memory_inject(net_stack_t *stack, const void *frame, size_t len)
+{
+    driver_memory_t *mem = stack->driver;
+    driver_memory_frame_t *slot = &driver_memory_frame;
+    if (stack->driver_ops != &driver_memory || mem == NULL || len > sizeof(slot->data))
+        return -1;
+    slot->len = len;
+    memcpy(slot->data, frame, len);
+    return ring_mp_push_burst(&mem->rx, slot, 1) ? 0 : -1;
+}
+
+/**
+ * @brief 取走使用内存网卡的协议栈实例发送的一帧，同一实例只能由一个线程取
+ *
+ * @param stack 协议栈实例，网卡需已打开
+ * @param frame 出口参数，帧，超过size的部分被截断
+ * @param size frame的容量
+ * @return size_t 帧的长度，没有帧为0
+ */
+size_t driver_memory_take(net_stack_t *stack, void *frame, size_t size)
+{
+    driver_memory_t *mem = stack->driver;
+    driver_memory_frame_t *slot = &driver_memory_frame;
+    if (stack->driver_ops != &driver_memory || mem == NULL || ring_pop_burst(&mem->tx, slot, 1) == 0)
+        return 0;
+    memcpy(frame, slot->data, slot->len < size ? slot->len : size);
+    return slot->len;
+}
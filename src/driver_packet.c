@@ -0,0 +1,372 @@
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+#include "driver.h"
+#include "ethernet.h"
+
+#ifndef TP_STATUS_CSUM_VALID
+#define TP_STATUS_CSUM_VALID (1 << 7) //网卡已校验过该包，较早的内核头文件中没有定义
+#endif
+#define DRIVER_PACKET_TX_DATA (TPACKET3_HDRLEN - sizeof(struct sockaddr_ll)) //发送环中帧数据相对帧头的偏移
+
+typedef struct driver_packet //AF_PACKET网卡，收发各一个与内核共享的TPACKET_V3环
+{
+    int fd;
+    uint8_t *map;           // 收发环的映射，接收环在前
+    size_t map_len;
+    int mtu;                // 网卡的MTU
+    uint32_t rx_block;      // 下一个要读取的接收块
+    uint32_t rx_left;       // rx_block中尚未读取的包数，0表示尚未开始读取
+    struct tpacket3_hdr *rx_pkt; // rx_block中下一个要读取的包
+    uint32_t rx_release;    // 上次接收借出的第一个块，到下次接收时才交还内核
+    uint32_t rx_held;       // 上次接收借出、已读完的块数
+    uint8_t *tx_ring;       // 发送环
+    uint32_t tx_head;       // 下一个要填写的发送帧
+    int tx_lock;            // 共用网卡的各实例在发送环上的互斥
+    int tx_pending;         // 已填写、尚未通知内核发送的帧数
+} driver_packet_t;
+
+/**
+ * @brief 在套接字上挂接与pcap后端相同的过滤器：
+ *        只接收发往本机MAC或广播的帧，不接收本机发出的帧，也供uring后端使用
+ *
+ * @param fd 套接字
+ * @return int 成功为0，失败为-1
+ */
+int driver_packet_filter(int fd)
+{
+    uint8_t *mac = net_stack->if_mac;
+    uint32_t mac_hi = (uint32_t)mac[0] << 24 | mac[1] << 16 | mac[2] << 8 | mac[3];
+    uint32_t mac_lo = mac[4] << 8 | mac[5];
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 0),                 // 目的MAC的前4字节
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, mac_hi, 0, 2),
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 4),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, mac_lo, 4, 0),     // 发往本机，检查源MAC
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0xFFFFFFFF, 0, 7),
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 4),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0xFFFF, 0, 5),     // 广播
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, NET_MAC_LEN),       // 源MAC
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, mac_hi, 0, 2),
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, NET_MAC_LEN + 4),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, mac_lo, 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, 0xFFFFFFFF),                 // 接收
+        BPF_STMT(BPF_RET | BPF_K, 0),                          // 丢弃
+    };
+    struct sock_fprog prog = {.len = sizeof(code) / sizeof(code[0]), .filter = code};
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) == -1)
+    {
+        fprintf(stderr, "Error in SO_ATTACH_FILTER: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 内部函数，建立收发环并映射到用户空间
+ *
+ * @param packet 网卡
+ * @return int 成功为0，失败为-1
+ */
+static int driver_packet_ring(driver_packet_t *packet)
+{
+    int version = TPACKET_V3;
+    if (setsockopt(packet->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) == -1)
+    {
+        fprintf(stderr, "Error in PACKET_VERSION: %s\n", strerror(errno));
+        return -1;
+    }
+    struct tpacket_req3 rx = {
+        .tp_block_size = DRIVER_PACKET_BLOCK_SIZE,
+        .tp_block_nr = DRIVER_PACKET_RX_BLOCKS,
+        .tp_frame_size = DRIVER_PACKET_FRAME_SIZE,
+        .tp_frame_nr = DRIVER_PACKET_BLOCK_SIZE / DRIVER_PACKET_FRAME_SIZE * DRIVER_PACKET_RX_BLOCKS,
+        .tp_retire_blk_tov = DRIVER_PACKET_BLOCK_TOV_MS,
+    };
+    struct tpacket_req3 tx = {
+        .tp_block_size = DRIVER_PACKET_BLOCK_SIZE,
+        .tp_block_nr = DRIVER_PACKET_TX_BLOCKS,
+        .tp_frame_size = DRIVER_PACKET_FRAME_SIZE,
+        .tp_frame_nr = DRIVER_PACKET_BLOCK_SIZE / DRIVER_PACKET_FRAME_SIZE * DRIVER_PACKET_TX_BLOCKS,
+    };
+    if (setsockopt(packet->fd, SOL_PACKET, PACKET_RX_RING, &rx, sizeof(rx)) == -1 ||
+        setsockopt(packet->fd, SOL_PACKET, PACKET_TX_RING, &tx, sizeof(tx)) == -1)
+    {
+        fprintf(stderr, "Error in PACKET_RX_RING/PACKET_TX_RING: %s\n", strerror(errno));
+        return -1;
+    }
+    packet->map_len = (size_t)DRIVER_PACKET_BLOCK_SIZE * (DRIVER_PACKET_RX_BLOCKS + DRIVER_PACKET_TX_BLOCKS);
+    packet->map = mmap(NULL, packet->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, packet->fd, 0);
+    if (packet->map == MAP_FAILED) // 锁定内存受限时退回普通映射
+        packet->map = mmap(NULL, packet->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, packet->fd, 0);
+    if (packet->map == MAP_FAILED)
+    {
+        fprintf(stderr, "Error in mmap: %s\n", strerror(errno));
+        packet->map = NULL;
+        return -1;
+    }
+    packet->tx_ring = packet->map + (size_t)DRIVER_PACKET_BLOCK_SIZE * DRIVER_PACKET_RX_BLOCKS;
+    return 0;
+}
+
+/**
+ * @brief 内部函数，释放网卡的全部资源
+ *
+ * @param packet 网卡
+ */
+static void driver_packet_free(driver_packet_t *packet)
+{
+    if (packet->map)
+        munmap(packet->map, packet->map_len);
+    if (packet->fd >= 0)
+        close(packet->fd);
+    free(packet);
+}
+
+/**
+ * @brief 用AF_PACKET打开与本机ip同网段的网卡，收发都经由与内核共享的内存环
+ *
+ * @return int 成功为0，失败为-1
+ */
+static int driver_packet_open()
+{
+    char if_name[IF_NAMESIZE] = {0};
+    if (driver_find_if(net_stack->if_ip, if_name) == -1)
+    {
+        fprintf(stderr, "Error in driver find.\n");
+        return -1;
+    }
+    printf("Using interface %s, my ip is %s.\n", if_name, iptos(net_stack->if_ip));
+    driver_packet_t *packet = calloc(1, sizeof(driver_packet_t));
+    if (packet == NULL)
+    {
+        fprintf(stderr, "Error in driver_packet_open, out of memory.\n");
+        return -1;
+    }
+    packet->fd = socket(AF_PACKET, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, htons(ETH_P_ALL));
+    if (packet->fd == -1)
+    {
+        fprintf(stderr, "Error in socket(AF_PACKET): %s\n", strerror(errno));
+        driver_packet_free(packet);
+        return -1;
+    }
+    struct ifreq ifr = {0};
+    strncpy(ifr.ifr_name, if_name, IF_NAMESIZE - 1);
+    packet->mtu = ioctl(packet->fd, SIOCGIFMTU, &ifr) == 0 ? ifr.ifr_mtu : ETHERNET_MAX_TRANSPORT_UNIT;
+    struct sockaddr_ll addr = {
+        .sll_family = AF_PACKET,
+        .sll_protocol = htons(ETH_P_ALL),
+        .sll_ifindex = if_nametoindex(if_name),
+    };
+    struct packet_mreq mreq = {.mr_ifindex = addr.sll_ifindex, .mr_type = PACKET_MR_PROMISC}; //本机MAC与网卡的不同，混杂模式接收
+    int one = 1;
+    setsockopt(packet->fd, SOL_PACKET, PACKET_LOSS, &one, sizeof(one)); //格式错误的帧直接丢弃，不卡住发送环
+    if (addr.sll_ifindex == 0 || driver_packet_filter(packet->fd) == -1 || driver_packet_ring(packet) == -1 ||
+        bind(packet->fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        setsockopt(packet->fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) == -1)
+    {
+        fprintf(stderr, "Error in driver_packet_open: %s: %s\n", if_name, strerror(errno));
+        driver_packet_free(packet);
+        return -1;
+    }
+    setsockopt(packet->fd, SOL_PACKET, PACKET_QDISC_BYPASS, &one, sizeof(one)); //发送不经过排队规则，失败时仍可用
+    net_stack->driver = packet;
+    return 0;
+}
+
+/**
+ * @brief 内部函数，接收块的块头
+ *
+ * @param packet 网卡
+ * @param block 块号
+ * @return struct tpacket_block_desc* 块头
+ */
+static inline struct tpacket_block_desc *driver_packet_block(driver_packet_t *packet, uint32_t block)
+{
+    return (struct tpacket_block_desc *)(packet->map + (size_t)block * DRIVER_PACKET_BLOCK_SIZE);
+}
+
+/**
+ * @brief 从接收环中接收数据包，不拷贝，buf直接引用环中的数据，block为NULL
+ *        数据包所在的块在下一次接收时才交还内核，因此buf只在下一次接收前有效，需要保留的调用者应拷贝
+ *
+ * @param bufs 出口参数，收到的数据包
+ * @param n 最多接收的数据包数
+ * @return int 收到的数据包数
+ */
+static int driver_packet_recv_burst(buf_t *bufs, int n)
+{
+    driver_packet_t *packet = net_stack->driver;
+    for (; packet->rx_held; packet->rx_held--, packet->rx_release = (packet->rx_release + 1) % DRIVER_PACKET_RX_BLOCKS)
+        __atomic_store_n(&driver_packet_block(packet, packet->rx_release)->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    int i = 0;
+    while (i < n)
+    {
+        struct tpacket_block_desc *block = driver_packet_block(packet, packet->rx_block);
+        if (packet->rx_left == 0)
+        {
+            if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+                break;
+            packet->rx_left = block->hdr.bh1.num_pkts;
+            packet->rx_pkt = (struct tpacket3_hdr *)((uint8_t *)block + block->hdr.bh1.offset_to_first_pkt);
+            if (packet->rx_left == 0) // 空块也要交还
+                packet->rx_left = 1, packet->rx_pkt = NULL;
+        }
+        struct tpacket3_hdr *pkt = packet->rx_pkt;
+        if (pkt && pkt->tp_snaplen == pkt->tp_len)
+        {
+            buf_t view = BUF_VIEW((uint8_t *)pkt + pkt->tp_mac, pkt->tp_snaplen);
+            bufs[i] = view;
+            // 本机生成、校验和尚未填写的包与网卡已校验的包都不再校验
+            if (pkt->tp_status & (TP_STATUS_CSUMNOTREADY | TP_STATUS_CSUM_VALID))
+                bufs[i].csum = BUF_CSUM_UNNECESSARY;
+            i++;
+        }
+        if (pkt)
+            packet->rx_pkt = (struct tpacket3_hdr *)((uint8_t *)pkt + pkt->tp_next_offset);
+        if (--packet->rx_left == 0)
+        {
+            if (packet->rx_held++ == 0)
+                packet->rx_release = packet->rx_block;
+            packet->rx_block = (packet->rx_block + 1) % DRIVER_PACKET_RX_BLOCKS;
+        }
+    }
+    return i;
+}
+
+/**
+ * @brief 内部函数，发送环中的一帧
+ *
+ * @param packet 网卡
+ * @param frame 帧号
+ * @return struct tpacket3_hdr* 帧头
+ */
+static inline struct tpacket3_hdr *driver_packet_tx_frame(driver_packet_t *packet, uint32_t frame)
+{
+    return (struct tpacket3_hdr *)(packet->tx_ring + (size_t)frame * DRIVER_PACKET_FRAME_SIZE);
+}
+
+/**
+ * @brief 通知内核发送发送环中已填写的帧
+ *
+ */
+static void driver_packet_flush()
+{
+    driver_packet_t *packet = net_stack->driver;
+    if (__atomic_exchange_n(&packet->tx_pending, 0, __ATOMIC_ACQ_REL) == 0)
+        return;
+    if (sendto(packet->fd, NULL, 0, MSG_DONTWAIT, NULL, 0) == -1 && errno != EAGAIN && errno != ENOBUFS)
+        fprintf(stderr, "Error in driver_packet_flush: %s\n", strerror(errno));
+}
+
+/**
+ * @brief 把一组数据包拷贝到发送环，链式buf与待填写校验和的buf在拷贝时聚合并填写校验和
+ *        帧在driver_flush时一次通知内核发送，发送环满时先通知内核，仍满则放弃其余的包
+ *
+ * @param bufs 要发送的数据包
+ * @param n 数据包数
+ * @return int 放入发送环的数据包数
+ */
+static int driver_packet_send_burst(buf_t **bufs, int n)
+{
+    driver_packet_t *packet = net_stack->driver;
+    const uint32_t frames = DRIVER_PACKET_BLOCK_SIZE / DRIVER_PACKET_FRAME_SIZE * DRIVER_PACKET_TX_BLOCKS;
+    int i = 0, flushed = 0;
+    while (__atomic_test_and_set(&packet->tx_lock, __ATOMIC_ACQUIRE))
+        cpu_relax();
+    while (i < n)
+    {
+        size_t len = buf_chain_len(bufs[i]);
+        if (len > DRIVER_PACKET_FRAME_SIZE - DRIVER_PACKET_TX_DATA)
+        {
+            fprintf(stderr, "Error in driver_packet_send_burst, packet too long: %zu.\n", len);
+            break;
+        }
+        struct tpacket3_hdr *frame = driver_packet_tx_frame(packet, packet->tx_head);
+        uint32_t status = __atomic_load_n(&frame->tp_status, __ATOMIC_ACQUIRE);
+        if (status != TP_STATUS_AVAILABLE && status != TP_STATUS_WRONG_FORMAT)
+        {
+            if (flushed)
+                break;
+            __atomic_clear(&packet->tx_lock, __ATOMIC_RELEASE);
+            driver_packet_flush();
+            flushed = 1;
+            while (__atomic_test_and_set(&packet->tx_lock, __ATOMIC_ACQUIRE))
+                cpu_relax();
+            continue;
+        }
+        buf_gather_complete(bufs[i], (uint8_t *)frame + DRIVER_PACKET_TX_DATA);
+        frame->tp_len = len;
+        frame->tp_snaplen = len;
+        frame->tp_next_offset = 0;
+        __atomic_store_n(&frame->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+        packet->tx_head = (packet->tx_head + 1) % frames;
+        i++;
+    }
+    __atomic_add_fetch(&packet->tx_pending, i, __ATOMIC_RELEASE);
+    __atomic_clear(&packet->tx_lock, __ATOMIC_RELEASE);
+    return i;
+}
+
+/**
+ * @brief 接收环有块可读时套接字可读
+ *
+ * @return int 文件描述符
+ */
+static int driver_packet_get_fd()
+{
+    driver_packet_t *packet = net_stack->driver;
+    return packet->fd;
+}
+
+/**
+ * @brief 发送时的校验和在拷贝到发送环时填写，接收时内核标记的包不再校验
+ *
+ * @return int NET_CAP_*的组合
+ */
+static int driver_packet_caps()
+{
+    return NET_CAP_TX_CSUM;
+}
+
+/**
+ * @brief 网卡的MTU，不超过发送环一帧的容量
+ *
+ * @return int 长度
+ */
+static int driver_packet_mtu()
+{
+    driver_packet_t *packet = net_stack->driver;
+    return min32(packet->mtu, DRIVER_PACKET_FRAME_SIZE - DRIVER_PACKET_TX_DATA - sizeof(ether_hdr_t));
+}
+
+/**
+ * @brief 关闭网卡，尚未发送的帧被丢弃
+ *
+ */
+static void driver_packet_close()
+{
+    driver_packet_free(net_stack->driver);
+}
+
+const driver_ops_t driver_packet = {
+    .name = "packet",
+    .open = driver_packet_open,
+    .recv_burst = driver_packet_recv_burst,
+    .send_burst = driver_packet_send_burst,
+    .flush = driver_packet_flush,
+    .get_fd = driver_packet_get_fd,
+    .caps = driver_packet_caps,
+    .mtu = driver_packet_mtu,
+    .close = driver_packet_close,
+};
+#endif
@@ -0,0 +1,292 @@
+#include <pcap.h>
+#include "driver.h"
+
+#ifdef _WIN32
+#include <tchar.h>
+/**
+ * @brief npcp官方提供的加载npcap的dll库函数
+ * 
+ * @return BOOL 是否成功
+ */
+BOOL LoadNpcapDlls()
+{
+    _TCHAR npcap_dir[512];
+    UINT len;
+    len = GetSystemDirectory(npcap_dir, 480);
+    if (!len)
+    {
+        fprintf(stderr, "Error in GetSystemDirectory: %lx", GetLastError());
+        return FALSE;
+    }
+    _tcscat_s(npcap_dir, 512, _T("\\Npcap"));
+    if (SetDllDirectory(npcap_dir) == 0)
+    {
+        fprintf(stderr, "Error in SetDllDirectory: %lx", GetLastError());
+        return FALSE;
+    }
+    return TRUE;
+}
+#endif
+
+static _Thread_local char pcap_errbuf[PCAP_ERRBUF_SIZE];
+
+/**
+ * @brief 根据ip进行前缀匹配，选取最长前缀匹配的网卡
+ * 
+ * @param ip ip地址
+ * @param if_name 出口参数，选取的网卡名
+ * @param mask 出口参数，该网卡的掩码
+ * @return int 成功为0，失败为-1
+ */
+static int driver_pcap_find(uint8_t *ip, char *if_name, uint8_t *mask)
+{
+    pcap_if_t *alldevs;
+    pcap_if_t *d;
+    pcap_addr_t *a;
+    size_t i;
+    uint8_t match[PCAP_BUF_SIZE] = {0};
+    size_t if_num = 0;
+    uint32_t mask_all = PCAP_NETMASK_UNKNOWN;
+    if (pcap_findalldevs(&alldevs, pcap_errbuf) == -1)
+    {
+        fprintf(stderr, "Error in pcap_findalldevs: %s\n", pcap_errbuf);
+        return -1;
+    }
+
+    for (d = alldevs; d; d = d->next, if_num++)
+        for (a = d->addresses; a; a = a->next)
+            if (a->addr && a->addr->sa_family == AF_INET)
+            {
+                match[if_num] = ip_prefix_match(ip, (uint8_t *)&((struct sockaddr_in *)a->addr)->sin_addr.s_addr);
+                if (match[if_num] < ip_prefix_match((uint8_t *)&mask_all, (uint8_t *)&((struct sockaddr_in *)(a->netmask))->sin_addr.s_addr))
+                    match[if_num] = 0;
+            }
+    if (if_num == 0)
+    {
+        fprintf(stderr, "Error, no interface found.\n");
+        return -1;
+    }
+    uint8_t max_match = 0;
+    size_t max_if = 0;
+    for (i = 0; i < if_num; i++)
+        if (match[i] > max_match)
+            max_if = i, max_match = match[i];
+    if (max_match == 0)
+    {
+        fprintf(stderr, "Error, no interface found.\n");
+        return -1;
+    }
+
+    for (d = alldevs, i = 0; i < max_if; d = d->next, i++)
+        ;
+    if (max_match == 32)
+    {
+        fprintf(stderr, "Error, interface %s have the same ip %s with me.\n", d->name, iptos(net_stack->if_ip));
+        return -1;
+    }
+    for (a = d->addresses; a; a = a->next)
+        if (a->addr && a->addr->sa_family == AF_INET)
+            *(uint32_t *)mask = ((struct sockaddr_in *)(a->netmask))->sin_addr.s_addr;
+
+    strcpy(if_name, d->name);
+    return 0;
+}
+
+/**
+ * @brief 用pcap打开与本机ip同网段的网卡
+ * 
+ * @return int 成功为0，失败为-1
+ */
+static int driver_pcap_open()
+{
+#ifdef _WIN32
+    /* Load Npcap and its functions. */
+    if (!LoadNpcapDlls())
+    {
+        fprintf(stderr, "Couldn't load Npcap\n");
+        return -1;
+    }
+#endif
+
+    char if_name[PCAP_BUF_SIZE];
+    uint32_t mask;
+    if (driver_pcap_find(net_stack->if_ip, if_name, (uint8_t *)&mask) < 0)
+    {
+        fprintf(stderr, "Error in driver find.\n");
+        return -1;
+    }
+    printf("Using interface %s, my ip is %s.\n", if_name, iptos(net_stack->if_ip));
+
+    pcap_t *pcap = pcap_create(if_name, pcap_errbuf);
+    if (pcap == NULL)
+    {
+        fprintf(stderr, "Error in pcap_create.\n%s.\n", pcap_errbuf);
+        return -1;
+    }
+    net_stack->driver = pcap; //每个协议栈实例打开自己的网卡句柄
+    pcap_set_snaplen(pcap, 65536);
+    pcap_set_promisc(pcap, 1); //混杂模式打开网卡
+    pcap_set_timeout(pcap, 10);
+    pcap_set_immediate_mode(pcap, 1); //数据包到达即唤醒driver_get_fd的等待者，不等缓冲区填满
+    if (pcap_activate(pcap) < 0)
+    {
+        fprintf(stderr, "Error in pcap_activate.\n%s.\n", pcap_geterr(pcap));
+        return -1;
+    }
+    if (pcap_setnonblock(pcap, 1, pcap_errbuf) < 0) //设置非阻塞模式
+    {
+        fprintf(stderr, "Error in pcap_setnonblock. %s.\n", pcap_errbuf);
+        return -1;
+    }
+    char filter_exp[PCAP_BUF_SIZE];
+    struct bpf_program fp;
+    uint8_t *mac_addr = net_stack->if_mac;
+    sprintf(filter_exp, //过滤数据包
+            "(ether dst %02x:%02x:%02x:%02x:%02x:%02x or ether broadcast) and (not ether src %02x:%02x:%02x:%02x:%02x:%02x)",
+            mac_addr[0], mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5],
+            mac_addr[0], mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5]);
+    if (pcap_compile(pcap, &fp, filter_exp, 0, mask) < 0)
+    {
+        fprintf(stderr, "Error in pcap_compile.\n%s.\n", pcap_geterr(pcap));
+        return -1;
+    }
+    if (pcap_setfilter(pcap, &fp) < 0)
+    {
+        fprintf(stderr, "Error in pcap_setfilter.\n%s.\n", pcap_geterr(pcap));
+        return -1;
+    }
+    return 0;
+}
+/**
+ * @brief 试图从网卡连续接收多个数据包，每个数据包存放在从缓冲池新分配的buf中，由调用者释放
+ * 
+ * @param bufs 出口参数，收到的数据包
+ * @param n 最多接收的数据包数
+ * @return int 收到的数据包数，未收到为0，错误为-1
+ */
+static int driver_pcap_recv_burst(buf_t *bufs, int n)
+{
+    pcap_t *pcap = net_stack->driver;
+    int i = 0;
+    while (i < n)
+    {
+        struct pcap_pkthdr *pkt_hdr;
+        const uint8_t *pkt_data;
+        int ret = pcap_next_ex(pcap, &pkt_hdr, &pkt_data);
+        if (ret == 0)
+            break;
+        if (ret != 1)
+        {
+            fprintf(stderr, "Error in driver_pcap_recv_burst.\n%s.\n", pcap_geterr(pcap));
+            return i ? i : -1;
+        }
+        if (buf_alloc(&bufs[i], pkt_hdr->len) == -1)
+            continue; // 过长或缓冲池耗尽，丢弃该包
+        memcpy(bufs[i].data, pkt_data, pkt_hdr->len);
+        i++;
+    }
+    return i;
+}
+
+/**
+ * @brief 使用网卡发送一个数据包
+ *        pcap只能发送连续的数据，链式buf在此处聚合到发送帧中，
+ *        待填写校验和的数据包也拷贝到发送帧，拷贝的同时计算校验和，不修改原数据包
+ * 
+ * @param buf 要发送的数据包
+ * @return int 成功为0，失败为-1
+ */
+static int driver_pcap_send(buf_t *buf)
+{
+    static _Thread_local uint8_t frame[BUF_MTU_SIZE];
+    pcap_t *pcap = net_stack->driver;
+    uint8_t *data = buf->data;
+    size_t len = buf->len;
+    if (buf->next || buf->csum == BUF_CSUM_PARTIAL)
+    {
+        len = buf_chain_len(buf);
+        if (len > sizeof(frame))
+        {
+            fprintf(stderr, "Error in driver_pcap_send, packet too long: %zu.\n", len);
+            return -1;
+        }
+        data = frame;
+        buf_gather_complete(buf, frame);
+    }
+    if (pcap_sendpacket(pcap, data, len) == -1)
+    {
+        fprintf(stderr, "Error in driver_pcap_send.\n%s.\n", pcap_geterr(pcap));
+        return -1;
+    }
+
+    return 0;
+}
+/**
+ * @brief pcap一次只能发送一个数据包，逐个发送
+ * 
+ * @param bufs 要发送的数据包
+ * @param n 数据包数
+ * @return int 发送成功的数据包数
+ */
+static int driver_pcap_send_burst(buf_t **bufs, int n)
+{
+    int i = 0;
+    while (i < n && driver_pcap_send(bufs[i]) == 0)
+        i++;
+    return i;
+}
+
+/**
+ * @brief 获取网卡的校验和卸载能力
+ *        发送时的校验和在driver_pcap_send拷贝数据时顺带填写，接收时pcap不做校验
+ * 
+ * @return int NET_CAP_*的组合
+ */
+static int driver_pcap_caps()
+{
+    return NET_CAP_TX_CSUM;
+}
+
+/**
+ * @brief 获取可用于select/poll/epoll等待数据包到达的文件描述符
+ * 
+ * @return int 文件描述符，平台不支持时为-1，此时只能轮询
+ */
+static int driver_pcap_get_fd()
+{
+#ifdef _WIN32
+    return -1;
+#else
+    return pcap_get_selectable_fd(net_stack->driver);
+#endif
+}
+
+/**
+ * @brief pcap不提供网卡的MTU，按以太网的最大传输单元
+ * 
+ * @return int 长度
+ */
+static int driver_pcap_mtu()
+{
+    return ETHERNET_MAX_TRANSPORT_UNIT;
+}
+
+/**
+ * @brief 关闭网卡
+ * 
+ */
+static void driver_pcap_close()
+{
+    pcap_close(net_stack->driver);
+}
+
+const driver_ops_t driver_pcap = {
+    .name = "pcap",
+    .open = driver_pcap_open,
+    .recv_burst = driver_pcap_recv_burst,
+    .send_burst = driver_pcap_send_burst,
+    .get_fd = driver_pcap_get_fd,
+    .caps = driver_pcap_caps,
+    .mtu = driver_pcap_mtu,
+    .close = driver_pcap_close,
+};
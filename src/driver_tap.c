@@ -0,0 +1,303 @@
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <linux/if_tun.h>
+#include <linux/virtio_net.h>
+#include "driver.h"
+#include "ethernet.h"
+
+#define DRIVER_TAP_IOV 16 //发送时writev的最大段数，含vnet头，更长的链先聚合
+
+typedef struct driver_tap //TAP网卡，每个队列一个文件描述符，每帧前带virtio_net_hdr
+{
+    int fds[DRIVER_TAP_QUEUES];
+    int epfd;               // 监听全部队列的epoll，作为可等待的文件描述符
+    int mtu;                // 网卡的MTU
+    int rx_queue;           // 下一次接收从该队列开始，各队列轮流
+    int tx_next;            // 分配给下一个发送线程的队列
+} driver_tap_t;
+
+static _Thread_local int driver_tap_tx_queue = -1; //当前线程发送用的队列，各线程分开，互不争用
+static _Thread_local uint8_t driver_tap_frame[ETHERNET_MAX_TRANSPORT_UNIT + sizeof(ether_hdr_t)]; //段数过多时聚合的暂存区
+
+/**
+ * @brief 打开TAP网卡的一个非阻塞队列，网卡不存在时创建，收发的每帧前带virtio_net_hdr，也供uring后端使用
+ *
+ * @param name 网卡名
+ * @return int 文件描述符，失败为-1
+ */
+int driver_tap_queue(const char *name)
+{
+    int fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd == -1)
+    {
+        fprintf(stderr, "Error in open(/dev/net/tun): %s\n", strerror(errno));
+        return -1;
+    }
+    struct ifreq ifr = {0};
+    strncpy(ifr.ifr_name, name, IF_NAMESIZE - 1);
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI | IFF_VNET_HDR | (DRIVER_TAP_QUEUES > 1 ? IFF_MULTI_QUEUE : 0);
+    int hdr_len = sizeof(struct virtio_net_hdr);
+    if (ioctl(fd, TUNSETIFF, &ifr) == -1 || ioctl(fd, TUNSETVNETHDRSZ, &hdr_len) == -1 ||
+        ioctl(fd, TUNSETOFFLOAD, TUN_F_CSUM) == -1) // 只协商校验和卸载，协议栈不收发超过MTU的分段
+    {
+        fprintf(stderr, "Error in TUNSETIFF: %s: %s\n", name, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief 启用内核一侧的网卡，定义DRIVER_TAP_HOST_IP时同时为其配置地址，也供uring后端使用
+ *
+ * @param name 网卡名
+ * @param mtu 出口参数，网卡的MTU
+ * @return int 成功为0，失败为-1
+ */
+int driver_tap_up(const char *name, int *mtu)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock == -1)
+    {
+        fprintf(stderr, "Error in socket: %s\n", strerror(errno));
+        return -1;
+    }
+    struct ifreq ifr = {0};
+    strncpy(ifr.ifr_name, name, IF_NAMESIZE - 1);
+    *mtu = ioctl(sock, SIOCGIFMTU, &ifr) == 0 ? ifr.ifr_mtu : ETHERNET_MAX_TRANSPORT_UNIT;
+    int ret = ioctl(sock, SIOCGIFFLAGS, &ifr);
+#ifdef DRIVER_TAP_HOST_IP
+    struct ifreq addr = {0};
+    struct sockaddr_in *in = (struct sockaddr_in *)&addr.ifr_addr;
+    strncpy(addr.ifr_name, name, IF_NAMESIZE - 1);
+    in->sin_family = AF_INET;
+    if (ret == 0 && inet_pton(AF_INET, DRIVER_TAP_HOST_IP, &in->sin_addr) == 1)
+        ret = ioctl(sock, SIOCSIFADDR, &addr);
+    if (ret == 0 && inet_pton(AF_INET, DRIVER_TAP_HOST_MASK, &in->sin_addr) == 1)
+        ret = ioctl(sock, SIOCSIFNETMASK, &addr);
+#endif
+    ifr.ifr_flags |= IFF_UP;
+    if (ret == 0)
+        ret = ioctl(sock, SIOCSIFFLAGS, &ifr);
+    if (ret == -1)
+        fprintf(stderr, "Error in driver_tap_up: %s: %s\n", name, strerror(errno));
+    close(sock);
+    return ret;
+}
+
+/**
+ * @brief 内部函数，释放网卡的全部资源
+ *
+ * @param tap 网卡
+ */
+static void driver_tap_free(driver_tap_t *tap)
+{
+    for (int q = 0; q < DRIVER_TAP_QUEUES; q++)
+        if (tap->fds[q] >= 0)
+            close(tap->fds[q]);
+    if (tap->epfd >= 0)
+        close(tap->epfd);
+    free(tap);
+}
+
+/**
+ * @brief 打开或创建DRIVER_TAP_NAME网卡，内核一侧即为对端，收发都带virtio_net_hdr以传递校验和状态
+ *        各队列的文件描述符全部关闭后非持久的网卡随之消失
+ *
+ * @return int 成功为0，失败为-1
+ */
+static int driver_tap_open()
+{
+    driver_tap_t *tap = calloc(1, sizeof(driver_tap_t));
+    if (tap == NULL)
+    {
+        fprintf(stderr, "Error in driver_tap_open, out of memory.\n");
+        return -1;
+    }
+    for (int q = 0; q < DRIVER_TAP_QUEUES; q++)
+        tap->fds[q] = -1;
+    tap->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (tap->epfd == -1)
+    {
+        fprintf(stderr, "Error in epoll_create1: %s\n", strerror(errno));
+        driver_tap_free(tap);
+        return -1;
+    }
+    for (int q = 0; q < DRIVER_TAP_QUEUES; q++)
+    {
+        struct epoll_event ev = {.events = EPOLLIN, .data.u32 = q};
+        if ((tap->fds[q] = driver_tap_queue(DRIVER_TAP_NAME)) == -1 ||
+            epoll_ctl(tap->epfd, EPOLL_CTL_ADD, tap->fds[q], &ev) == -1)
+        {
+            driver_tap_free(tap);
+            return -1;
+        }
+    }
+    if (driver_tap_up(DRIVER_TAP_NAME, &tap->mtu) == -1)
+    {
+        driver_tap_free(tap);
+        return -1;
+    }
+    printf("Using tap %s with %d queues, my ip is %s.\n", DRIVER_TAP_NAME, DRIVER_TAP_QUEUES, iptos(net_stack->if_ip));
+    net_stack->driver = tap;
+    return 0;
+}
+
+/**
+ * @brief 从各队列轮流接收数据包，vnet头与帧用readv分别读入，帧直接落在从缓冲池新分配的buf中，由调用者释放
+ *        内核已校验或只填了部分校验和的帧标记为无需校验
+ *
+ * @param bufs 出口参数，收到的数据包
+ * @param n 最多接收的数据包数
+ * @return int 收到的数据包数，错误为-1
+ */
+static int driver_tap_recv_burst(buf_t *bufs, int n)
+{
+    driver_tap_t *tap = net_stack->driver;
+    int i = 0, idle = 0;
+    while (i < n && idle < DRIVER_TAP_QUEUES)
+    {
+        int q = tap->rx_queue;
+        struct virtio_net_hdr hdr;
+        if (buf_alloc_pool(&bufs[i], BUF_POOL_MTU, 0) == -1)
+            break; // 缓冲池耗尽，帧留在队列中
+        struct iovec iov[2] = {
+            {.iov_base = &hdr, .iov_len = sizeof(hdr)},
+            {.iov_base = bufs[i].data, .iov_len = bufs[i].payload + bufs[i].size - bufs[i].data},
+        };
+        ssize_t len = readv(tap->fds[q], iov, 2);
+        if (len <= (ssize_t)sizeof(hdr) || hdr.gso_type != VIRTIO_NET_HDR_GSO_NONE)
+        {
+            buf_free(&bufs[i]);
+            if (len == -1 && errno != EAGAIN)
+            {
+                fprintf(stderr, "Error in driver_tap_recv_burst: %s\n", strerror(errno));
+                return i ? i : -1;
+            }
+            if (len == -1) // 该队列已空，换下一个
+            {
+                tap->rx_queue = (q + 1) % DRIVER_TAP_QUEUES;
+                idle++;
+            }
+            continue;
+        }
+        bufs[i].len = len - sizeof(hdr);
+        if (hdr.flags & (VIRTIO_NET_HDR_F_NEEDS_CSUM | VIRTIO_NET_HDR_F_DATA_VALID))
+            bufs[i].csum = BUF_CSUM_UNNECESSARY;
+        tap->rx_queue = (q + 1) % DRIVER_TAP_QUEUES; // 每读一帧换一个队列，忙的队列不会饿死其他队列
+        idle = 0;
+        i++;
+    }
+    return i;
+}
+
+/**
+ * @brief 用当前线程的队列发送一组数据包，vnet头与链式buf的各段用writev一次写入，不拷贝
+ *        待填写校验和的buf把起点与偏移放在vnet头中，由内核或对端填写
+ *
+ * @param bufs 要发送的数据包
+ * @param n 数据包数
+ * @return int 发送成功的数据包数
+ */
+static int driver_tap_send_burst(buf_t **bufs, int n)
+{
+    driver_tap_t *tap = net_stack->driver;
+    if (driver_tap_tx_queue < 0)
+        driver_tap_tx_queue = __atomic_fetch_add(&tap->tx_next, 1, __ATOMIC_RELAXED) % DRIVER_TAP_QUEUES;
+    int fd = tap->fds[driver_tap_tx_queue];
+    for (int i = 0; i < n; i++)
+    {
+        struct virtio_net_hdr hdr = {.gso_type = VIRTIO_NET_HDR_GSO_NONE};
+        struct iovec iov[DRIVER_TAP_IOV] = {{.iov_base = &hdr, .iov_len = sizeof(hdr)}};
+        int cnt = 1;
+        const buf_t *seg = bufs[i];
+        for (; seg && cnt < DRIVER_TAP_IOV; seg = seg->next)
+            if (seg->len)
+                iov[cnt++] = (struct iovec){.iov_base = seg->data, .iov_len = seg->len};
+        if (seg) // 段数过多，聚合并填写校验和后再写
+        {
+            size_t len = buf_chain_len(bufs[i]);
+            if (len > sizeof(driver_tap_frame))
+            {
+                fprintf(stderr, "Error in driver_tap_send_burst, packet too long: %zu.\n", len);
+                return i;
+            }
+            iov[1] = (struct iovec){.iov_base = driver_tap_frame, .iov_len = buf_gather_complete(bufs[i], driver_tap_frame)};
+            cnt = 2;
+        }
+        else if (bufs[i]->csum == BUF_CSUM_PARTIAL)
+        {
+            hdr.flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+            hdr.csum_start = bufs[i]->csum_start;
+            hdr.csum_offset = bufs[i]->csum_offset;
+        }
+        if (writev(fd, iov, cnt) == -1)
+        {
+            if (errno != EAGAIN && errno != ENOBUFS)
+                fprintf(stderr, "Error in driver_tap_send_burst: %s\n", strerror(errno));
+            return i;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief 任一队列有帧时可读的epoll文件描述符
+ *
+ * @return int 文件描述符
+ */
+static int driver_tap_get_fd()
+{
+    driver_tap_t *tap = net_stack->driver;
+    return tap->epfd;
+}
+
+/**
+ * @brief 发送时的校验和经vnet头交给内核填写，接收时内核标记的帧不再校验
+ *
+ * @return int NET_CAP_*的组合
+ */
+static int driver_tap_caps()
+{
+    return NET_CAP_TX_CSUM;
+}
+
+/**
+ * @brief 网卡的MTU，不超过MTU级buf除去预留空间后的容量
+ *
+ * @return int 长度
+ */
+static int driver_tap_mtu()
+{
+    driver_tap_t *tap = net_stack->driver;
+    return min32(tap->mtu, BUF_MTU_SIZE - BUF_HEADROOM - sizeof(ether_hdr_t));
+}
+
+/**
+ * @brief 关闭网卡，非持久的网卡随之消失
+ *
+ */
+static void driver_tap_close()
+{
+    driver_tap_free(net_stack->driver);
+}
+
+const driver_ops_t driver_tap = {
+    .name = "tap",
+    .open = driver_tap_open,
+    .recv_burst = driver_tap_recv_burst,
+    .send_burst = driver_tap_send_burst,
+    .get_fd = driver_tap_get_fd,
+    .caps = driver_tap_caps,
+    .mtu = driver_tap_mtu,
+    .close = driver_tap_close,
+};
+#endif
@@ -0,0 +1,689 @@
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/io_uring.h>
+#include <linux/virtio_net.h>
+#include "driver.h"
+#include "ethernet.h"
+
+#define DRIVER_URING_OP_READ_MULTISHOT 49 //IORING_OP_READ_MULTISHOT，内核6.7加入，较早的头文件中没有
+#ifndef IORING_ASYNC_CANCEL_ANY
+#define IORING_ASYNC_CANCEL_ANY (1U << 2) //取消全部请求，内核6.0加入
+#endif
+#define DRIVER_URING_CANCEL UINT64_MAX //取消请求的user_data，收发请求的user_data为队列号或块号
+#define DRIVER_URING_HDR_LEN sizeof(struct virtio_net_hdr)
+
+typedef struct driver_uring_ring //一个io_uring实例，提交队列与完成队列映射到用户空间
+{
+    int fd;
+    void *map;              // 两个队列共用的映射
+    size_t map_len;
+    struct io_uring_sqe *sqes;
+    size_t sqes_len;
+    uint32_t *sq_head;
+    uint32_t *sq_tail;
+    uint32_t *sq_flags;
+    uint32_t *sq_array;
+    uint32_t sq_mask;
+    uint32_t *cq_head;
+    uint32_t *cq_tail;
+    struct io_uring_cqe *cqes;
+    uint32_t cq_mask;
+    uint32_t flags;         // 建立时的IORING_SETUP_*
+} driver_uring_ring_t;
+
+typedef struct driver_uring //经io_uring收发的TAP网卡或AF_PACKET套接字，每帧前带virtio_net_hdr
+{
+    int fds[DRIVER_TAP_QUEUES]; // 收发的文件描述符，packet只用第一个
+    int fd_num;
+    uint8_t rx_op;          // 多发接收请求的操作码
+    int mtu;                // 网卡的MTU
+    driver_uring_ring_t rx; // 接收用，只由打开网卡的线程访问
+    driver_uring_ring_t tx; // 发送用，由发送锁保护
+    buf_pool_t *pool;       // 接收与发送帧所在的缓冲池
+    buf_t *frames;          // 按块号索引，内核持有的块（在提供缓冲环中或预留作发送帧），未持有时block为NULL
+    struct io_uring_buf_ring *br; // 提供给多发接收请求的缓冲环
+    size_t br_len;
+    int rx_held;            // 在提供缓冲环中的块数
+    uint32_t rearm;         // 多发接收请求已终止、需要重新提交的队列
+    int fixed;              // 缓冲池内存已注册为发送环的固定缓冲
+    uint32_t *tx_free;      // 空闲发送帧的块号
+    uint32_t tx_free_num;
+    uint32_t tx_next;       // 下一帧从该队列发出，各队列轮流
+    int tx_lock;            // 共用网卡的各实例在发送环上的互斥
+} driver_uring_t;
+
+/**
+ * @brief 内部函数，缓冲池块的块号，即提供缓冲环中的缓冲编号
+ *
+ * @param uring 网卡
+ * @param buf 缓冲池中的buf
+ * @return uint32_t 块号
+ */
+static inline uint32_t driver_uring_index(driver_uring_t *uring, const buf_t *buf)
+{
+    return (buf->payload - uring->pool->arena) / uring->pool->stride;
+}
+
+/**
+ * @brief 内部函数，io_uring_enter系统调用，glibc没有提供封装
+ *
+ * @param ring io_uring实例
+ * @param submit 提交的请求数
+ * @param wait 至少等待的完成数
+ * @param flags IORING_ENTER_*
+ * @return int 系统调用的返回值
+ */
+static int driver_uring_enter(driver_uring_ring_t *ring, uint32_t submit, uint32_t wait, uint32_t flags)
+{
+    return syscall(__NR_io_uring_enter, ring->fd, submit, wait, flags, NULL, 0);
+}
+
+/**
+ * @brief 内部函数，建立一个io_uring实例并映射其队列，要求内核支持单次映射
+ *
+ * @param ring 出口参数，io_uring实例
+ * @param entries 提交队列的大小
+ * @param cq_entries 完成队列的大小，0为默认
+ * @param flags IORING_SETUP_*
+ * @return int 成功为0，失败为-1
+ */
+static int driver_uring_setup(driver_uring_ring_t *ring, uint32_t entries, uint32_t cq_entries, uint32_t flags)
+{
+    struct io_uring_params p = {.flags = flags | (cq_entries ? IORING_SETUP_CQSIZE : 0), .cq_entries = cq_entries};
+    ring->fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (ring->fd == -1)
+    {
+        fprintf(stderr, "Error in io_uring_setup: %s\n", strerror(errno));
+        return -1;
+    }
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        fprintf(stderr, "Error in io_uring_setup, kernel too old.\n");
+        return -1;
+    }
+    ring->flags = p.flags;
+    size_t sq_len = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    size_t cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring->map_len = sq_len > cq_len ? sq_len : cq_len;
+    ring->map = mmap(NULL, ring->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->map == MAP_FAILED || ring->sqes == MAP_FAILED)
+    {
+        fprintf(stderr, "Error in mmap: %s\n", strerror(errno));
+        ring->map = ring->map == MAP_FAILED ? NULL : ring->map;
+        ring->sqes = ring->sqes == MAP_FAILED ? NULL : ring->sqes;
+        return -1;
+    }
+    uint8_t *map = ring->map;
+    ring->sq_head = (uint32_t *)(map + p.sq_off.head);
+    ring->sq_tail = (uint32_t *)(map + p.sq_off.tail);
+    ring->sq_flags = (uint32_t *)(map + p.sq_off.flags);
+    ring->sq_array = (uint32_t *)(map + p.sq_off.array);
+    ring->sq_mask = *(uint32_t *)(map + p.sq_off.ring_mask);
+    ring->cq_head = (uint32_t *)(map + p.cq_off.head);
+    ring->cq_tail = (uint32_t *)(map + p.cq_off.tail);
+    ring->cqes = (struct io_uring_cqe *)(map + p.cq_off.cqes);
+    ring->cq_mask = *(uint32_t *)(map + p.cq_off.ring_mask);
+    return 0;
+}
+
+/**
+ * @brief 内部函数，取提交队列的下一个空位，填写完后由driver_uring_commit放入队列
+ *        调用者保证队列不满：接收环的请求数不超过队列数，发送环的请求数不超过发送帧数
+ *
+ * @param ring io_uring实例
+ * @return struct io_uring_sqe* 清零的请求
+ */
+static struct io_uring_sqe *driver_uring_sqe(driver_uring_ring_t *ring)
+{
+    uint32_t tail = *ring->sq_tail;
+    struct io_uring_sqe *sqe = &ring->sqes[tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[tail & ring->sq_mask] = tail & ring->sq_mask;
+    return sqe;
+}
+
+/**
+ * @brief 内部函数，把driver_uring_sqe取得的请求放入提交队列
+ *
+ * @param ring io_uring实例
+ */
+static void driver_uring_commit(driver_uring_ring_t *ring)
+{
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief 内部函数，通知内核处理提交队列中的请求，SQPOLL模式下只在内核线程休眠时唤醒它
+ *
+ * @param ring io_uring实例
+ * @return int 成功为0，失败为-1
+ */
+static int driver_uring_submit(driver_uring_ring_t *ring)
+{
+    if (ring->flags & IORING_SETUP_SQPOLL)
+    {
+        if (__atomic_load_n(ring->sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP)
+            driver_uring_enter(ring, 0, 0, IORING_ENTER_SQ_WAKEUP);
+        return 0;
+    }
+    uint32_t submit = *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (submit && driver_uring_enter(ring, submit, 0, 0) == -1 && errno != EAGAIN && errno != EBUSY && errno != EINTR)
+    {
+        fprintf(stderr, "Error in io_uring_enter: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 内部函数，取消io_uring实例上的全部请求并等待取消完成，此后内核不再写入缓冲池
+ *
+ * @param ring io_uring实例
+ */
+static void driver_uring_cancel(driver_uring_ring_t *ring)
+{
+    driver_uring_submit(ring); // 先提交尚未提交的请求，腾出提交队列的空位
+    struct io_uring_sqe *sqe = driver_uring_sqe(ring);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+    sqe->user_data = DRIVER_URING_CANCEL;
+    driver_uring_commit(ring);
+    for (int done = 0; !done;)
+    {
+        uint32_t flags = IORING_ENTER_GETEVENTS | (ring->flags & IORING_SETUP_SQPOLL ? IORING_ENTER_SQ_WAKEUP : 0);
+        if (driver_uring_enter(ring, *ring->sq_tail - *ring->sq_head, 1, flags) == -1 && errno != EINTR)
+            return;
+        uint32_t head = *ring->cq_head, tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+            done |= ring->cqes[head & ring->cq_mask].user_data == DRIVER_URING_CANCEL;
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * @brief 内部函数，释放io_uring实例
+ *
+ * @param ring io_uring实例
+ */
+static void driver_uring_ring_free(driver_uring_ring_t *ring)
+{
+    if (ring->sqes)
+        munmap(ring->sqes, ring->sqes_len);
+    if (ring->map)
+        munmap(ring->map, ring->map_len);
+    if (ring->fd >= 0)
+        close(ring->fd);
+}
+
+/**
+ * @brief 内部函数，为终止的多发接收请求重新提交，各队列一个请求，缓冲从提供缓冲环中选取
+ *
+ * @param uring 网卡
+ */
+static void driver_uring_arm(driver_uring_t *uring)
+{
+    for (int q = 0; q < uring->fd_num; q++)
+    {
+        if (!(uring->rearm & (1U << q)))
+            continue;
+        struct io_uring_sqe *sqe = driver_uring_sqe(&uring->rx);
+        sqe->opcode = uring->rx_op;
+        sqe->fd = uring->fds[q];
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = 0;
+        sqe->ioprio = uring->rx_op == IORING_OP_RECV ? IORING_RECV_MULTISHOT : 0;
+        sqe->user_data = q;
+        driver_uring_commit(&uring->rx);
+    }
+    if (driver_uring_submit(&uring->rx) == 0)
+        uring->rearm = 0;
+}
+
+/**
+ * @brief 内部函数，从缓冲池分配块放入提供缓冲环，补足到DRIVER_URING_RX_BUFS块，之后重新提交终止的接收请求
+ *        每块的数据区预留BUF_HEADROOM，vnet头落在预留空间的末尾，帧紧随其后，恰好在data处
+ *        只在打开网卡的线程中补充，缓冲池耗尽时少放
+ *
+ * @param uring 网卡
+ */
+static void driver_uring_refill(driver_uring_t *uring)
+{
+    if (buf_pool_current(BUF_POOL_MTU) != uring->pool)
+        return;
+    uint16_t tail = uring->br->tail, n = 0;
+    buf_t buf;
+    while (uring->rx_held < DRIVER_URING_RX_BUFS && buf_alloc_pool(&buf, BUF_POOL_MTU, 0) == 0)
+    {
+        uint32_t index = driver_uring_index(uring, &buf);
+        uring->frames[index] = buf;
+        uring->br->bufs[(uint16_t)(tail + n++) & (DRIVER_URING_RX_BUFS - 1)] = (struct io_uring_buf){
+            .addr = (uintptr_t)(buf.data - DRIVER_URING_HDR_LEN),
+            .len = buf.payload + buf.size - buf.data + DRIVER_URING_HDR_LEN,
+            .bid = index,
+        };
+        uring->rx_held++;
+    }
+    if (n)
+        __atomic_store_n(&uring->br->tail, (uint16_t)(tail + n), __ATOMIC_RELEASE);
+    if (uring->rearm && uring->rx_held)
+        driver_uring_arm(uring);
+}
+
+/**
+ * @brief 内部函数，建立收发两个io_uring实例：接收环注册提供缓冲环，各队列提交一个多发接收请求；
+ *        发送环注册缓冲池内存为固定缓冲，并从缓冲池预留发送帧
+ *
+ * @param uring 网卡，文件描述符已打开
+ * @return int 成功为0，失败为-1
+ */
+static int driver_uring_start(driver_uring_t *uring)
+{
+    uring->pool = buf_pool_current(BUF_POOL_MTU);
+    uring->frames = calloc(uring->pool->stats.total, sizeof(buf_t));
+    uring->tx_free = malloc(DRIVER_URING_TX_SLOTS * sizeof(uint32_t));
+    if (uring->frames == NULL || uring->tx_free == NULL)
+    {
+        fprintf(stderr, "Error in driver_uring_start, out of memory.\n");
+        return -1;
+    }
+#ifdef DRIVER_URING_SQPOLL
+    uint32_t tx_flags = IORING_SETUP_SQPOLL;
+#else
+    uint32_t tx_flags = 0;
+#endif
+    if (driver_uring_setup(&uring->rx, uring->fd_num + 1, DRIVER_URING_RX_BUFS * 2, 0) == -1 ||
+        driver_uring_setup(&uring->tx, DRIVER_URING_TX_SLOTS, 0, tx_flags) == -1)
+        return -1;
+
+    struct io_uring_probe *probe = calloc(1, sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op));
+    int supported = probe && syscall(__NR_io_uring_register, uring->rx.fd, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+                    uring->rx_op <= probe->last_op && (probe->ops[uring->rx_op].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    if (!supported)
+    {
+        fprintf(stderr, "Error in driver_uring_start, io_uring op %d not supported by the kernel.\n", uring->rx_op);
+        return -1;
+    }
+
+    uring->br_len = DRIVER_URING_RX_BUFS * sizeof(struct io_uring_buf);
+    uring->br = mmap(NULL, uring->br_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    struct io_uring_buf_reg reg = {.ring_addr = (uintptr_t)uring->br, .ring_entries = DRIVER_URING_RX_BUFS, .bgid = 0};
+    if (uring->br == MAP_FAILED || syscall(__NR_io_uring_register, uring->rx.fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1)
+    {
+        fprintf(stderr, "Error in IORING_REGISTER_PBUF_RING: %s\n", strerror(errno));
+        uring->br = uring->br == MAP_FAILED ? NULL : uring->br;
+        return -1;
+    }
+    struct iovec arena = {.iov_base = uring->pool->arena, .iov_len = uring->pool->stride * uring->pool->stats.total};
+    // 锁定内存受限时退回普通写，每次发送由内核临时映射页面
+    uring->fixed = syscall(__NR_io_uring_register, uring->tx.fd, IORING_REGISTER_BUFFERS, &arena, 1) == 0;
+
+    for (int i = 0; i < DRIVER_URING_TX_SLOTS; i++)
+    {
+        buf_t buf;
+        if (buf_alloc_pool(&buf, BUF_POOL_MTU, 0) == -1)
+        {
+            fprintf(stderr, "Error in driver_uring_start, buffer pool exhausted.\n");
+            return -1;
+        }
+        uint32_t index = driver_uring_index(uring, &buf);
+        uring->frames[index] = buf;
+        uring->tx_free[uring->tx_free_num++] = index;
+    }
+    uring->rearm = (1U << uring->fd_num) - 1;
+    driver_uring_refill(uring);
+    return uring->rearm ? -1 : 0;
+}
+
+/**
+ * @brief 内部函数，取消全部请求并释放网卡的全部资源，内核持有的块归还缓冲池
+ *
+ * @param uring 网卡
+ */
+static void driver_uring_free(driver_uring_t *uring)
+{
+    driver_uring_ring_t *rings[] = {&uring->rx, &uring->tx};
+    for (size_t i = 0; i < sizeof(rings) / sizeof(rings[0]); i++)
+    {
+        if (rings[i]->map)
+            driver_uring_cancel(rings[i]);
+        driver_uring_ring_free(rings[i]);
+    }
+    if (uring->br)
+        munmap(uring->br, uring->br_len);
+    for (int q = 0; q < DRIVER_TAP_QUEUES; q++)
+        if (uring->fds[q] >= 0)
+            close(uring->fds[q]);
+    if (uring->frames)
+        for (size_t i = 0; i < uring->pool->stats.total; i++)
+            buf_free(&uring->frames[i]);
+    free(uring->frames);
+    free(uring->tx_free);
+    free(uring);
+}
+
+/**
+ * @brief 内部函数，分配网卡，各文件描述符初始为-1
+ *
+ * @return driver_uring_t* 网卡，内存不足为NULL
+ */
+static driver_uring_t *driver_uring_alloc()
+{
+    driver_uring_t *uring = calloc(1, sizeof(driver_uring_t));
+    if (uring == NULL)
+    {
+        fprintf(stderr, "Error in driver_uring_alloc, out of memory.\n");
+        return NULL;
+    }
+    for (int q = 0; q < DRIVER_TAP_QUEUES; q++)
+        uring->fds[q] = -1;
+    uring->rx.fd = uring->tx.fd = -1;
+    return uring;
+}
+
+/**
+ * @brief 打开或创建DRIVER_TAP_NAME网卡，各队列上用IORING_OP_READ_MULTISHOT持续接收，需要内核6.7以上
+ *        需在此后分配buf的线程中打开，收到的buf须归还到该线程
+ *
+ * @return int 成功为0，失败为-1
+ */
+static int driver_uring_tap_open()
+{
+    driver_uring_t *uring = driver_uring_alloc();
+    if (uring == NULL)
+        return -1;
+    uring->fd_num = DRIVER_TAP_QUEUES;
+    uring->rx_op = DRIVER_URING_OP_READ_MULTISHOT;
+    for (int q = 0; q < DRIVER_TAP_QUEUES; q++)
+    {
+        if ((uring->fds[q] = driver_tap_queue(DRIVER_TAP_NAME)) == -1)
+        {
+            driver_uring_free(uring);
+            return -1;
+        }
+    }
+    if (driver_tap_up(DRIVER_TAP_NAME, &uring->mtu) == -1 || driver_uring_start(uring) == -1)
+    {
+        driver_uring_free(uring);
+        return -1;
+    }
+    printf("Using tap %s with %d queues via io_uring, my ip is %s.\n", DRIVER_TAP_NAME, DRIVER_TAP_QUEUES, iptos(net_stack->if_ip));
+    net_stack->driver = uring;
+    return 0;
+}
+
+/**
+ * @brief 用AF_PACKET套接字打开与本机ip同网段的网卡，带vnet头收发以传递校验和状态，
+ *        用多发IORING_OP_RECV持续接收，需要内核6.0以上
+ *        需在此后分配buf的线程中打开，收到的buf须归还到该线程
+ *
+ * @return int 成功为0，失败为-1
+ */
+static int driver_uring_packet_open()
+{
+    char if_name[IF_NAMESIZE] = {0};
+    if (driver_find_if(net_stack->if_ip, if_name) == -1)
+    {
+        fprintf(stderr, "Error in driver find.\n");
+        return -1;
+    }
+    printf("Using interface %s via io_uring, my ip is %s.\n", if_name, iptos(net_stack->if_ip));
+    driver_uring_t *uring = driver_uring_alloc();
+    if (uring == NULL)
+        return -1;
+    uring->fd_num = 1;
+    uring->rx_op = IORING_OP_RECV;
+    uring->fds[0] = socket(AF_PACKET, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, htons(ETH_P_ALL));
+    if (uring->fds[0] == -1)
+    {
+        fprintf(stderr, "Error in socket(AF_PACKET): %s\n", strerror(errno));
+        driver_uring_free(uring);
+        return -1;
+    }
+    struct ifreq ifr = {0};
+    strncpy(ifr.ifr_name, if_name, IF_NAMESIZE - 1);
+    uring->mtu = ioctl(uring->fds[0], SIOCGIFMTU, &ifr) == 0 ? ifr.ifr_mtu : ETHERNET_MAX_TRANSPORT_UNIT;
+    struct sockaddr_ll addr = {
+        .sll_family = AF_PACKET,
+        .sll_protocol = htons(ETH_P_ALL),
+        .sll_ifindex = if_nametoindex(if_name),
+    };
+    struct packet_mreq mreq = {.mr_ifindex = addr.sll_ifindex, .mr_type = PACKET_MR_PROMISC}; //本机MAC与网卡的不同，混杂模式接收
+    int one = 1;
+    if (addr.sll_ifindex == 0 || driver_packet_filter(uring->fds[0]) == -1 ||
+        setsockopt(uring->fds[0], SOL_PACKET, PACKET_VNET_HDR, &one, sizeof(one)) == -1 ||
+        bind(uring->fds[0], (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        setsockopt(uring->fds[0], SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) == -1)
+    {
+        fprintf(stderr, "Error in driver_uring_packet_open: %s: %s\n", if_name, strerror(errno));
+        driver_uring_free(uring);
+        return -1;
+    }
+    setsockopt(uring->fds[0], SOL_PACKET, PACKET_QDISC_BYPASS, &one, sizeof(one)); //发送不经过排队规则，失败时仍可用
+    if (driver_uring_start(uring) == -1)
+    {
+        driver_uring_free(uring);
+        return -1;
+    }
+    net_stack->driver = uring;
+    return 0;
+}
+
+/**
+ * @brief 从接收环的完成队列中接收数据包，不需要系统调用，不拷贝，buf就是内核写入的缓冲池块，由调用者释放
+ *        之后补充提供缓冲环，多发请求因缓冲耗尽等原因终止时在此重新提交，这是稳态下唯一的系统调用
+ *
+ * @param bufs 出口参数，收到的数据包
+ * @param n 最多接收的数据包数
+ * @return int 收到的数据包数
+ */
+static int driver_uring_recv_burst(buf_t *bufs, int n)
+{
+    driver_uring_t *uring = net_stack->driver;
+    driver_uring_ring_t *rx = &uring->rx;
+    uint32_t head = *rx->cq_head, tail = __atomic_load_n(rx->cq_tail, __ATOMIC_ACQUIRE);
+    int i = 0;
+    for (; head != tail && i < n; head++)
+    {
+        struct io_uring_cqe *cqe = &rx->cqes[head & rx->cq_mask];
+        if (cqe->user_data >= (uint64_t)uring->fd_num)
+            continue;
+        if (!(cqe->flags & IORING_CQE_F_MORE))
+            uring->rearm |= 1U << cqe->user_data;
+        if (!(cqe->flags & IORING_CQE_F_BUFFER))
+        {
+            if (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED)
+                fprintf(stderr, "Error in driver_uring_recv_burst: %s\n", strerror(-cqe->res));
+            continue;
+        }
+        buf_t *frame = &uring->frames[cqe->flags >> IORING_CQE_BUFFER_SHIFT];
+        struct virtio_net_hdr *hdr = (struct virtio_net_hdr *)(frame->data - DRIVER_URING_HDR_LEN);
+        uring->rx_held--;
+        if (cqe->res <= (int)DRIVER_URING_HDR_LEN || hdr->gso_type != VIRTIO_NET_HDR_GSO_NONE)
+        {
+            buf_free(frame);
+            continue;
+        }
+        bufs[i] = *frame;
+        bufs[i].len = cqe->res - DRIVER_URING_HDR_LEN;
+        if (hdr->flags & (VIRTIO_NET_HDR_F_NEEDS_CSUM | VIRTIO_NET_HDR_F_DATA_VALID))
+            bufs[i].csum = BUF_CSUM_UNNECESSARY;
+        frame->block = NULL;
+        i++;
+    }
+    __atomic_store_n(rx->cq_head, head, __ATOMIC_RELEASE);
+    driver_uring_refill(uring);
+    return i;
+}
+
+/**
+ * @brief 内部函数，回收内核已写完的发送帧，需持有发送锁
+ *
+ * @param uring 网卡
+ */
+static void driver_uring_complete(driver_uring_t *uring)
+{
+    driver_uring_ring_t *tx = &uring->tx;
+    uint32_t head = *tx->cq_head, tail = __atomic_load_n(tx->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++)
+    {
+        struct io_uring_cqe *cqe = &tx->cqes[head & tx->cq_mask];
+        if (cqe->user_data == DRIVER_URING_CANCEL)
+            continue;
+        if (cqe->res < 0 && cqe->res != -EAGAIN && cqe->res != -ENOBUFS)
+            fprintf(stderr, "Error in driver_uring_complete: %s\n", strerror(-cqe->res));
+        uring->tx_free[uring->tx_free_num++] = cqe->user_data;
+    }
+    __atomic_store_n(tx->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief 一次系统调用提交发送环中的全部写请求，写TAP与套接字通常在此同步完成，SQPOLL模式下不需要系统调用
+ *
+ */
+static void driver_uring_flush()
+{
+    driver_uring_t *uring = net_stack->driver;
+    while (__atomic_test_and_set(&uring->tx_lock, __ATOMIC_ACQUIRE))
+        cpu_relax();
+    driver_uring_submit(&uring->tx);
+    driver_uring_complete(uring);
+    __atomic_clear(&uring->tx_lock, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief 把一组数据包聚合到预留的发送帧中，帧前放vnet头，作为写请求放入发送环
+ *        待填写校验和的buf把起点与偏移放在vnet头中，由内核或对端填写
+ *        请求在driver_flush时一次提交，发送帧用尽时先提交，仍不够则放弃其余的包
+ *
+ * @param bufs 要发送的数据包
+ * @param n 数据包数
+ * @return int 放入发送环的数据包数
+ */
+static int driver_uring_send_burst(buf_t **bufs, int n)
+{
+    driver_uring_t *uring = net_stack->driver;
+    int i = 0, flushed = 0;
+    while (__atomic_test_and_set(&uring->tx_lock, __ATOMIC_ACQUIRE))
+        cpu_relax();
+    driver_uring_complete(uring);
+    while (i < n)
+    {
+        size_t len = buf_chain_len(bufs[i]);
+        if (len > uring->pool->stats.size - DRIVER_URING_HDR_LEN)
+        {
+            fprintf(stderr, "Error in driver_uring_send_burst, packet too long: %zu.\n", len);
+            break;
+        }
+        if (uring->tx_free_num == 0)
+        {
+            if (flushed)
+                break;
+            driver_uring_submit(&uring->tx);
+            driver_uring_complete(uring);
+            flushed = 1;
+            continue;
+        }
+        uint32_t index = uring->tx_free[--uring->tx_free_num];
+        buf_t *frame = &uring->frames[index];
+        struct virtio_net_hdr *hdr = (struct virtio_net_hdr *)frame->payload;
+        *hdr = (struct virtio_net_hdr){.gso_type = VIRTIO_NET_HDR_GSO_NONE};
+        if (bufs[i]->csum == BUF_CSUM_PARTIAL)
+        {
+            buf_gather(bufs[i], frame->payload + DRIVER_URING_HDR_LEN);
+            hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+            hdr->csum_start = bufs[i]->csum_start;
+            hdr->csum_offset = bufs[i]->csum_offset;
+        }
+        else
+            buf_gather_complete(bufs[i], frame->payload + DRIVER_URING_HDR_LEN);
+        struct io_uring_sqe *sqe = driver_uring_sqe(&uring->tx);
+        sqe->opcode = uring->fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        sqe->fd = uring->fds[uring->tx_next++ % uring->fd_num];
+        sqe->addr = (uintptr_t)frame->payload;
+        sqe->len = len + DRIVER_URING_HDR_LEN;
+        sqe->buf_index = 0;
+        sqe->user_data = index;
+        driver_uring_commit(&uring->tx);
+        i++;
+    }
+    __atomic_clear(&uring->tx_lock, __ATOMIC_RELEASE);
+    return i;
+}
+
+/**
+ * @brief 接收环的完成队列非空时io_uring的文件描述符可读
+ *
+ * @return int 文件描述符
+ */
+static int driver_uring_get_fd()
+{
+    driver_uring_t *uring = net_stack->driver;
+    return uring->rx.fd;
+}
+
+/**
+ * @brief 发送时的校验和经vnet头交给内核填写，接收时内核标记的帧不再校验
+ *
+ * @return int NET_CAP_*的组合
+ */
+static int driver_uring_caps()
+{
+    return NET_CAP_TX_CSUM;
+}
+
+/**
+ * @brief 网卡的MTU，不超过MTU级buf除去预留空间后的容量
+ *
+ * @return int 长度
+ */
+static int driver_uring_mtu()
+{
+    driver_uring_t *uring = net_stack->driver;
+    return min32(uring->mtu, BUF_MTU_SIZE - BUF_HEADROOM - sizeof(ether_hdr_t));
+}
+
+/**
+ * @brief 关闭网卡，取消在途的请求，尚未发送的帧被丢弃
+ *
+ */
+static void driver_uring_close()
+{
+    driver_uring_free(net_stack->driver);
+}
+
+const driver_ops_t driver_uring_tap = {
+    .name = "uring-tap",
+    .open = driver_uring_tap_open,
+    .recv_burst = driver_uring_recv_burst,
+    .send_burst = driver_uring_send_burst,
+    .flush = driver_uring_flush,
+    .get_fd = driver_uring_get_fd,
+    .caps = driver_uring_caps,
+    .mtu = driver_uring_mtu,
+    .close = driver_uring_close,
+};
+
+const driver_ops_t driver_uring_packet = {
+    .name = "uring-packet",
+    .open = driver_uring_packet_open,
+    .recv_burst = driver_uring_recv_burst,
+    .send_burst = driver_uring_send_burst,
+    .flush = driver_uring_flush,
+    .get_fd = driver_uring_get_fd,
+    .caps = driver_uring_caps,
+    .mtu = driver_uring_mtu,
+    .close = driver_uring_close,
+};
+#endif
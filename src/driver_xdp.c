@@ -0,0 +1,537 @@
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/bpf.h>
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include "driver.h"
+#include "ethernet.h"
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+#define DRIVER_XDP_INSN(c, d, s, o, i) ((struct bpf_insn){.code = (c), .dst_reg = (d), .src_reg = (s), .off = (o), .imm = (i)})
+
+typedef struct driver_xdp_ring //与内核共享的一个AF_XDP环
+{
+    uint32_t *producer;
+    uint32_t *consumer;
+    uint32_t *flags;
+    void *desc;             // 填充环与完成环为uint64_t地址，收发环为struct xdp_desc
+    uint32_t mask;
+    void *map;
+    size_t map_len;
+} driver_xdp_ring_t;
+
+typedef struct driver_xdp //AF_XDP网卡，UMEM即当前线程的MTU级缓冲池，收到的帧直接落在缓冲池的块中
+{
+    int fd;
+    int map_fd;             // XSKMAP，把绑定队列的帧转给套接字
+    int prog_fd;            // 挂在网卡上的XDP程序
+    int link_fd;            // XDP程序与网卡的挂接，关闭即卸下
+    int mtu;                // 网卡的MTU
+    uint8_t rx_csum;        // 接收时的校验和状态，见buf_csum_t
+    buf_pool_t *pool;       // 注册为UMEM的缓冲池
+    buf_t *frames;          // 按块号索引，网卡持有的块（在填充环中或预留作发送帧），未持有时block为NULL
+    int fill_held;          // 在填充环或接收环中的块数
+    driver_xdp_ring_t fill, comp, rx, tx;
+    uint32_t *tx_free;      // 空闲发送帧的块号
+    uint32_t tx_free_num;
+    int tx_lock;            // 共用网卡的各实例在发送环上的互斥
+    int tx_pending;         // 已放入发送环、尚未通知内核发送的帧数
+} driver_xdp_t;
+
+/**
+ * @brief 内部函数，bpf系统调用，glibc没有提供封装
+ *
+ * @param cmd 命令
+ * @param attr 参数
+ * @return int 系统调用的返回值
+ */
+static int driver_xdp_bpf(int cmd, union bpf_attr *attr)
+{
+    return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+/**
+ * @brief 内部函数，缓冲池块在UMEM中的块号
+ *
+ * @param xdp 网卡
+ * @param addr 块内的UMEM地址，可带非对齐模式的偏移
+ * @return uint32_t 块号
+ */
+static inline uint32_t driver_xdp_index(driver_xdp_t *xdp, uint64_t addr)
+{
+    return (addr & XSK_UNALIGNED_BUF_ADDR_MASK) / xdp->pool->stride;
+}
+
+/**
+ * @brief 内部函数，UMEM地址，即块的数据区相对缓冲池内存的偏移
+ *
+ * @param xdp 网卡
+ * @param buf 缓冲池中的buf
+ * @return uint64_t 地址
+ */
+static inline uint64_t driver_xdp_addr(driver_xdp_t *xdp, const buf_t *buf)
+{
+    return buf->payload - xdp->pool->arena;
+}
+
+/**
+ * @brief 内部函数，映射一个环
+ *
+ * @param xdp 网卡
+ * @param ring 出口参数，环
+ * @param off 内核给出的各字段偏移
+ * @param pgoff 环的映射偏移，XDP_PGOFF_*或XDP_UMEM_PGOFF_*
+ * @param size 环的大小
+ * @param desc_size 每个描述符的大小
+ * @return int 成功为0，失败为-1
+ */
+static int driver_xdp_map(driver_xdp_t *xdp, driver_xdp_ring_t *ring, const struct xdp_ring_offset *off,
+                          off_t pgoff, uint32_t size, size_t desc_size)
+{
+    ring->map_len = off->desc + size * desc_size;
+    ring->map = mmap(NULL, ring->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, xdp->fd, pgoff);
+    if (ring->map == MAP_FAILED)
+    {
+        fprintf(stderr, "Error in mmap: %s\n", strerror(errno));
+        ring->map = NULL;
+        return -1;
+    }
+    ring->producer = (uint32_t *)((uint8_t *)ring->map + off->producer);
+    ring->consumer = (uint32_t *)((uint8_t *)ring->map + off->consumer);
+    ring->flags = (uint32_t *)((uint8_t *)ring->map + off->flags);
+    ring->desc = (uint8_t *)ring->map + off->desc;
+    ring->mask = size - 1;
+    return 0;
+}
+
+/**
+ * @brief 内部函数，把当前线程的MTU级缓冲池注册为UMEM，建立四个环并映射到用户空间
+ *        块的间距不是2的幂，使用非对齐模式，每块的数据区作为一帧
+ *
+ * @param xdp 网卡
+ * @return int 成功为0，失败为-1
+ */
+static int driver_xdp_umem(driver_xdp_t *xdp)
+{
+    struct xdp_umem_reg reg = {
+        .addr = (uintptr_t)xdp->pool->arena,
+        .len = xdp->pool->stride * xdp->pool->stats.total,
+        .chunk_size = xdp->pool->stats.size,
+        .headroom = 0,
+        .flags = XDP_UMEM_UNALIGNED_CHUNK_FLAG,
+    };
+    uint32_t fill = DRIVER_XDP_FILL_SIZE, tx = DRIVER_XDP_TX_FRAMES;
+    if (setsockopt(xdp->fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) == -1 ||
+        setsockopt(xdp->fd, SOL_XDP, XDP_UMEM_FILL_RING, &fill, sizeof(fill)) == -1 ||
+        setsockopt(xdp->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &tx, sizeof(tx)) == -1 ||
+        setsockopt(xdp->fd, SOL_XDP, XDP_RX_RING, &fill, sizeof(fill)) == -1 ||
+        setsockopt(xdp->fd, SOL_XDP, XDP_TX_RING, &tx, sizeof(tx)) == -1)
+    {
+        fprintf(stderr, "Error in XDP_UMEM_REG/XDP_*_RING: %s\n", strerror(errno));
+        return -1;
+    }
+    struct xdp_mmap_offsets off;
+    socklen_t len = sizeof(off);
+    if (getsockopt(xdp->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &len) == -1)
+    {
+        fprintf(stderr, "Error in XDP_MMAP_OFFSETS: %s\n", strerror(errno));
+        return -1;
+    }
+    if (driver_xdp_map(xdp, &xdp->fill, &off.fr, XDP_UMEM_PGOFF_FILL_RING, fill, sizeof(uint64_t)) == -1 ||
+        driver_xdp_map(xdp, &xdp->comp, &off.cr, XDP_UMEM_PGOFF_COMPLETION_RING, tx, sizeof(uint64_t)) == -1 ||
+        driver_xdp_map(xdp, &xdp->rx, &off.rx, XDP_PGOFF_RX_RING, fill, sizeof(struct xdp_desc)) == -1 ||
+        driver_xdp_map(xdp, &xdp->tx, &off.tx, XDP_PGOFF_TX_RING, tx, sizeof(struct xdp_desc)) == -1)
+        return -1;
+    return 0;
+}
+
+/**
+ * @brief 内部函数，从缓冲池分配块放入填充环，补足到DRIVER_XDP_FILL_SIZE块
+ *        只在注册UMEM的线程中补充，缓冲池耗尽时少放
+ *
+ * @param xdp 网卡
+ */
+static void driver_xdp_refill(driver_xdp_t *xdp)
+{
+    if (buf_pool_current(BUF_POOL_MTU) != xdp->pool)
+        return;
+    uint32_t prod = *xdp->fill.producer, n = 0;
+    uint64_t *addrs = xdp->fill.desc;
+    buf_t buf;
+    while (xdp->fill_held < DRIVER_XDP_FILL_SIZE && buf_alloc_pool(&buf, BUF_POOL_MTU, 0) == 0)
+    {
+        xdp->frames[driver_xdp_index(xdp, driver_xdp_addr(xdp, &buf))] = buf;
+        addrs[(prod + n++) & xdp->fill.mask] = driver_xdp_addr(xdp, &buf);
+        xdp->fill_held++;
+    }
+    if (n == 0)
+        return;
+    __atomic_store_n(xdp->fill.producer, prod + n, __ATOMIC_RELEASE);
+    if (__atomic_load_n(xdp->fill.flags, __ATOMIC_ACQUIRE) & XDP_RING_NEED_WAKEUP)
+        recvfrom(xdp->fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+}
+
+/**
+ * @brief 内部函数，从缓冲池预留发送帧，发送时把数据包聚合到这些块中
+ *
+ * @param xdp 网卡
+ * @return int 成功为0，缓冲池耗尽为-1
+ */
+static int driver_xdp_reserve(driver_xdp_t *xdp)
+{
+    xdp->tx_free = malloc(DRIVER_XDP_TX_FRAMES * sizeof(uint32_t));
+    if (xdp->tx_free == NULL)
+        return -1;
+    for (int i = 0; i < DRIVER_XDP_TX_FRAMES; i++)
+    {
+        buf_t buf;
+        if (buf_alloc_pool(&buf, BUF_POOL_MTU, 0) == -1)
+            return -1;
+        uint32_t index = driver_xdp_index(xdp, driver_xdp_addr(xdp, &buf));
+        xdp->frames[index] = buf;
+        xdp->tx_free[xdp->tx_free_num++] = index;
+    }
+    return 0;
+}
+
+/**
+ * @brief 内部函数，在网卡上挂接XDP程序：发往本机MAC或广播的帧经XSKMAP转给绑定该队列的套接字，
+ *        其余的帧与套接字未绑定的队列照常交给内核，使用通用（SKB）模式，不需要网卡驱动支持
+ *
+ * @param xdp 网卡
+ * @param ifindex 网卡编号
+ * @return int 成功为0，失败为-1
+ */
+static int driver_xdp_attach(driver_xdp_t *xdp, int ifindex)
+{
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(uint32_t);
+    attr.max_entries = DRIVER_XDP_QUEUE + 1;
+    xdp->map_fd = driver_xdp_bpf(BPF_MAP_CREATE, &attr);
+    if (xdp->map_fd == -1)
+    {
+        fprintf(stderr, "Error in BPF_MAP_CREATE: %s\n", strerror(errno));
+        return -1;
+    }
+    uint32_t queue = DRIVER_XDP_QUEUE, fd = xdp->fd;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = xdp->map_fd;
+    attr.key = (uintptr_t)&queue;
+    attr.value = (uintptr_t)&fd;
+    if (driver_xdp_bpf(BPF_MAP_UPDATE_ELEM, &attr) == -1)
+    {
+        fprintf(stderr, "Error in BPF_MAP_UPDATE_ELEM: %s\n", strerror(errno));
+        return -1;
+    }
+
+    uint32_t mac_hi, mac_lo = 0, bcast_lo = 0xFFFF;
+    memcpy(&mac_hi, net_stack->if_mac, 4); // 与程序中的加载一样按主机字节序
+    memcpy(&mac_lo, net_stack->if_mac + 4, 2);
+    struct bpf_insn code[] = {
+        DRIVER_XDP_INSN(BPF_LDX | BPF_MEM | BPF_W, 2, 1, offsetof(struct xdp_md, data), 0),
+        DRIVER_XDP_INSN(BPF_LDX | BPF_MEM | BPF_W, 3, 1, offsetof(struct xdp_md, data_end), 0),
+        DRIVER_XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_X, 4, 2, 0, 0),
+        DRIVER_XDP_INSN(BPF_ALU64 | BPF_ADD | BPF_K, 4, 0, 0, NET_MAC_LEN),
+        DRIVER_XDP_INSN(BPF_JMP | BPF_JGT | BPF_X, 4, 3, 12, 0),            // 不足一个MAC，交给内核
+        DRIVER_XDP_INSN(BPF_LDX | BPF_MEM | BPF_W, 4, 2, 0, 0),             // 目的MAC的前4字节
+        DRIVER_XDP_INSN(BPF_LDX | BPF_MEM | BPF_H, 5, 2, 4, 0),
+        DRIVER_XDP_INSN(BPF_JMP32 | BPF_JNE | BPF_K, 4, 0, 1, mac_hi),
+        DRIVER_XDP_INSN(BPF_JMP32 | BPF_JEQ | BPF_K, 5, 0, 2, mac_lo),      // 发往本机
+        DRIVER_XDP_INSN(BPF_JMP32 | BPF_JNE | BPF_K, 4, 0, 7, 0xFFFFFFFF),
+        DRIVER_XDP_INSN(BPF_JMP32 | BPF_JNE | BPF_K, 5, 0, 6, bcast_lo),    // 广播
+        DRIVER_XDP_INSN(BPF_LDX | BPF_MEM | BPF_W, 2, 1, offsetof(struct xdp_md, rx_queue_index), 0),
+        DRIVER_XDP_INSN(BPF_LD | BPF_DW | BPF_IMM, 1, BPF_PSEUDO_MAP_FD, 0, xdp->map_fd),
+        DRIVER_XDP_INSN(0, 0, 0, 0, 0),
+        DRIVER_XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_K, 3, 0, 0, XDP_PASS),    // 队列未绑定套接字时交给内核
+        DRIVER_XDP_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+        DRIVER_XDP_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+        DRIVER_XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0, XDP_PASS),
+        DRIVER_XDP_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+    };
+    char log[4096] = {0};
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insn_cnt = sizeof(code) / sizeof(code[0]);
+    attr.insns = (uintptr_t)code;
+    attr.license = (uintptr_t) "GPL";
+    attr.log_level = 1;
+    attr.log_buf = (uintptr_t)log;
+    attr.log_size = sizeof(log);
+    xdp->prog_fd = driver_xdp_bpf(BPF_PROG_LOAD, &attr);
+    if (xdp->prog_fd == -1)
+    {
+        fprintf(stderr, "Error in BPF_PROG_LOAD: %s\n%s", strerror(errno), log);
+        return -1;
+    }
+    memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd = xdp->prog_fd;
+    attr.link_create.target_ifindex = ifindex;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = XDP_FLAGS_SKB_MODE;
+    xdp->link_fd = driver_xdp_bpf(BPF_LINK_CREATE, &attr);
+    if (xdp->link_fd == -1)
+    {
+        fprintf(stderr, "Error in BPF_LINK_CREATE: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 内部函数，释放网卡的全部资源，网卡持有的块归还缓冲池
+ *
+ * @param xdp 网卡
+ */
+static void driver_xdp_free(driver_xdp_t *xdp)
+{
+    int *fds[] = {&xdp->link_fd, &xdp->prog_fd, &xdp->map_fd, &xdp->fd}; // 先卸下程序，再关闭套接字
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++)
+        if (*fds[i] >= 0)
+            close(*fds[i]);
+    driver_xdp_ring_t *rings[] = {&xdp->fill, &xdp->comp, &xdp->rx, &xdp->tx};
+    for (size_t i = 0; i < sizeof(rings) / sizeof(rings[0]); i++)
+        if (rings[i]->map)
+            munmap(rings[i]->map, rings[i]->map_len);
+    if (xdp->frames)
+        for (size_t i = 0; i < xdp->pool->stats.total; i++)
+            buf_free(&xdp->frames[i]);
+    free(xdp->frames);
+    free(xdp->tx_free);
+    free(xdp);
+}
+
+/**
+ * @brief 用AF_XDP打开与本机ip同网段的网卡，收到的帧由内核直接写入缓冲池的块中，
+ *        需在此后分配buf的线程中打开，收到的buf须归还到该线程
+ *
+ * @return int 成功为0，失败为-1
+ */
+static int driver_xdp_open()
+{
+    char if_name[IF_NAMESIZE] = {0};
+    if (driver_find_if(net_stack->if_ip, if_name) == -1)
+    {
+        fprintf(stderr, "Error in driver find.\n");
+        return -1;
+    }
+    printf("Using interface %s, my ip is %s.\n", if_name, iptos(net_stack->if_ip));
+    driver_xdp_t *xdp = calloc(1, sizeof(driver_xdp_t));
+    if (xdp == NULL)
+    {
+        fprintf(stderr, "Error in driver_xdp_open, out of memory.\n");
+        return -1;
+    }
+    xdp->map_fd = xdp->prog_fd = xdp->link_fd = -1;
+    xdp->pool = buf_pool_current(BUF_POOL_MTU);
+    xdp->frames = calloc(xdp->pool->stats.total, sizeof(buf_t));
+    xdp->fd = socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (xdp->frames == NULL || xdp->fd == -1)
+    {
+        fprintf(stderr, "Error in socket(AF_XDP): %s\n", strerror(errno));
+        driver_xdp_free(xdp);
+        return -1;
+    }
+    struct ifreq ifr = {0};
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0); // AF_XDP套接字不支持网卡的ioctl
+    strncpy(ifr.ifr_name, if_name, IF_NAMESIZE - 1);
+    xdp->mtu = sock >= 0 && ioctl(sock, SIOCGIFMTU, &ifr) == 0 ? ifr.ifr_mtu : ETHERNET_MAX_TRANSPORT_UNIT;
+    struct ethtool_drvinfo info = {.cmd = ETHTOOL_GDRVINFO};
+    ifr.ifr_data = (void *)&info;
+    // veth上的帧都由本机内核发出，校验和可能只填了伪头部的累加和，通用模式拿不到该标记，只能都不校验
+    xdp->rx_csum = sock >= 0 && ioctl(sock, SIOCETHTOOL, &ifr) == 0 && strcmp(info.driver, "veth") == 0 ? BUF_CSUM_UNNECESSARY : BUF_CSUM_NONE;
+    if (sock >= 0)
+        close(sock);
+    struct sockaddr_xdp addr = {
+        .sxdp_family = AF_XDP,
+        .sxdp_flags = XDP_COPY | XDP_USE_NEED_WAKEUP, // 通用模式只能拷贝，但拷贝的目的地就是缓冲池
+        .sxdp_ifindex = if_nametoindex(if_name),
+        .sxdp_queue_id = DRIVER_XDP_QUEUE,
+    };
+    if (addr.sxdp_ifindex == 0 || driver_xdp_umem(xdp) == -1 || driver_xdp_reserve(xdp) == -1 ||
+        bind(xdp->fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || driver_xdp_attach(xdp, addr.sxdp_ifindex) == -1)
+    {
+        fprintf(stderr, "Error in driver_xdp_open: %s: %s\n", if_name, strerror(errno));
+        driver_xdp_free(xdp);
+        return -1;
+    }
+    driver_xdp_refill(xdp);
+    net_stack->driver = xdp;
+    return 0;
+}
+
+/**
+ * @brief 从接收环中接收数据包，不拷贝，buf就是内核写入的缓冲池块，由调用者释放，之后补充填充环
+ *
+ * @param bufs 出口参数，收到的数据包
+ * @param n 最多接收的数据包数
+ * @return int 收到的数据包数
+ */
+static int driver_xdp_recv_burst(buf_t *bufs, int n)
+{
+    driver_xdp_t *xdp = net_stack->driver;
+    uint32_t cons = *xdp->rx.consumer;
+    uint32_t avail = __atomic_load_n(xdp->rx.producer, __ATOMIC_ACQUIRE) - cons;
+    struct xdp_desc *descs = xdp->rx.desc;
+    int i = 0;
+    for (; i < n && (uint32_t)i < avail; i++)
+    {
+        struct xdp_desc *desc = &descs[(cons + i) & xdp->rx.mask];
+        buf_t *frame = &xdp->frames[driver_xdp_index(xdp, desc->addr)];
+        bufs[i] = *frame;
+        bufs[i].data = xdp->pool->arena + (desc->addr & XSK_UNALIGNED_BUF_ADDR_MASK) + (desc->addr >> XSK_UNALIGNED_BUF_OFFSET_SHIFT);
+        bufs[i].len = desc->len;
+        bufs[i].csum = xdp->rx_csum;
+        frame->block = NULL;
+    }
+    __atomic_store_n(xdp->rx.consumer, cons + i, __ATOMIC_RELEASE);
+    xdp->fill_held -= i;
+    driver_xdp_refill(xdp);
+    return i;
+}
+
+/**
+ * @brief 内部函数，回收内核已发送完的帧，需持有发送锁
+ *
+ * @param xdp 网卡
+ */
+static void driver_xdp_complete(driver_xdp_t *xdp)
+{
+    uint32_t cons = *xdp->comp.consumer;
+    uint32_t prod = __atomic_load_n(xdp->comp.producer, __ATOMIC_ACQUIRE);
+    uint64_t *addrs = xdp->comp.desc;
+    for (; cons != prod; cons++)
+        xdp->tx_free[xdp->tx_free_num++] = driver_xdp_index(xdp, addrs[cons & xdp->comp.mask]);
+    __atomic_store_n(xdp->comp.consumer, cons, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief 通知内核发送发送环中的帧，通用模式下发送在此同步完成
+ *
+ */
+static void driver_xdp_flush()
+{
+    driver_xdp_t *xdp = net_stack->driver;
+    if (__atomic_exchange_n(&xdp->tx_pending, 0, __ATOMIC_ACQ_REL) == 0)
+        return;
+    if (sendto(xdp->fd, NULL, 0, MSG_DONTWAIT, NULL, 0) == -1 && errno != EAGAIN && errno != EBUSY && errno != ENOBUFS)
+        fprintf(stderr, "Error in driver_xdp_flush: %s\n", strerror(errno));
+}
+
+/**
+ * @brief 把一组数据包聚合到预留的发送帧中并放入发送环，同时填写校验和
+ *        帧在driver_flush时一次通知内核发送，发送帧用尽时先通知内核，仍不够则放弃其余的包
+ *
+ * @param bufs 要发送的数据包
+ * @param n 数据包数
+ * @return int 放入发送环的数据包数
+ */
+static int driver_xdp_send_burst(buf_t **bufs, int n)
+{
+    driver_xdp_t *xdp = net_stack->driver;
+    struct xdp_desc *descs = xdp->tx.desc;
+    int i = 0, posted = 0, flushed = 0;
+    while (__atomic_test_and_set(&xdp->tx_lock, __ATOMIC_ACQUIRE))
+        cpu_relax();
+    driver_xdp_complete(xdp);
+    uint32_t prod = *xdp->tx.producer;
+    while (i < n)
+    {
+        size_t len = buf_chain_len(bufs[i]);
+        if (len > xdp->pool->stats.size)
+        {
+            fprintf(stderr, "Error in driver_xdp_send_burst, packet too long: %zu.\n", len);
+            break;
+        }
+        if (xdp->tx_free_num == 0)
+        {
+            if (flushed)
+                break;
+            __atomic_store_n(xdp->tx.producer, prod, __ATOMIC_RELEASE);
+            __atomic_add_fetch(&xdp->tx_pending, i - posted, __ATOMIC_RELEASE);
+            posted = i;
+            driver_xdp_flush();
+            driver_xdp_complete(xdp);
+            flushed = 1;
+            continue;
+        }
+        buf_t *frame = &xdp->frames[xdp->tx_free[--xdp->tx_free_num]];
+        buf_gather_complete(bufs[i], frame->payload);
+        descs[prod & xdp->tx.mask] = (struct xdp_desc){.addr = driver_xdp_addr(xdp, frame), .len = len};
+        prod++;
+        i++;
+    }
+    __atomic_store_n(xdp->tx.producer, prod, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&xdp->tx_pending, i - posted, __ATOMIC_RELEASE);
+    __atomic_clear(&xdp->tx_lock, __ATOMIC_RELEASE);
+    return i;
+}
+
+/**
+ * @brief 接收环非空时套接字可读
+ *
+ * @return int 文件描述符
+ */
+static int driver_xdp_get_fd()
+{
+    driver_xdp_t *xdp = net_stack->driver;
+    return xdp->fd;
+}
+
+/**
+ * @brief 发送时的校验和在聚合到发送帧时填写，通用模式下没有接收校验信息，只有veth上的帧不再校验
+ *
+ * @return int NET_CAP_*的组合
+ */
+static int driver_xdp_caps()
+{
+    return NET_CAP_TX_CSUM;
+}
+
+/**
+ * @brief 网卡的MTU，不超过一块在内核预留XDP头部空间后的容量
+ *
+ * @return int 长度
+ */
+static int driver_xdp_mtu()
+{
+    driver_xdp_t *xdp = net_stack->driver;
+    return min32(xdp->mtu, xdp->pool->stats.size - XDP_PACKET_HEADROOM - sizeof(ether_hdr_t));
+}
+
+/**
+ * @brief 关闭网卡，卸下XDP程序，尚未发送的帧被丢弃
+ *
+ */
+static void driver_xdp_close()
+{
+    driver_xdp_free(net_stack->driver);
+}
+
+const driver_ops_t driver_xdp = {
+    .name = "xdp",
+    .open = driver_xdp_open,
+    .recv_burst = driver_xdp_recv_burst,
+    .send_burst = driver_xdp_send_burst,
+    .flush = driver_xdp_flush,
+    .get_fd = driver_xdp_get_fd,
+    .caps = driver_xdp_caps,
+    .mtu = driver_xdp_mtu,
+    .close = driver_xdp_close,
+};
+#endif
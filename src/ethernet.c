@@ -11,47 +11,97 @@
  * @return int 相同（或为广播地址）为1，否则为0
 */
 int is_mac_equal(uint8_t *dst){
-    if (!memcmp(dst, net_if_mac, NET_MAC_LEN) || !memcmp(dst, ether_broadcast_mac, NET_MAC_LEN))
+    if (!memcmp(dst, net_stack->if_mac, NET_MAC_LEN) || !memcmp(dst, ether_broadcast_mac, NET_MAC_LEN))
         return 1;
     return 0;
 }
 
 /**
- * @brief 处理一个收到的数据包
+ * @brief 内部函数，把一组同一类型的数据包交给上层
  * 
- * @param buf 要处理的数据包
+ * @param bufs 数据包
+ * @param srcs 各数据包的源mac地址
+ * @param n 数据包数
+ * @param protocol 以太网类型
  */
-void ethernet_in(buf_t *buf)
+static void ethernet_deliver(buf_t **bufs, uint8_t **srcs, int n, uint16_t protocol)
 {
-    if (buf->len < sizeof(ether_hdr_t))
-        return ;
-    
-    ether_hdr_t *hdr = (ether_hdr_t*)buf->data;
-    buf_remove_header(buf, sizeof(ether_hdr_t));
+    if (net_in_burst(bufs, srcs, n, protocol) == -1)
+        fprintf(stderr, "ethernet_in failed");
+}
+
+/**
+ * @brief 处理一组收到的数据包
+ *        先逐个检查并去除以太网头部，连续的同类型数据包合为一组交给上层，保持包间顺序
+ * 
+ * @param bufs 要处理的数据包
+ * @param n 数据包数
+ */
+void ethernet_in_burst(buf_t **bufs, int n)
+{
+    buf_t *run[NET_BURST];
+    uint8_t *srcs[NET_BURST];
+    uint16_t protocol = 0;
+    int m = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (i + 1 < n)
+            __builtin_prefetch(bufs[i + 1]->data);
+        buf_t *buf = bufs[i];
+        if (buf->len < sizeof(ether_hdr_t))
+            continue;
+
+        ether_hdr_t *hdr = (ether_hdr_t*)buf->data;
+        buf_remove_header(buf, sizeof(ether_hdr_t));
+        if (!is_mac_equal(hdr->dst))
+            continue;
 
-    if (is_mac_equal(hdr->dst)){
-        if (net_in(buf, swap16(hdr->protocol16), hdr->src) == -1)
-            fprintf(stderr, "ethernet_in failed");
+        uint16_t type = swap16(hdr->protocol16);
+        if (m && (type != protocol || m == NET_BURST))
+        {
+            ethernet_deliver(run, srcs, m, protocol);
+            m = 0;
+        }
+        protocol = type;
+        run[m] = buf;
+        srcs[m++] = hdr->src;
     }
+    if (m)
+        ethernet_deliver(run, srcs, m, protocol);
+}
 
+/**
+ * @brief 处理一个收到的数据包
+ * 
+ * @param buf 要处理的数据包
+ */
+void ethernet_in(buf_t *buf)
+{
+    ethernet_in_burst(&buf, 1);
 }
 /**
  * @brief 处理一个要发送的数据包
  * 
- * @param buf 要处理的数据包
+ * @param buf 要处理的数据包，可以是链式buf，以太网头部加在第一段上
  * @param mac 目标MAC地址
  * @param protocol 上层协议
  */
 void ethernet_out(buf_t *buf, const uint8_t *mac, net_protocol_t protocol)
 {
-    if (buf->len < ETHERNET_MIN_TRANSPORT_UNIT)
-        buf_add_padding(buf, ETHERNET_MIN_TRANSPORT_UNIT - buf->len);
+    size_t len = buf_chain_len(buf);
+    if (len < ETHERNET_MIN_TRANSPORT_UNIT)
+    {
+        // 短包合并为一段后再填充，避免在引用的数据段尾部写入
+        if (buf_linearize(buf) == -1)
+            return;
+        buf_add_padding(buf, ETHERNET_MIN_TRANSPORT_UNIT - len);
+    }
 
     buf_add_header(buf, sizeof(ether_hdr_t));
     ether_hdr_t *hdr = (ether_hdr_t*)buf->data;
 
     memcpy(hdr->dst, mac, NET_MAC_LEN);
-    memcpy(hdr->src, net_if_mac, NET_MAC_LEN);
+    memcpy(hdr->src, net_stack->if_mac, NET_MAC_LEN);
     hdr->protocol16 = swap16(protocol);
 
     if (driver_send(buf) == -1)
@@ -63,15 +113,25 @@ void ethernet_out(buf_t *buf, const uint8_t *mac, net_protocol_t protocol)
  */
 void ethernet_init()
 {
-    buf_init(&rxbuf, ETHERNET_MAX_TRANSPORT_UNIT + sizeof(ether_hdr_t));
+    buf_init(&net_stack->rxbuf, ETHERNET_MAX_TRANSPORT_UNIT + sizeof(ether_hdr_t));
 }
 
 /**
- * @brief 一次以太网轮询
+ * @brief 一次以太网轮询，一次接收最多NET_BURST帧并批量处理
  * 
+ * @return int 处理的帧数
  */
-void ethernet_poll()
+int ethernet_poll()
 {
-    if (driver_recv(&rxbuf) > 0)
-        ethernet_in(&rxbuf);
+    buf_t bufs[NET_BURST];
+    buf_t *vec[NET_BURST];
+    int n = driver_recv_burst(bufs, NET_BURST);
+    if (n <= 0)
+        return 0;
+    for (int i = 0; i < n; i++)
+        vec[i] = &bufs[i];
+    ethernet_in_burst(vec, n);
+    for (int i = 0; i < n; i++)
+        buf_free(&bufs[i]);
+    return n;
 }
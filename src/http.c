@@ -10,8 +10,6 @@ typedef struct http_fifo {
     uint8_t front, tail, count;
 } http_fifo_t;
 
-static http_fifo_t http_fifo_v;
-
 static void http_fifo_init(http_fifo_t* fifo) {
     fifo->count = 0;
     fifo->front = 0;
@@ -44,6 +42,23 @@ static tcp_connect_t* http_fifo_out(http_fifo_t* fifo) {
     return tcp;
 }
 
+// 从FIFO中移除已关闭的连接，其余连接保持原来的顺序。
+
+static void http_fifo_remove(http_fifo_t* fifo, tcp_connect_t* tcp) {
+    uint8_t count = fifo->count;
+    fifo->front = fifo->tail;
+    fifo->count = 0;
+    for (uint8_t i = 0, pos = fifo->tail; i < count; i++) {
+        tcp_connect_t* item = fifo->buffer[pos];
+        if (++pos >= TCP_FIFO_SIZE) {
+            pos = 0;
+        }
+        if (item != tcp) {
+            http_fifo_in(fifo, item);
+        }
+    }
+}
+
 static size_t get_line(tcp_connect_t* tcp, char* buf, size_t size) {
     size_t i = 0;
     while (i < size) {
@@ -100,10 +115,11 @@ static void send_file(tcp_connect_t* tcp, const char* url) {
 
 static void http_handler(tcp_connect_t* tcp, connect_state_t state) {
     if (state == TCP_CONN_CONNECTED) {
-        http_fifo_in(&http_fifo_v, tcp);
+        http_fifo_in(net_stack->http_fifo, tcp);
         printf("http conntected.\n");
     } else if (state == TCP_CONN_DATA_RECV) {
     } else if (state == TCP_CONN_CLOSED) {
+        http_fifo_remove(net_stack->http_fifo, tcp);
         printf("http closed.\n");
     } else {
         assert(0);
@@ -114,13 +130,22 @@ static void http_handler(tcp_connect_t* tcp, connect_state_t state) {
 // 在端口上创建服务器。
 
 int http_server_open(uint16_t port) {
-    if (!tcp_open(port, http_handler)) {
+    if (net_stack->http_fifo == NULL && (net_stack->http_fifo = malloc(sizeof(http_fifo_t))) == NULL) {
+        return -1;
+    }
+    http_fifo_init(net_stack->http_fifo);
+    if (tcp_open(port, http_handler) != 0) {
         return -1;
     }
-    http_fifo_init(&http_fifo_v);
     return 0;
 }
 
+// FIFO中是否有等待处理的连接，有时事件循环不应无限期休眠。
+
+int http_server_pending(void) {
+    return net_stack->http_fifo != NULL && net_stack->http_fifo->count != 0;
+}
+
 // 从FIFO取出请求并处理。新的HTTP请求时会发送到FIFO中等待处理。
 
 void http_server_run(void) {
@@ -128,7 +153,10 @@ void http_server_run(void) {
     char url_path[255];
     char rx_buffer[1024];
 
-    while ((tcp = http_fifo_out(&http_fifo_v)) != NULL) {
+    if (net_stack->http_fifo == NULL) {
+        return;
+    }
+    while ((tcp = http_fifo_out(net_stack->http_fifo)) != NULL) {
         int i;
         char* c = rx_buffer;
 
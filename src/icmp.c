@@ -34,7 +34,7 @@ static void icmp_resp(buf_t *req_buf, uint8_t *src_ip)
  */
 void icmp_req(uint16_t id, uint16_t seq, clock_t tag, uint8_t *dst_ip)
 {
-    buf_t *buf = &txbuf;
+    buf_t *buf = &net_stack->txbuf;
     buf_init(buf, sizeof(icmp_hdr_t));
     icmp_hdr_t *hdr = (icmp_hdr_t *)buf->data;
     hdr->type = ICMP_TYPE_ECHO_REQUEST;
@@ -81,7 +81,7 @@ void icmp_in(buf_t *buf, uint8_t *src_ip)
  */
 void icmp_unreachable(buf_t *recv_buf, uint8_t *src_ip, icmp_code_t code)
 {  
-    buf_t *buf = &txbuf;
+    buf_t *buf = &net_stack->txbuf;
     buf_init(buf, sizeof(icmp_hdr_t) + sizeof(ip_hdr_t) + 8);
 
     icmp_hdr_t *icmp_hdr = (icmp_hdr_t *)buf->data;
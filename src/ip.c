@@ -5,57 +5,98 @@
 #include "icmp.h"
 #include <string.h>
 
-uint16_t ip_id = 0;
-
 /**
- * @brief 处理一个收到的数据包
+ * @brief 内部函数，把一组同一协议的数据包交给上层，不能识别的协议返回ICMP协议不可达信息
  *
- * @param buf 要处理的数据包
- * @param src_mac 源mac地址
+ * @param bufs 数据包，已去掉IP报头
+ * @param srcs 各数据包的源ip地址
+ * @param n 数据包数
+ * @param protocol 上层协议
  */
-void ip_in(buf_t *buf, uint8_t *src_mac)
+static void ip_deliver(buf_t **bufs, uint8_t **srcs, int n, uint8_t protocol)
 {
-    if (buf->len < sizeof(ip_hdr_t))
-    {
-        // 数据包长度小于IP头部长度，丢弃不处理
-        return;
-    }
-    ip_hdr_t *hdr = (ip_hdr_t *)buf->data;
-    if (hdr->version != IP_VERSION_4 || swap16(hdr->total_len16) > buf->len)
-    {
-        // IP头部的版本号不是IPv4或总长度字段大于接收到的包的长度，丢弃不处理
+    if (net_ip_in_burst(bufs, srcs, n, protocol) == 0)
         return;
-    }
-    if (memcmp(net_if_ip, hdr->dst_ip, NET_IP_LEN))
+    for (int i = 0; i < n; i++)
     {
-        // 目的IP地址不是本机的IP地址，丢弃不处理
-        return;
-    }
-    // 头部校验和不匹配，丢弃不处理
-    ip_hdr_t *chk = (ip_hdr_t *)malloc(sizeof(ip_hdr_t));
-    memcpy(chk, buf->data, sizeof(ip_hdr_t));
-    chk->hdr_checksum16 = 0;
-    uint16_t rlt = checksum16((uint16_t *)chk, sizeof(ip_hdr_t));
-    if (rlt != hdr->hdr_checksum16)
-    {
-        return;
+        buf_add_header(bufs[i], sizeof(ip_hdr_t));
+        icmp_unreachable(bufs[i], srcs[i], ICMP_CODE_PROTOCOL_UNREACH);
     }
-    free(chk);
+}
 
-    // 如果接收到的数据包的长度大于IP头部的总长度字段，则去除填充字段
-    buf_remove_padding(buf, buf->len - swap16(hdr->total_len16));
-    // 去掉IP报头
-    ip_hdr_t *tmp = (ip_hdr_t *)malloc(sizeof(ip_hdr_t));
-    memcpy(tmp, hdr, sizeof(ip_hdr_t));
-    buf_remove_header(buf, sizeof(ip_hdr_t));
-    // 调用net_in()函数向上层传递数据包
-    if (net_in(buf, hdr->protocol, hdr->src_ip) == -1)
+/**
+ * @brief 处理一组收到的数据包
+ *        先逐个检查并去除IP报头，连续的同协议数据包合为一组交给上层，保持包间顺序
+ *
+ * @param bufs 要处理的数据包
+ * @param src_macs 各数据包的源mac地址
+ * @param n 数据包数
+ */
+void ip_in_burst(buf_t **bufs, uint8_t **src_macs, int n)
+{
+    buf_t *run[NET_BURST];
+    uint8_t *srcs[NET_BURST];
+    uint8_t protocol = 0;
+    int m = 0;
+    for (int i = 0; i < n; i++)
     {
-        // 不能识别的协议类型，返回ICMP协议不可达信息
-        buf_add_header(buf, sizeof(ip_hdr_t));
-        icmp_unreachable(buf, hdr->src_ip, ICMP_CODE_PROTOCOL_UNREACH);
+        buf_t *buf = bufs[i];
+        if (buf->len < sizeof(ip_hdr_t))
+        {
+            // 数据包长度小于IP头部长度，丢弃不处理
+            continue;
+        }
+        ip_hdr_t *hdr = (ip_hdr_t *)buf->data;
+        if (hdr->version != IP_VERSION_4 || swap16(hdr->total_len16) > buf->len)
+        {
+            // IP头部的版本号不是IPv4或总长度字段大于接收到的包的长度，丢弃不处理
+            continue;
+        }
+        if (memcmp(net_stack->if_ip, hdr->dst_ip, NET_IP_LEN))
+        {
+            // 目的IP地址不是本机的IP地址，丢弃不处理
+            continue;
+        }
+        // 头部校验和不匹配，丢弃不处理，驱动已校验过的不再校验
+        if (buf->csum != BUF_CSUM_UNNECESSARY)
+        {
+            ip_hdr_t chk;
+            memcpy(&chk, buf->data, sizeof(ip_hdr_t));
+            chk.hdr_checksum16 = 0;
+            uint16_t rlt = checksum16((uint16_t *)&chk, sizeof(ip_hdr_t));
+            if (rlt != hdr->hdr_checksum16)
+            {
+                continue;
+            }
+        }
+
+        // 如果接收到的数据包的长度大于IP头部的总长度字段，则去除填充字段
+        buf_remove_padding(buf, buf->len - swap16(hdr->total_len16));
+        // 去掉IP报头
+        buf_remove_header(buf, sizeof(ip_hdr_t));
+        // 协议与前面的数据包不同时，先把前面的一组交给上层
+        if (m && (hdr->protocol != protocol || m == NET_BURST))
+        {
+            ip_deliver(run, srcs, m, protocol);
+            m = 0;
+        }
+        protocol = hdr->protocol;
+        run[m] = buf;
+        srcs[m++] = hdr->src_ip;
     }
-    free(tmp);
+    if (m)
+        ip_deliver(run, srcs, m, protocol);
+}
+
+/**
+ * @brief 处理一个收到的数据包
+ *
+ * @param buf 要处理的数据包
+ * @param src_mac 源mac地址
+ */
+void ip_in(buf_t *buf, uint8_t *src_mac)
+{
+    ip_in_burst(&buf, &src_mac, 1);
 }
 
 /**
@@ -78,14 +119,14 @@ void ip_fragment_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol, int id, u
     ip_header->hdr_len = sizeof(ip_hdr_t) / IP_HDR_LEN_PER_BYTE; // IP头部长度，单位为4字节
     ip_header->version = IP_VERSION_4;                           // IP版本号
     ip_header->tos = 0;                                          // 服务类型，可根据需求设置
-    ip_header->total_len16 = swap16(buf->len);                   // 总长度，包括IP头部和数据部分的长度
+    ip_header->total_len16 = swap16(buf_chain_len(buf));         // 总长度，包括IP头部和数据部分的长度
     ip_header->id16 = swap16(id);                                // 数据包标识符
     uint16_t flags_fragment = (mf << 13) | offset;
     ip_header->flags_fragment16 = swap16(flags_fragment); // 分段偏移
     ip_header->ttl = IP_DEFALUT_TTL;                      // 存活时间，可根据需求设置
     ip_header->protocol = protocol;                       // 上层协议类型
     ip_header->hdr_checksum16 = 0;                        // 首部校验和先置0
-    memcpy(ip_header->src_ip, net_if_ip, NET_IP_LEN);     // 源IP地址
+    memcpy(ip_header->src_ip, net_stack->if_ip, NET_IP_LEN);     // 源IP地址
     memcpy(ip_header->dst_ip, ip, NET_IP_LEN);            // 目标IP地址
 
     // 计算首部校验和
@@ -97,34 +138,66 @@ void ip_fragment_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol, int id, u
 
 /**
  * @brief 处理一个要发送的ip数据包
+ *        不需要分片时直接在数据包的头部空间写入ip头部，线性的数据包仍是一段线性buf
+ *        需要分片时每个分片由新分配的头部buf与引用原数据包的buf段组成，数据不做拷贝
+ *        不分片时待填写的校验和随数据包交给驱动，需要分片时驱动无法填写，在此用软件填写
  *
- * @param buf 要处理的包
+ * @param buf 要处理的包，可以是链式buf
  * @param ip 目标ip地址
  * @param protocol 上层协议
  */
 void ip_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol)
 {
     uint16_t offset = 0;
-    size_t len = buf->len;
-    buf_t *tbuf = (buf_t *)malloc(sizeof(buf_t));
+    size_t len = buf_chain_len(buf);
+    buf_t tbuf; // 每个分片单独分配头部，分片可能被arp_buf缓存
+    buf_t segs[BUF_CHAIN_MAX];
+    size_t mtu = net_stack->if_mtu;
 
-    while (len - offset * IP_HDR_OFFSET_PER_BYTE > ETHERNET_MAX_TRANSPORT_UNIT)
+    if (len <= mtu && (size_t)(buf->data - buf->payload) >= sizeof(ip_hdr_t))
+    {
+        // ip可能指向收到的数据包的ip头部，即将被覆盖的位置，先拷贝出来
+        uint8_t dst_ip[NET_IP_LEN];
+        memcpy(dst_ip, ip, NET_IP_LEN);
+        ip_fragment_out(buf, dst_ip, protocol, net_stack->ip_id++, 0, 0);
+        return;
+    }
+    if (len > mtu && buf_checksum_complete(buf) == -1)
+        return;
+    while (len - offset * IP_HDR_OFFSET_PER_BYTE > mtu)
     {
-        // 超过IP协议最大负载包长，需要分片发送
-        size_t l = ETHERNET_MAX_TRANSPORT_UNIT - sizeof(ip_hdr_t);
-        buf_init(tbuf, l);
-        memcpy(tbuf->data, buf->data + offset * IP_HDR_OFFSET_PER_BYTE, l);
+        // 超过IP协议最大负载包长，需要分片发送，分片长度为8字节的整数倍
+        size_t l = (mtu - sizeof(ip_hdr_t)) & ~(size_t)(IP_HDR_OFFSET_PER_BYTE - 1);
+        if (buf_alloc(&tbuf, 0) == -1)
+            return;
+        if (buf_slice(buf, offset * IP_HDR_OFFSET_PER_BYTE, l, segs, BUF_CHAIN_MAX) == -1)
+        {
+            buf_free(&tbuf);
+            return;
+        }
+        tbuf.next = segs;
         // 发送分片
-        ip_fragment_out(tbuf, ip, protocol, ip_id, offset, 1);
-        offset += (ETHERNET_MAX_TRANSPORT_UNIT - sizeof(ip_hdr_t)) / IP_HDR_OFFSET_PER_BYTE;
+        ip_fragment_out(&tbuf, ip, protocol, net_stack->ip_id, offset, 1);
+        buf_free(&tbuf);
+        offset += l / IP_HDR_OFFSET_PER_BYTE;
     }
 
     size_t l = len - offset * IP_HDR_OFFSET_PER_BYTE;
-    buf_init(tbuf, l);
-    memcpy(tbuf->data, buf->data + offset * IP_HDR_OFFSET_PER_BYTE, l);
-    ip_fragment_out(tbuf, ip, protocol, ip_id++, offset, 0);
-
-    free(tbuf);
+    if (buf_alloc(&tbuf, 0) == -1)
+        return;
+    int n = buf_slice(buf, offset * IP_HDR_OFFSET_PER_BYTE, l, segs, BUF_CHAIN_MAX);
+    if (n == -1)
+    {
+        buf_free(&tbuf);
+        return;
+    }
+    tbuf.next = n ? segs : NULL;
+    // 头部段长度为0，csum_start相对tbuf同样有效
+    tbuf.csum = buf->csum;
+    tbuf.csum_start = buf->csum_start;
+    tbuf.csum_offset = buf->csum_offset;
+    ip_fragment_out(&tbuf, ip, protocol, net_stack->ip_id++, offset, 0);
+    buf_free(&tbuf);
 }
 
 /**
@@ -134,4 +207,5 @@ void ip_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol)
 void ip_init()
 {
     net_add_protocol(NET_PROTOCOL_IP, ip_in);
+    net_add_protocol_burst(NET_PROTOCOL_IP, ip_in_burst);
 }
\ No newline at end of file
@@ -0,0 +1,334 @@
+#ifdef __linux__
+#define _GNU_SOURCE // sched_setaffinity
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <unistd.h>
+#endif
+#include <time.h>
+#include <errno.h>
+#include "loop.h"
+#include "driver.h"
+
+typedef struct loop_fd //事件循环监听的应用文件描述符
+{
+    int fd;                 // 文件描述符，-1表示空闲
+    loop_handler_t handler; // 可读时调用的函数
+    void *arg;              // 传给handler的参数
+} loop_fd_t;
+
+static _Thread_local loop_fd_t loop_fds[LOOP_FD_MAX];
+static _Thread_local int loop_fd_num;          // 正在监听的应用文件描述符个数
+static _Thread_local int loop_epfd = -1;       // epoll实例
+static _Thread_local int loop_driver_fd = -1;  // 驱动的文件描述符，-1表示驱动不支持，只能轮询
+static _Thread_local uint64_t loop_latency_ns; // 忙轮询的延迟目标，0表示不忙轮询
+static _Thread_local uint64_t loop_idle_ns;    // 忙轮询时本次空闲开始的时间，0表示不在空闲
+static _Thread_local loop_stats_t loop_stat;   // 忙闲统计，elapsed_ns存放统计开始的时间
+
+/**
+ * @brief 初始化事件循环，需在net_init之后调用
+ *        驱动提供文件描述符时在其上等待数据包，否则每LOOP_POLL_MS毫秒轮询一次
+ *
+ * @return int 成功为0，失败为-1
+ */
+int loop_init()
+{
+    for (int i = 0; i < LOOP_FD_MAX; i++)
+        loop_fds[i].fd = -1;
+    loop_driver_fd = driver_get_fd();
+    loop_get_stats(NULL, 1);
+#ifdef __linux__
+    if ((loop_epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+    {
+        fprintf(stderr, "Error in epoll_create1: %s\n", strerror(errno));
+        return -1;
+    }
+    if (loop_driver_fd >= 0)
+    {
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL}; // NULL表示驱动
+        if (epoll_ctl(loop_epfd, EPOLL_CTL_ADD, loop_driver_fd, &ev) < 0)
+        {
+            fprintf(stderr, "Error in epoll_ctl: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+#endif
+    return 0;
+}
+
+/**
+ * @brief 监听一个应用的文件描述符，可读时在loop_run_once中调用handler
+ *
+ * @param fd 文件描述符
+ * @param handler 可读时调用的函数
+ * @param arg 传给handler的参数
+ * @return int 成功为0，表满或平台不支持为-1
+ */
+int loop_add_fd(int fd, loop_handler_t handler, void *arg)
+{
+#ifdef __linux__
+    for (int i = 0; i < LOOP_FD_MAX; i++)
+        if (loop_fds[i].fd == -1)
+        {
+            struct epoll_event ev = {.events = EPOLLIN, .data.ptr = &loop_fds[i]};
+            if (epoll_ctl(loop_epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+            {
+                fprintf(stderr, "Error in loop_add_fd: %s\n", strerror(errno));
+                return -1;
+            }
+            loop_fds[i].fd = fd;
+            loop_fds[i].handler = handler;
+            loop_fds[i].arg = arg;
+            loop_fd_num++;
+            return 0;
+        }
+#endif
+    fprintf(stderr, "Error in loop_add_fd:%d\n", fd);
+    return -1;
+}
+
+/**
+ * @brief 停止监听一个应用的文件描述符
+ *
+ * @param fd 文件描述符
+ * @return int 成功为0，未监听为-1
+ */
+int loop_del_fd(int fd)
+{
+    for (int i = 0; i < LOOP_FD_MAX; i++)
+        if (loop_fds[i].fd == fd)
+        {
+#ifdef __linux__
+            epoll_ctl(loop_epfd, EPOLL_CTL_DEL, fd, NULL);
+#endif
+            loop_fds[i].fd = -1;
+            loop_fd_num--;
+            return 0;
+        }
+    return -1;
+}
+
+/**
+ * @brief 内部函数，计算本次等待的毫秒数
+ *
+ * @param max_wait_ms 调用者允许的最长等待，-1表示不限
+ * @return int 等待的毫秒数，-1表示直到有事件
+ */
+static int loop_timeout(int max_wait_ms)
+{
+    uint64_t deadline = net_next_deadline(), now = net_now_ns();
+    int timeout = -1;
+    if (deadline != NET_DEADLINE_NONE)
+        timeout = deadline <= now ? 0 : (int)min32((deadline - now + 999999) / 1000000, INT32_MAX); // 向上取整，醒来时定时器已到期
+    if (loop_driver_fd < 0 && (timeout < 0 || timeout > LOOP_POLL_MS))
+        timeout = LOOP_POLL_MS;
+    if (max_wait_ms >= 0 && (timeout < 0 || timeout > max_wait_ms))
+        timeout = max_wait_ms;
+    return timeout;
+}
+
+/**
+ * @brief 内部函数，轮询一次协议栈，有工作时计入忙时长
+ *
+ * @return int 完成的工作量
+ */
+static int loop_poll()
+{
+    int work = net_poll(); // net_poll开始时已更新时钟
+    loop_stat.polls++;
+    if (work)
+    {
+        uint64_t start = net_now_ns();
+        net_clock_update();
+        loop_stat.busy_ns += net_now_ns() - start;
+    }
+    return work;
+}
+
+/**
+ * @brief 内部函数，等待应用文件描述符或驱动就绪，并调用就绪的应用处理程序
+ *
+ * @param timeout 等待的毫秒数，-1表示直到有事件
+ * @return int 调用的处理程序个数
+ */
+static int loop_wait(int timeout)
+{
+    int work = 0;
+#ifdef __linux__
+    struct epoll_event events[LOOP_FD_MAX + 1];
+    int n = epoll_wait(loop_epfd, events, LOOP_FD_MAX + 1, timeout);
+    if (n < 0 && errno != EINTR)
+        fprintf(stderr, "Error in epoll_wait: %s\n", strerror(errno));
+    if (n <= 0)
+        return 0;
+    net_clock_update();
+    uint64_t start = net_now_ns();
+    for (int i = 0; i < n; i++)
+    {
+        loop_fd_t *entry = events[i].data.ptr;
+        if (entry && entry->fd >= 0) // 驱动的事件由之后的net_poll处理
+        {
+            entry->handler(entry->fd, entry->arg);
+            work++;
+        }
+    }
+    if (work)
+    {
+        net_clock_update();
+        loop_stat.busy_ns += net_now_ns() - start;
+    }
+#else
+    if (timeout > 0)
+    {
+        struct timespec ts = {timeout / 1000, (timeout % 1000) * 1000000L};
+        nanosleep(&ts, NULL);
+    }
+#endif
+    return work;
+}
+
+/**
+ * @brief 内部函数，忙轮询的一轮。空闲时按空闲时长逐级退避：
+ *        不足延迟目标的1/4时直接再次轮询，不足延迟目标时每轮执行LOOP_PAUSE_SPINS次pause，
+ *        此后每轮休眠延迟目标的时长，但不越过下一个定时器
+ *
+ * @return int 完成的工作量
+ */
+static int loop_run_busy()
+{
+    int work = loop_poll();
+    if (loop_fd_num)
+        work += loop_wait(0);
+    if (work)
+    {
+        loop_idle_ns = 0;
+        return work;
+    }
+    uint64_t now = net_now_ns();
+    if (loop_idle_ns == 0)
+        loop_idle_ns = now;
+    uint64_t idle = now - loop_idle_ns;
+    if (idle < loop_latency_ns / 4)
+        return 0;
+    if (idle < loop_latency_ns)
+    {
+        for (int i = 0; i < LOOP_PAUSE_SPINS; i++)
+            cpu_relax();
+        return 0;
+    }
+    uint64_t sleep = loop_latency_ns, deadline = net_next_deadline();
+    if (deadline != NET_DEADLINE_NONE)
+        sleep = deadline <= now ? 0 : min64(deadline - now, sleep);
+    if (sleep)
+    {
+        struct timespec ts = {sleep / 1000000000, sleep % 1000000000};
+        nanosleep(&ts, NULL);
+        loop_stat.sleeps++;
+    }
+    return 0;
+}
+
+/**
+ * @brief 事件循环的一轮：轮询协议栈，然后休眠直到数据包到达、应用的文件描述符可读或最早的定时器到期，
+ *        再处理就绪的应用文件描述符并再次轮询协议栈。协议栈有积压时不休眠
+ *        忙轮询模式下不等待事件，见loop_set_busy_poll
+ *
+ * @param max_wait_ms 最长等待的毫秒数，-1表示不限，忙轮询模式下不使用
+ * @return int 完成的工作量，包括处理的帧数、调用的定时器与应用处理程序个数
+ */
+int loop_run_once(int max_wait_ms)
+{
+    if (loop_latency_ns)
+        return loop_run_busy();
+    int work = loop_poll();
+    int timeout = work ? 0 : loop_timeout(max_wait_ms);
+    if (timeout)
+        loop_stat.sleeps++;
+    work += loop_wait(timeout);
+    return work + loop_poll();
+}
+
+/**
+ * @brief 把调用线程绑定到一个CPU上，忙轮询时应选择隔离出来的核心
+ *
+ * @param cpu CPU编号
+ * @return int 成功为0，失败或平台不支持为-1
+ */
+int loop_pin_cpu(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) == 0)
+        return 0;
+    fprintf(stderr, "Error in loop_pin_cpu:%d: %s\n", cpu, strerror(errno));
+#else
+    fprintf(stderr, "Error in loop_pin_cpu:%d, not supported\n", cpu);
+#endif
+    return -1;
+}
+
+/**
+ * @brief 设置忙轮询模式，此后loop_run_once不再等待事件，而是反复轮询协议栈，空闲时逐级退避
+ *
+ * @param latency_us 空闲退避允许增加的最大延迟（微秒），0表示关闭忙轮询，恢复等待事件
+ */
+void loop_set_busy_poll(uint64_t latency_us)
+{
+    loop_latency_ns = latency_us * 1000;
+    loop_idle_ns = 0;
+#ifdef __linux__
+    if (loop_latency_ns)
+        prctl(PR_SET_TIMERSLACK, 1UL); // 默认50微秒的定时器松弛会使短休眠超出延迟目标
+#endif
+}
+
+/**
+ * @brief 获取事件循环的忙闲统计
+ *
+ * @param stats 出口参数，统计数据，为NULL时只重置
+ * @param reset 是否在获取后重新开始统计
+ */
+void loop_get_stats(loop_stats_t *stats, int reset)
+{
+    net_clock_update();
+    uint64_t now = net_now_ns();
+    if (stats)
+    {
+        *stats = loop_stat;
+        stats->elapsed_ns = now - loop_stat.elapsed_ns;
+    }
+    if (reset)
+    {
+        memset(&loop_stat, 0, sizeof(loop_stat));
+        loop_stat.elapsed_ns = now;
+    }
+}
+
+/**
+ * @brief 打印上次报告以来的忙闲比，并重新开始统计，可作为协议栈定时器的处理程序
+ *
+ * @param arg 未使用
+ */
+void loop_report(void *arg)
+{
+    loop_stats_t stats;
+    loop_get_stats(&stats, 1);
+    printf("loop: busy %.1f%%, %llu polls, %llu sleeps in %.1fs\n",
+           stats.elapsed_ns ? 100.0 * stats.busy_ns / stats.elapsed_ns : 0.0,
+           (unsigned long long)stats.polls, (unsigned long long)stats.sleeps, stats.elapsed_ns / 1e9);
+}
+
+/**
+ * @brief 关闭事件循环
+ *
+ */
+void loop_close()
+{
+#ifdef __linux__
+    if (loop_epfd >= 0)
+        close(loop_epfd);
+#endif
+    loop_epfd = -1;
+}
@@ -3,6 +3,9 @@
 #include "tcp.h"
 #include "http.h"
 #include "driver.h"
+#include "loop.h"
+#include "rss.h"
+#include "pipeline.h"
 #include "time.h"
 
 #pragma GCC diagnostic push
@@ -33,9 +36,43 @@ void tcp_handler(tcp_connect_t* connect, connect_state_t state) {
 }
 #endif
 
-int main(int argc, char const *argv[])
+#ifdef RSS_WORKERS
+//工作线程启动后注册各自的监听回调，HTTP服务器只在主线程的实例中运行
+void worker_setup(int worker)
+{
+#ifdef UDP
+    udp_open(60000, udp_handler);
+#endif
+#ifdef TCP
+    tcp_open(61000, tcp_handler);
+#endif
+}
+#endif
+
+#ifdef PIPELINE
+//在应用线程中调用，连接由协议线程持有，只能通过pipeline_tcp_write写回
+void app_tcp_handler(const pipeline_conn_t* conn, connect_state_t state, const uint8_t* data, size_t len)
 {
+    if (state != TCP_CONN_DATA_RECV)
+        return;
+    printf("recv tcp packet from %s:%u len=%zu\n", iptos((uint8_t*)conn->ip), conn->remote_port, len);
+    printf("%.*s\n", (int)len, data);
+    pipeline_tcp_write(conn, data, len);
+}
+
+//协议线程启动后注册在协议线程中处理的udp监听回调
+void app_setup()
+{
+#ifdef UDP
+    udp_open(60000, udp_handler);
+#endif
+}
+#endif
 
+int main(int argc, char const *argv[])
+{
+    if (argc > 1 && driver_select(argv[1]) != 0) //第一个参数选择网卡后端，缺省为DRIVER_DEFAULT
+        return -1;
     if (net_init() != 0)
 	{
         printf("net init failed.");
@@ -49,17 +86,42 @@ int main(int argc, char const *argv[])
 #endif
 #ifdef HTTP
     http_server_open(62000);
+#endif
+    if (loop_init() != 0)
+    {
+        printf("loop init failed.");
+        return -1;
+    }
+#ifdef RSS_WORKERS
+    if (rss_start(RSS_WORKERS, worker_setup) != 0) //此后主循环只收包并按流分给工作线程
+    {
+        printf("rss start failed.");
+        return -1;
+    }
+#endif
+#ifdef PIPELINE
+    pipeline_tcp_open(61000, app_tcp_handler);
+    if (pipeline_start(app_setup) != 0) //此后主循环只收包，协议处理与应用处理在各自的线程中进行
+    {
+        printf("pipeline start failed.");
+        return -1;
+    }
+#endif
+#ifdef LOOP_BUSY_POLL_CPU
+    loop_pin_cpu(LOOP_BUSY_POLL_CPU); //绑定失败时仍忙轮询，只是可能被调度
+    loop_set_busy_poll(LOOP_LATENCY_US);
+    net_timer_add(LOOP_REPORT_SEC * 1000, LOOP_REPORT_SEC * 1000, loop_report, NULL);
 #endif
     while (1) 
 	{
-        //一次主循环
-        net_poll(); //一次主循环
 #ifdef HTTP
+        //有等待处理的http连接时不休眠，先轮询一次再处理
+        loop_run_once(http_server_pending() ? 0 : -1);
         http_server_run();
+#else
+        //一次主循环，休眠直到收到数据包或定时器到期，忙轮询时不休眠
+        loop_run_once(-1);
 #endif
-        // 节约用电
-        struct timespec sleepTime = { 0, 1000000 };
-        nanosleep(&sleepTime, NULL);
     }
 
     return 0;
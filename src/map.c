@@ -1,92 +1,582 @@
+#include <stdio.h>
 #include <string.h>
 #include "map.h"
+#include "utils.h"
+
+#define MAP_SLOT_EMPTY 0          //空桶
+#define MAP_SLOT_DELETED UINT32_MAX //已删除的桶（墓碑）
+#define MAP_LIST_NIL UINT32_MAX     //淘汰链表的空指针
+
+/**
+ * @brief 内部函数，键值对的长度，布局为[键][值][更新时间]
+ *
+ * @param map 要获取的map
+ * @return size_t 键值对长度
+ */
+static inline size_t map_entry_len(const map_t *map)
+{
+    return map->key_len + map->value_len + sizeof(time_t);
+}
+
+/**
+ * @brief 内部函数，获取第n个物理位置的键值对
+ *
+ * @param map 要获取的map
+ * @param pos 位置
+ * @return uint8_t* 键值对指针
+ */
+static inline uint8_t *map_entry_get(map_t *map, size_t pos)
+{
+    return map_entry_at(map, pos);
+}
+
+/**
+ * @brief 内部函数，获取键值对的更新时间指针
+ *
+ * @param map 所属map
+ * @param entry 键值对指针
+ * @return time_t* 更新时间指针，为0表示该位置空闲
+ */
+static inline time_t *map_entry_time(const map_t *map, uint8_t *entry)
+{
+    return (time_t *)(entry + map->key_len + map->value_len);
+}
+
+/**
+ * @brief 内部函数，判断键值对是否有效
+ *
+ * @param map 要判断的map
+ * @param entry 键值对指针
+ * @return int 1为合法，0为不合法
+ */
+static inline int map_entry_valid(map_t *map, uint8_t *entry)
+{
+    time_t entry_time = *map_entry_time(map, entry);
+    return entry_time && (!map->timeout || entry_time + map->timeout >= net_now());
+}
+
+/**
+ * @brief 内部函数，计算键的哈希值
+ *
+ * @param key 键指针
+ * @param len 键的长度
+ * @return uint32_t 哈希值
+ */
+static uint32_t map_hash(const void *key, size_t len)
+{
+    const uint8_t *p = key;
+    uint64_t k = 0;
+    switch (len) // 与MAP_DEFINE_FIXED生成的特化版本一致，按对应宽度的整数装入
+    {
+    case sizeof(uint16_t):
+        return map_hash_word(map16_key(p), len);
+    case sizeof(uint32_t):
+        return map_hash_word(map32_key(p), len);
+    case sizeof(uint64_t):
+        return map_hash_word(map64_key(p), len);
+    }
+    if (len < sizeof(uint64_t))
+    {
+        memcpy(&k, p, len);
+        return map_hash_word(k, len);
+    }
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ len;
+    for (; len > 8; p += 8, len -= 8)
+    {
+        memcpy(&k, p, 8);
+        h = (h ^ k) * 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+    }
+    k = 0;
+    memcpy(&k, p, len);
+    return map_hash_word(h ^ k, len);
+}
+
+/**
+ * @brief 内部函数，在哈希索引中查找键所在的桶
+ *
+ * @param map 要查找的map
+ * @param key 键指针
+ * @param hash 键的哈希值
+ * @return map_bucket_t* 键所在的桶，找不到为NULL
+ */
+static map_bucket_t *map_bucket_find(map_t *map, const void *key, uint32_t hash)
+{
+    if (map->bucket_num == 0)
+        return NULL;
+    size_t mask = map->bucket_num - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        map_bucket_t *bucket = &map->buckets[i];
+        if (bucket->slot == MAP_SLOT_EMPTY)
+            return NULL;
+        if (bucket->slot != MAP_SLOT_DELETED && bucket->hash == hash &&
+            !memcmp(key, map_entry_get(map, bucket->slot - 1), map->key_len))
+            return bucket;
+    }
+}
+
+/**
+ * @brief 内部函数，把物理位置插入哈希索引
+ *
+ * @param map 要操作的map
+ * @param hash 键的哈希值
+ * @param slot 键值对的物理位置
+ */
+static void map_bucket_insert(map_t *map, uint32_t hash, size_t slot)
+{
+    size_t mask = map->bucket_num - 1;
+    size_t i = hash & mask;
+    while (map->buckets[i].slot != MAP_SLOT_EMPTY && map->buckets[i].slot != MAP_SLOT_DELETED)
+        i = (i + 1) & mask;
+    if (map->buckets[i].slot == MAP_SLOT_DELETED)
+        map->tombstones--;
+    map->buckets[i].hash = hash;
+    map->buckets[i].slot = slot + 1;
+}
+
+/**
+ * @brief 内部函数，清除墓碑，按物理位置重建哈希索引
+ *
+ * @param map 要操作的map
+ */
+static void map_rehash(map_t *map)
+{
+    memset(map->buckets, 0, map->bucket_num * sizeof(map_bucket_t));
+    map->tombstones = 0;
+    for (size_t i = 0; i < map->used; i++)
+    {
+        uint8_t *entry = map_entry_get(map, i);
+        if (*map_entry_time(map, entry))
+            map_bucket_insert(map, map_hash(entry, map->key_len), i);
+    }
+}
+
+/**
+ * @brief 内部函数，把物理位置从淘汰链表中摘下
+ *
+ * @param map 要操作的map
+ * @param slot 物理位置
+ */
+static void map_list_unlink(map_t *map, size_t slot)
+{
+    uint32_t prev = map->list_prev[slot], next = map->list_next[slot];
+    if (prev == MAP_LIST_NIL)
+        map->list_head = next;
+    else
+        map->list_next[prev] = next;
+    if (next == MAP_LIST_NIL)
+        map->list_tail = prev;
+    else
+        map->list_prev[next] = prev;
+}
+
+/**
+ * @brief 内部函数，把物理位置挂到淘汰链表尾部，链表头部即下一个被淘汰的键值对
+ *
+ * @param map 要操作的map
+ * @param slot 物理位置
+ */
+static void map_list_append(map_t *map, size_t slot)
+{
+    map->list_prev[slot] = map->list_tail;
+    map->list_next[slot] = MAP_LIST_NIL;
+    if (map->list_tail == MAP_LIST_NIL)
+        map->list_head = slot;
+    else
+        map->list_next[map->list_tail] = slot;
+    map->list_tail = slot;
+}
+
+/**
+ * @brief 内部函数，移除桶对应的键值对，释放其物理位置
+ *
+ * @param map 要操作的map
+ * @param bucket 键值对所在的桶
+ */
+static void map_bucket_remove(map_t *map, map_bucket_t *bucket)
+{
+    size_t slot = bucket->slot - 1;
+    uint8_t *entry = map_entry_get(map, slot);
+    if (map->value_destructor)
+        map->value_destructor(entry + map->key_len);
+    *map_entry_time(map, entry) = 0;
+    map_list_unlink(map, slot);
+    bucket->slot = MAP_SLOT_DELETED;
+    map->tombstones++;
+    map->free_slots[map->free_num++] = slot;
+    map->size--;
+}
+
+/**
+ * @brief 内部函数，map已满时按淘汰策略腾出一个位置
+ *        更新时间与链表顺序一致（MAP_EVICT_LRU除外），因此只需检查链表头部是否超时
+ *        头部未超时时，在链表头部起MAP_EVICT_SCAN个键值对中优先淘汰已超时或evict_check认为可直接淘汰的，
+ *        都不可时淘汰头部，并在析构前调用evict_handler通知其持有者
+ *
+ * @param map 要操作的map
+ * @return int 成功为0，策略拒绝淘汰为-1
+ */
+static int map_evict(map_t *map)
+{
+    if (map->list_head == MAP_LIST_NIL)
+        return -1;
+    uint8_t *entry = map_entry_get(map, map->list_head);
+    if (map_entry_valid(map, entry))
+    {
+        if (map->policy == MAP_EVICT_REFUSE)
+            return -1;
+        int idle = 0;
+        uint32_t slot = map->list_next[map->list_head];
+        if (map->evict_check)
+            idle = map->evict_check(entry, entry + map->key_len);
+        for (int i = 1; !idle && i < MAP_EVICT_SCAN && slot != MAP_LIST_NIL; i++, slot = map->list_next[slot])
+        {
+            uint8_t *candidate = map_entry_get(map, slot);
+            if (!map_entry_valid(map, candidate) || (map->evict_check && map->evict_check(candidate, candidate + map->key_len)))
+            {
+                entry = candidate;
+                idle = 1;
+            }
+        }
+        if (map_entry_valid(map, entry))
+            map->evictions++;
+        if (!idle && map->evict_handler)
+            map->evict_handler(entry, entry + map->key_len);
+    }
+    // 回调中持有者可能已自行删除该键值对
+    map_bucket_t *bucket = map_bucket_find(map, entry, map_hash(entry, map->key_len));
+    if (bucket)
+        map_bucket_remove(map, bucket);
+    return 0;
+}
+
+/**
+ * @brief 内部函数，计算容量对应的哈希索引桶数，为2的幂且不少于容量的两倍，保证装载因子不超过0.5
+ *
+ * @param capacity 容量
+ * @return size_t 桶数
+ */
+static size_t map_bucket_num(size_t capacity)
+{
+    size_t bucket_num = 1;
+    while (bucket_num < 2 * capacity)
+        bucket_num <<= 1;
+    return bucket_num;
+}
+
+/**
+ * @brief 内部函数，计算指定容量所需的内存
+ *
+ * @param map 所属map
+ * @param capacity 容量
+ * @return size_t 字节数
+ */
+static size_t map_memory_of(const map_t *map, size_t capacity)
+{
+    if (capacity == 0)
+        return 0;
+    return capacity * (map_entry_len(map) + 3 * sizeof(uint32_t)) + map_bucket_num(capacity) * sizeof(map_bucket_t);
+}
+
+/**
+ * @brief 内部函数，计算内存预算内能容纳的最大容量
+ *
+ * @param map 所属map
+ * @param budget 内存预算（字节）
+ * @return size_t 最大容量
+ */
+static size_t map_budget_size(const map_t *map, size_t budget)
+{
+    size_t size = budget / (map_entry_len(map) + 3 * sizeof(uint32_t) + 2 * sizeof(map_bucket_t));
+    while (size && map_memory_of(map, size) > budget)
+        size = map_bucket_num(size) / 4; // 桶数向上取整到2的幂后超出预算，退到上一档桶数
+    if (map->size_limit && map->size_limit < size)
+        size = map->size_limit;
+    return size;
+}
+
+/**
+ * @brief 内部函数，扩容到两倍（首次为MAP_INIT_SIZE），不超过最大容量
+ *        键值对数组追加一段而不是重新分配，已有的键值对不移动，值指针在扩容后仍然有效，遍历顺序也不受影响
+ *        受最大容量限制只分配了一部分的段不能再扩大，此后不再扩容
+ *
+ * @param map 要扩容的map
+ * @return int 成功为0，失败为-1
+ */
+static int map_grow(map_t *map)
+{
+    size_t capacity = map->capacity ? 2 * map->capacity : MAP_INIT_SIZE;
+    if (capacity > map->max_size)
+        capacity = map->max_size;
+    size_t n = map->capacity / MAP_INIT_SIZE; // 已分配的段都是满的时，容量为MAP_INIT_SIZE的2的幂倍
+    if (capacity <= map->capacity || map->capacity % MAP_INIT_SIZE || (n & (n - 1)))
+        return -1;
+    unsigned k = n ? __builtin_ctzll(n) + 1 : 0; // 新段的序号
+    if (k >= MAP_CHUNK_NUM)
+        return -1;
+    size_t bucket_num = map_bucket_num(capacity);
+    // 各数组逐个扩大，容量在全部成功后才更新，中途失败不影响现有内容
+    uint8_t *chunk = map->chunks[k] ? map->chunks[k] : malloc((capacity - map->capacity) * map_entry_len(map));
+    if (chunk)
+        map->chunks[k] = chunk;
+    void *free_slots = chunk ? realloc(map->free_slots, capacity * sizeof(uint32_t)) : NULL;
+    if (free_slots)
+        map->free_slots = free_slots;
+    void *list_prev = free_slots ? realloc(map->list_prev, capacity * sizeof(uint32_t)) : NULL;
+    if (list_prev)
+        map->list_prev = list_prev;
+    void *list_next = list_prev ? realloc(map->list_next, capacity * sizeof(uint32_t)) : NULL;
+    if (list_next)
+        map->list_next = list_next;
+    map_bucket_t *buckets = list_next ? malloc(bucket_num * sizeof(map_bucket_t)) : NULL;
+    if (buckets == NULL)
+    {
+        fprintf(stderr, "Error in map_grow: out of memory for %zu entries\n", capacity);
+        return -1;
+    }
+    free(map->buckets);
+    map->buckets = buckets;
+    map->bucket_num = bucket_num;
+    map->capacity = capacity;
+    map_rehash(map);
+    return 0;
+}
 
 /**
- * @brief 初始化map
- * 
+ * @brief 初始化map，不分配内存，首次插入时才分配MAP_INIT_SIZE的容量，此后按需倍增
+ *
  * @param map 要初始化的map
  * @param key_len 键的长度
  * @param value_len 值的长度
- * @param max_size 最大容量，为0则根据MAP_MAX_LEN自动设置
+ * @param max_size 最大容量，为0则只受内存预算限制
  * @param timeout 超时秒数，为0则永不超时
  * @param value_constuctor 形如memcpy的构造函数，用于拷贝值到容器中，为NULL则使用memcpy
+ * @param value_destructor 值的析构函数，为NULL则不做处理
  */
-void map_init(map_t *map, size_t key_len, size_t value_len, size_t max_size, time_t timeout, map_constuctor_t value_constuctor)
+void map_init(map_t *map, size_t key_len, size_t value_len, size_t max_size, time_t timeout, map_constuctor_t value_constuctor, map_destructor_t value_destructor)
 {
-    if (max_size == 0 || max_size * (key_len + value_len + sizeof(time_t)) > MAP_MAX_LEN)
-        max_size = MAP_MAX_LEN / (key_len + value_len + sizeof(time_t));
     if (value_constuctor == NULL)
         value_constuctor = (map_constuctor_t)memcpy;
 
     memset(map, 0, sizeof(map_t));
     map->key_len = key_len;
     map->value_len = value_len;
-    map->max_size = max_size;
+    map->size_limit = max_size;
     map->timeout = timeout;
     map->value_constuctor = value_constuctor;
+    map->value_destructor = value_destructor;
+    map->budget = MAP_MAX_LEN;
+    map->max_size = map_budget_size(map, map->budget);
+    map->policy = MAP_EVICT_REFUSE;
+    map->list_head = map->list_tail = MAP_LIST_NIL;
 }
 
 /**
- * @brief 获取map当前大小
- * 
+ * @brief 设置map已满时的淘汰策略
+ *
+ * @param map 要设置的map
+ * @param policy 淘汰策略
+ */
+void map_set_policy(map_t *map, map_policy_t policy)
+{
+    map->policy = policy;
+}
+
+/**
+ * @brief 设置淘汰未超时键值对时的回调，使淘汰优先选择可直接丢弃的键值对，并能通知仍在使用的键值对的持有者
+ *
+ * @param map 要设置的map
+ * @param check 判断键值对可否直接淘汰，为NULL则只按淘汰策略的顺序
+ * @param handler 淘汰仍在使用的键值对前的回调，可在其中删除该键值对，为NULL则不通知
+ */
+void map_set_evict_handler(map_t *map, map_evict_check_t check, map_evict_handler_t handler)
+{
+    map->evict_check = check;
+    map->evict_handler = handler;
+}
+
+/**
+ * @brief 获取map因容量不足而淘汰的未超时键值对数量
+ *
  * @param map 要获取的map
- * @return size_t map大小
+ * @return size_t 淘汰数量
  */
-size_t map_size(map_t *map)
+size_t map_evictions(map_t *map)
 {
-    return map->size;
+    return map->evictions;
 }
 
 /**
- * @brief 内部函数，获取第n个物理位置的键值对
- * 
+ * @brief 设置map的内存预算，已分配的内存不会收缩，只限制此后的扩容
+ *        已因原预算只分配了一部分的最后一段不能再扩大，提高预算要在map_free之后才生效
+ *
+ * @param map 要设置的map
+ * @param budget 内存预算（字节）
+ * @return int 成功为0，预算容纳不下现有键值对则为-1
+ */
+int map_set_budget(map_t *map, size_t budget)
+{
+    size_t max_size = map_budget_size(map, budget);
+    if (max_size < map->size || max_size == 0)
+        return -1;
+    map->budget = budget;
+    map->max_size = max_size;
+    return 0;
+}
+
+/**
+ * @brief 获取map当前占用的堆内存
+ *
  * @param map 要获取的map
- * @param pos 位置
- * @return void* 键值对指针
+ * @return size_t 字节数
  */
-void *map_entry_get(map_t *map, size_t pos)
+size_t map_memory(map_t *map)
 {
-    if (pos >= map->max_size)
-        return NULL;
-    return map->data + pos * (map->key_len + map->value_len + sizeof(time_t));
+    return map_memory_of(map, map->capacity);
 }
 
 /**
- * @brief 内部函数，判断键值对是否有效
- * 
- * @param map 要判断的map
- * @param entry 键值对指针
- * @return int 1为合法，0为不合法
+ * @brief 释放map的全部键值对与内存，之后map可继续使用
+ *
+ * @param map 要释放的map
+ */
+void map_free(map_t *map)
+{
+    if (map->value_destructor)
+        for (size_t i = 0; i < map->used; i++)
+        {
+            uint8_t *entry = map_entry_get(map, i);
+            if (*map_entry_time(map, entry))
+                map->value_destructor(entry + map->key_len);
+        }
+    for (unsigned k = 0; k < MAP_CHUNK_NUM; k++)
+        free(map->chunks[k]);
+    free(map->buckets);
+    free(map->free_slots);
+    free(map->list_prev);
+    free(map->list_next);
+    memset(map->chunks, 0, sizeof(map->chunks));
+    map->buckets = NULL;
+    map->free_slots = NULL;
+    map->list_prev = map->list_next = NULL;
+    map->list_head = map->list_tail = MAP_LIST_NIL;
+    map->capacity = map->bucket_num = 0;
+    map->size = map->used = map->free_num = map->tombstones = 0;
+}
+
+/**
+ * @brief 获取map当前大小
+ *
+ * @param map 要获取的map
+ * @return size_t map大小
+ */
+size_t map_size(map_t *map)
+{
+    return map->size;
+}
+
+/**
+ * @brief 确认查找命中的键值对，超时则回收，LRU策略下移到链表尾部
+ *        供map_get与定长键的特化版本使用
+ *
+ * @param map 所属map
+ * @param bucket 键所在的桶
+ * @return void* 值指针，已超时为NULL
  */
-int map_entry_valid(map_t *map, const void *entry)
+void *map_bucket_hit(map_t *map, map_bucket_t *bucket)
 {
-    time_t entry_time = *(time_t *)((uint8_t *)entry + map->key_len + map->value_len);
-    return entry_time && (!map->timeout || entry_time + map->timeout >= time(NULL));
+    uint8_t *entry = map_entry_get(map, bucket->slot - 1);
+    if (!map_entry_valid(map, entry))
+    {
+        map_bucket_remove(map, bucket);
+        return NULL;
+    }
+    if (map->policy == MAP_EVICT_LRU && map->list_tail != bucket->slot - 1)
+    {
+        map_list_unlink(map, bucket->slot - 1);
+        map_list_append(map, bucket->slot - 1);
+    }
+    return entry + map->key_len;
 }
 
 /**
- * @brief 获取map中指定键的值
- * 
+ * @brief 获取map中指定键的值，遇到超时的键值对则顺便回收
+ *        值指针不随扩容移动，但该键值对被删除、超时回收或被map_set淘汰后，
+ *        其位置会被之后插入的键值对复用，持有指针的调用者须在这些情况下丢弃指针
+ *
  * @param map 要获取的map
  * @param key 键指针
- * @return void* 值指针，找不到为NULL 
+ * @return void* 值指针，找不到为NULL
  */
 void *map_get(map_t *map, const void *key)
 {
     if (key == NULL)
         return NULL;
-    for (size_t i = 0; i < map->max_size; i++)
+    map_bucket_t *bucket = map_bucket_find(map, key, map_hash(key, map->key_len));
+    if (bucket == NULL)
+        return NULL;
+    return map_bucket_hit(map, bucket);
+}
+
+/**
+ * @brief 批量获取map中多个键的值，语义与逐个调用map_get相同
+ *        分三趟处理：先计算全部哈希并预取桶，再按哈希找到候选桶并预取键值对，
+ *        最后比较键，使一批键的缓存未命中相互重叠
+ *
+ * @param map 要获取的map
+ * @param keys 键指针数组
+ * @param n 键的数量
+ * @param values 输出的值指针数组，找不到的为NULL
+ * @return size_t 找到的键数
+ */
+size_t map_get_batch(map_t *map, const void *const *keys, size_t n, void **values)
+{
+    uint32_t hashes[MAP_BATCH_MAX];
+    map_bucket_t *candidates[MAP_BATCH_MAX];
+    size_t found = 0;
+    if (map->bucket_num == 0)
     {
-        uint8_t *entry = map_entry_get(map, i);
-        if (map_entry_valid(map, entry) && !memcmp(key, entry, map->key_len))
-            return entry + map->key_len;
+        memset(values, 0, n * sizeof(void *));
+        return 0;
     }
-    return NULL;
+    size_t mask = map->bucket_num - 1;
+    for (size_t base = 0; base < n; base += MAP_BATCH_MAX)
+    {
+        size_t burst = n - base < MAP_BATCH_MAX ? n - base : MAP_BATCH_MAX;
+        for (size_t i = 0; i < burst; i++)
+        {
+            hashes[i] = map_hash(keys[base + i], map->key_len);
+            __builtin_prefetch(&map->buckets[hashes[i] & mask]);
+        }
+        for (size_t i = 0; i < burst; i++)
+        {
+            size_t j = hashes[i] & mask;
+            while (map->buckets[j].slot != MAP_SLOT_EMPTY &&
+                   (map->buckets[j].slot == MAP_SLOT_DELETED || map->buckets[j].hash != hashes[i]))
+                j = (j + 1) & mask;
+            candidates[i] = map->buckets[j].slot == MAP_SLOT_EMPTY ? NULL : &map->buckets[j];
+            if (candidates[i])
+                __builtin_prefetch(map_entry_get(map, candidates[i]->slot - 1));
+        }
+        for (size_t i = 0; i < burst; i++)
+        {
+            map_bucket_t *bucket = candidates[i];
+            // 候选桶只比较了哈希，键不同时按完整的探测序列重新查找
+            if (bucket && (bucket->slot == MAP_SLOT_DELETED ||
+                           memcmp(keys[base + i], map_entry_get(map, bucket->slot - 1), map->key_len)))
+                bucket = map_bucket_find(map, keys[base + i], hashes[i]);
+            values[base + i] = bucket ? map_bucket_hit(map, bucket) : NULL;
+            found += values[base + i] != NULL;
+        }
+    }
+    return found;
 }
 
 /**
- * @brief 插入或更新map中指定键的值
- * 
+ * @brief 插入或更新map中指定键的值，更新时值的位置不变
+ *        map已满时可能按淘汰策略删除另一个键值对，指向它的值指针随之失效
+ *
  * @param map 要操作的map
  * @param key 键指针
  * @param value 值指针
@@ -94,59 +584,87 @@ void *map_get(map_t *map, const void *key)
 */
 int map_set(map_t *map, const void *key, const void *value)
 {
-    uint8_t *old_value = map_get(map, key);
-    if (old_value)
+    uint32_t hash = map_hash(key, map->key_len);
+    map_bucket_t *bucket = map_bucket_find(map, key, hash);
+    if (bucket)
     {
-        map->value_constuctor(old_value, value, map->value_len);
-        *(time_t *)(old_value + map->value_len) = time(NULL);
+        uint8_t *entry = map_entry_get(map, bucket->slot - 1);
+        if (map->value_destructor)
+            map->value_destructor(entry + map->key_len);
+        map->value_constuctor(entry + map->key_len, value, map->value_len);
+        *map_entry_time(map, entry) = net_now();
+        map_list_unlink(map, bucket->slot - 1);
+        map_list_append(map, bucket->slot - 1);
         return 0;
     }
-    if (map->size == map->max_size)
+    if (map->size == map->max_size && map_evict(map) != 0)
         return -1;
-    for (size_t i = 0; i < map->max_size; i++)
-    {
-        uint8_t *entry = map_entry_get(map, i);
-        if (!map_entry_valid(map, entry))
-        {
-            memcpy(entry, key, map->key_len);
-            map->value_constuctor(entry + map->key_len, value, map->value_len);
-            *(time_t *)(entry + map->key_len + map->value_len) = time(NULL);
-            map->size++;
-            return 0;
-        }
-    }
 
-    return -1;
+    if (map->free_num == 0 && map->used == map->capacity && map_grow(map) != 0)
+        return -1;
+    // 墓碑过多时在写入新键值对之前重建索引，新键值对只由下面的map_bucket_insert索引一次
+    if ((map->size + 1 + map->tombstones) * 4 > map->bucket_num * 3)
+        map_rehash(map);
+
+    size_t slot = map->free_num ? map->free_slots[--map->free_num] : map->used++;
+    uint8_t *entry = map_entry_get(map, slot);
+    memcpy(entry, key, map->key_len);
+    map->value_constuctor(entry + map->key_len, value, map->value_len);
+    *map_entry_time(map, entry) = net_now();
+    map_list_append(map, slot);
+    map->size++;
+    map_bucket_insert(map, hash, slot);
+    return 0;
 }
 
 /**
  * @brief 删除map中指定的键
- * 
+ *
  * @param map 要操作的map
  * @param key 键指针
  */
 void map_delete(map_t *map, const void *key)
 {
-    uint8_t *value = map_get(map, key);
-    if (value)
+    map_bucket_t *bucket = map_bucket_find(map, key, map_hash(key, map->key_len));
+    if (bucket)
+        map_bucket_remove(map, bucket);
+}
+
+/**
+ * @brief 回收map中全部已超时的键值对，供定时老化使用，map_get与map_set只顺便回收遇到的键值对
+ *
+ * @param map 要操作的map
+ * @return size_t 回收的键值对数
+ */
+size_t map_expire(map_t *map)
+{
+    size_t n = 0;
+    if (!map->timeout)
+        return 0;
+    for (size_t i = 0; i < map->used; i++)
     {
-        *(time_t *)(value + map->value_len) = 0;
-        map->size--;
+        uint8_t *entry = map_entry_get(map, i);
+        if (*map_entry_time(map, entry) && !map_entry_valid(map, entry))
+        {
+            map_bucket_remove(map, map_bucket_find(map, entry, map_hash(entry, map->key_len)));
+            n++;
+        }
     }
+    return n;
 }
 
 /**
- * @brief 遍历map
- * 
+ * @brief 遍历map，按物理位置顺序访问
+ *
  * @param map 要遍历的map
  * @param handler 对每个键值对应用的回调函数，参数为（键指针，值指针，更新时间指针）
  */
 void map_foreach(map_t *map, map_entry_handler_t handler)
 {
-    for (size_t i = 0; i < map->max_size; i++)
+    for (size_t i = 0; i < map->used; i++)
     {
         uint8_t *entry = map_entry_get(map, i);
         if (map_entry_valid(map, entry))
-            handler(entry, entry + map->key_len, (time_t *)(entry + map->key_len + map->value_len));
+            handler(entry, entry + map->key_len, map_entry_time(map, entry));
     }
 }
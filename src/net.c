@@ -8,38 +8,104 @@
 #include "tcp.h"
 
 /**
- * @brief 协议表 <协议号,处理程序>的容器
+ * @brief 默认协议栈实例的网卡接收和发送缓冲区
  * 
  */
-map_t net_table;
+static uint8_t rxbuf_payload[BUF_MAX_LEN], txbuf_payload[BUF_MAX_LEN];
 
 /**
- * @brief 网卡MAC地址
+ * @brief 默认协议栈实例，使用config.h中的地址与静态缓冲池
  * 
  */
-uint8_t net_if_mac[NET_MAC_LEN] = NET_IF_MAC;
+static net_stack_t net_stack_default = {
+    .if_mac = NET_IF_MAC,
+    .if_ip = NET_IF_IP,
+    .if_mtu = ETHERNET_MAX_TRANSPORT_UNIT,
+    .rxbuf = BUF_INITIALIZER(rxbuf_payload),
+    .txbuf = BUF_INITIALIZER(txbuf_payload),
+};
+
+_Thread_local net_stack_t *net_stack = &net_stack_default;
+
+typedef struct net_stack_mem //net_stack_create分配的内存，收发缓冲区紧随实例之后
+{
+    net_stack_t stack;
+    uint8_t rxbuf_payload[BUF_MAX_LEN] __attribute__((aligned(64)));
+    uint8_t txbuf_payload[BUF_MAX_LEN] __attribute__((aligned(64)));
+} net_stack_mem_t;
 
 /**
- * @brief 网卡IP地址
+ * @brief 创建一个协议栈实例，之后在运行它的线程中调用net_stack_enter与net_init
  * 
+ * @param mac 网卡MAC地址
+ * @param ip 网卡IP地址
+ * @return net_stack_t* 新的实例，内存不足为NULL
  */
-uint8_t net_if_ip[NET_IP_LEN] = NET_IF_IP;
+net_stack_t *net_stack_create(const uint8_t *mac, const uint8_t *ip)
+{
+    net_stack_mem_t *mem = aligned_alloc(64, sizeof(net_stack_mem_t));
+    if (mem == NULL)
+    {
+        fprintf(stderr, "Error in net_stack_create.\n");
+        return NULL;
+    }
+    memset(&mem->stack, 0, sizeof(net_stack_t));
+    net_stack_t *stack = &mem->stack;
+    memcpy(stack->if_mac, mac, NET_MAC_LEN);
+    memcpy(stack->if_ip, ip, NET_IP_LEN);
+    stack->if_mtu = ETHERNET_MAX_TRANSPORT_UNIT;
+    buf_t rxbuf = BUF_INITIALIZER(mem->rxbuf_payload), txbuf = BUF_INITIALIZER(mem->txbuf_payload);
+    stack->rxbuf = rxbuf;
+    stack->txbuf = txbuf;
+    if (buf_pool_create(stack->pools) == -1)
+    {
+        free(mem);
+        return NULL;
+    }
+    return stack;
+}
 
 /**
- * @brief 网卡接收和发送缓冲区
+ * @brief 在当前线程中切换到一个协议栈实例，此后的协议栈调用与buf分配都作用于它
+ *        一个实例同一时间只能由一个线程运行
  * 
+ * @param stack 协议栈实例
  */
-buf_t rxbuf, txbuf; //一个buf足够单线程使用
+void net_stack_enter(net_stack_t *stack)
+{
+    net_stack = stack;
+    buf_pool_use(stack == &net_stack_default ? NULL : stack->pools);
+}
 
 /**
- * @brief 初始化协议栈
+ * @brief 关闭并释放net_stack_create创建的协议栈实例，释放的是当前实例时当前线程回到默认实例
  * 
+ * @param stack 协议栈实例
  */
-int net_init()
+void net_stack_destroy(net_stack_t *stack)
+{
+    if (stack == &net_stack_default)
+        return;
+    net_stack_t *current = net_stack;
+    net_stack_enter(stack);
+    driver_close();
+    map_free(&stack->connect_table); // 连接与arp缓存中的buf需在缓冲池之前释放
+    map_free(&stack->tcp_table);
+    map_free(&stack->udp_table);
+    map_free(&stack->arp_buf);
+    map_free(&stack->arp_table);
+    free(stack->http_fifo);
+    net_stack_enter(current == stack ? &net_stack_default : current);
+    buf_pool_destroy(stack->pools);
+    free(stack);
+}
+
+/**
+ * @brief 内部函数，初始化当前协议栈实例的各层协议
+ * 
+ */
+static void net_init_protocols()
 {
-    map_init(&net_table, sizeof(uint16_t), sizeof(net_handler_t), 0, 0, NULL);
-    if (driver_open() == -1)
-        return -1;
 #ifdef ETHERNET
     ethernet_init();
 #ifdef ARP
@@ -58,46 +124,343 @@ int net_init()
 #endif
 #endif
 #endif
+}
+
+/**
+ * @brief 初始化当前协议栈实例并打开网卡
+ * 
+ */
+int net_init()
+{
+    net_clock_update();
+    buf_pool_init();
+    if (driver_open() == -1)
+        return -1;
+    net_stack->if_caps = driver_caps();
+    net_stack->if_mtu = min32(driver_mtu(), ETHERNET_MAX_TRANSPORT_UNIT); //缓冲区按以太网的最大传输单元分配
+    net_init_protocols();
     return 0;
 }
 
+/**
+ * @brief 初始化当前协议栈实例，与另一个实例共用已打开的网卡，
+ *        当前实例只经由网卡发送，收到的帧由调用者交给ethernet_in_burst
+ *        销毁当前实例前应把driver置为NULL，网卡由打开它的实例关闭
+ * 
+ * @param owner 打开网卡的实例
+ */
+void net_init_shared(const net_stack_t *owner)
+{
+    net_clock_update();
+    net_stack->driver_ops = owner->driver_ops;
+    net_stack->driver = owner->driver;
+    net_stack->if_caps = owner->if_caps;
+    net_stack->if_mtu = owner->if_mtu;
+    net_init_protocols();
+}
+
+/**
+ * @brief 内部函数，查找协议号在分发表中的项
+ * 
+ * @param protocol 协议号，小于NET_IP_PROTOCOL_NUM为ip协议号，否则为以太网类型
+ * @return net_entry_t* 对应的项，以太网类型的槽位被其他类型占用时为NULL
+ */
+static net_entry_t *net_entry(uint16_t protocol)
+{
+    if (protocol < NET_IP_PROTOCOL_NUM)
+        return &net_stack->ip_table[protocol];
+    if (protocol < NET_ETHER_MIN)
+        return NULL;
+    net_entry_t *entry = &net_stack->ether_table[NET_ETHER_HASH(protocol)];
+    if (entry->handler && entry->protocol != protocol)
+        return NULL;
+    return entry;
+}
+
 /**
  * @brief 向协议栈注册一个协议
  * 
- * @param protocol 协议号 
+ * @param protocol 协议号，小于NET_IP_PROTOCOL_NUM为ip协议号，否则为以太网类型
  * @param handler 该协议的in处理程序
+ * @return int 成功为0，以太网类型与已注册的类型哈希冲突为-1
+ */
+int net_add_protocol(uint16_t protocol, net_handler_t handler)
+{
+    net_entry_t *entry = net_entry(protocol);
+    if (entry == NULL)
+    {
+        fprintf(stderr, "Error in net_add_protocol:0x%04x\n", protocol);
+        return -1;
+    }
+    entry->protocol = protocol;
+    entry->handler = handler;
+    return 0;
+}
+
+/**
+ * @brief 获取一个协议的收包统计
+ * 
+ * @param protocol 协议号，小于NET_IP_PROTOCOL_NUM为ip协议号，否则为以太网类型
+ * @param stats 出口参数，统计数据
+ * @return int 成功为0，协议未注册为-1
+ */
+int net_protocol_stats(uint16_t protocol, net_stats_t *stats)
+{
+    net_entry_t *entry = net_entry(protocol);
+    if (entry == NULL || entry->handler == NULL)
+        return -1;
+    *stats = entry->stats;
+    return 0;
+}
+
+/**
+ * @brief 为协议注册批量处理程序，net_in_burst/net_ip_in_burst交付的一组数据包由它一次处理，
+ *        未注册时逐个调用单包的处理程序
+ * 
+ * @param protocol 协议号，须已用net_add_protocol注册
+ * @param handler 该协议的批量in处理程序
+ * @return int 成功为0，协议未注册为-1
+ */
+int net_add_protocol_burst(uint16_t protocol, net_burst_handler_t handler)
+{
+    net_entry_t *entry = net_entry(protocol);
+    if (entry == NULL || entry->handler == NULL)
+    {
+        fprintf(stderr, "Error in net_add_protocol_burst:0x%04x\n", protocol);
+        return -1;
+    }
+    entry->burst = handler;
+    return 0;
+}
+
+/**
+ * @brief 内部函数，统计交给协议的一组数据包
+ * 
+ * @param entry 协议在分发表中的项
+ * @param bufs 数据包
+ * @param n 数据包数
+ */
+static void net_entry_count(net_entry_t *entry, buf_t **bufs, int n)
+{
+    entry->stats.packets += n;
+    for (int i = 0; i < n; i++)
+        entry->stats.bytes += bufs[i]->len;
+}
+
+/**
+ * @brief 内部函数，把一组数据包交给协议注册的处理程序
+ * 
+ * @param entry 协议在分发表中的项
+ * @param bufs 数据包
+ * @param srcs 各数据包的源地址
+ * @param n 数据包数
+ */
+static void net_entry_in(net_entry_t *entry, buf_t **bufs, uint8_t **srcs, int n)
+{
+    if (entry->burst)
+        entry->burst(bufs, srcs, n);
+    else
+        for (int i = 0; i < n; i++)
+            entry->handler(bufs[i], srcs[i]);
+}
+
+/**
+ * @brief 以太网层向上层协议传递一组同一类型的数据包
+ *        定义NET_STATIC_DISPATCH时，config.h中启用的协议直接调用处理程序，可被编译器内联
+ * 
+ * @param bufs 要传递的数据包
+ * @param srcs 各数据包的源mac地址
+ * @param n 数据包数
+ * @param protocol 以太网类型
+ * @return int 成功为0，协议未注册为-1
  */
-void net_add_protocol(uint16_t protocol, net_handler_t handler)
+int net_in_burst(buf_t **bufs, uint8_t **srcs, int n, uint16_t protocol)
 {
-    map_set(&net_table, &protocol, &handler);
+    net_entry_t *entry = &net_stack->ether_table[NET_ETHER_HASH(protocol)];
+    if (entry->handler == NULL || entry->protocol != protocol)
+        return -1;
+    net_entry_count(entry, bufs, n);
+#ifdef NET_STATIC_DISPATCH
+    switch (protocol)
+    {
+#ifdef ARP
+    case NET_PROTOCOL_ARP:
+        for (int i = 0; i < n; i++)
+            arp_in(bufs[i], srcs[i]);
+        return 0;
+#endif
+#ifdef IP
+    case NET_PROTOCOL_IP:
+        ip_in_burst(bufs, srcs, n);
+        return 0;
+#endif
+    }
+#endif
+    net_entry_in(entry, bufs, srcs, n);
+    return 0;
 }
 
 /**
- * @brief 向协议栈的上层协议传递数据包
+ * @brief 以太网层向上层协议传递数据包
  * 
  * @param buf 要传递的数据包
- * @param protocol 上层协议号
- * @param src 源的本层协议地址，如mac或ip地址
- * @return int 成功为0，失败为-1
+ * @param protocol 以太网类型
+ * @param src 源mac地址
+ * @return int 成功为0，协议未注册为-1
  */
 int net_in(buf_t *buf, uint16_t protocol, uint8_t *src)
 {
-    net_handler_t *handler = map_get(&net_table, &protocol);
-    if (handler)
+    return net_in_burst(&buf, &src, 1, protocol);
+}
+
+/**
+ * @brief ip层向上层协议传递一组同一协议的数据包
+ *        定义NET_STATIC_DISPATCH时，config.h中启用的协议直接调用处理程序，可被编译器内联
+ * 
+ * @param bufs 要传递的数据包
+ * @param srcs 各数据包的源ip地址
+ * @param n 数据包数
+ * @param protocol ip协议号
+ * @return int 成功为0，协议未注册为-1
+ */
+int net_ip_in_burst(buf_t **bufs, uint8_t **srcs, int n, uint8_t protocol)
+{
+    net_entry_t *entry = &net_stack->ip_table[protocol];
+    if (entry->handler == NULL)
+        return -1;
+    net_entry_count(entry, bufs, n);
+#ifdef NET_STATIC_DISPATCH
+    switch (protocol)
     {
-        (*handler)(buf, src);
+#ifdef ICMP
+    case NET_PROTOCOL_ICMP:
+        for (int i = 0; i < n; i++)
+            icmp_in(bufs[i], srcs[i]);
+        return 0;
+#endif
+#ifdef UDP
+    case NET_PROTOCOL_UDP:
+        udp_in_burst(bufs, srcs, n);
         return 0;
+#endif
+#ifdef TCP
+    case NET_PROTOCOL_TCP:
+        for (int i = 0; i < n; i++)
+            tcp_in(bufs[i], srcs[i]);
+        return 0;
+#endif
     }
+#endif
+    net_entry_in(entry, bufs, srcs, n);
+    return 0;
+}
+
+/**
+ * @brief ip层向上层协议传递数据包
+ * 
+ * @param buf 要传递的数据包
+ * @param protocol ip协议号
+ * @param src 源ip地址
+ * @return int 成功为0，协议未注册为-1
+ */
+int net_ip_in(buf_t *buf, uint8_t protocol, uint8_t *src)
+{
+    return net_ip_in_burst(&buf, &src, 1, protocol);
+}
+
+/**
+ * @brief 添加一个协议栈定时器，在net_poll中到期调用
+ * 
+ * @param delay_ms 距首次到期的毫秒数
+ * @param interval_ms 此后的周期（毫秒），0表示只调用一次
+ * @param handler 到期时调用的函数
+ * @param arg 传给handler的参数
+ * @return int 定时器编号，定时器表满为-1
+ */
+int net_timer_add(uint64_t delay_ms, uint64_t interval_ms, net_timer_handler_t handler, void *arg)
+{
+    for (int i = 0; i < NET_TIMER_MAX; i++)
+        if (net_stack->timers[i].deadline == 0)
+        {
+            net_stack->timers[i].deadline = net_now_ns() + delay_ms * 1000000 + 1; // 加1避免与空闲标记冲突
+            net_stack->timers[i].interval = interval_ms * 1000000;
+            net_stack->timers[i].handler = handler;
+            net_stack->timers[i].arg = arg;
+            return i;
+        }
+    fprintf(stderr, "Error in net_timer_add, too many timers.\n");
     return -1;
 }
 
 /**
- * @brief 一次协议栈轮询
+ * @brief 取消一个定时器，一次性定时器到期后编号即失效，不应再取消
+ * 
+ * @param id net_timer_add返回的编号
+ */
+void net_timer_cancel(int id)
+{
+    if (id >= 0 && id < NET_TIMER_MAX)
+        net_stack->timers[id].deadline = 0;
+}
+
+/**
+ * @brief 调用全部已到期的定时器，net_poll中已调用，不经net_poll收包的实例需自行调用
+ * 
+ * @return int 调用的定时器个数
+ */
+int net_timer_run()
+{
+    int work = 0;
+    uint64_t now = net_now_ns();
+    for (int i = 0; i < NET_TIMER_MAX; i++)
+    {
+        net_timer_t *timer = &net_stack->timers[i];
+        if (timer->deadline == 0 || timer->deadline > now)
+            continue;
+        if (timer->interval)
+            timer->deadline = (timer->deadline + timer->interval > now ? timer->deadline : now) + timer->interval;
+        else
+            timer->deadline = 0; // 先释放，handler中可以重新添加
+        timer->handler(timer->arg);
+        work++;
+    }
+    return work;
+}
+
+/**
+ * @brief 协议栈下一次需要轮询的时间，供事件循环决定休眠多久；
+ *        驱动的文件描述符可读时也需要轮询
+ * 
+ * @return uint64_t net_now_ns时基的纳秒数，已到期时不大于当前时间，没有定时器为NET_DEADLINE_NONE
+ */
+uint64_t net_next_deadline()
+{
+    if (net_stack->backlog)
+        return net_now_ns();
+    uint64_t deadline = NET_DEADLINE_NONE;
+    for (int i = 0; i < NET_TIMER_MAX; i++)
+        if (net_stack->timers[i].deadline && net_stack->timers[i].deadline < deadline)
+            deadline = net_stack->timers[i].deadline;
+    return deadline;
+}
+
+/**
+ * @brief 一次协议栈轮询，调用到期的定时器，并最多接收处理NET_BURST帧
  * 
+ * @return int 完成的工作量，即处理的帧数与调用的定时器个数之和，为0时调用者可以休眠
  */
-void net_poll()
+int net_poll()
 {
+    int batch = net_stack->tx_batch;
+    net_stack->tx_batch = 1; // 本轮发出的帧在返回前一起通知网卡
+    net_clock_update();
+    int work = net_timer_run();
 #ifdef ETHERNET
-    ethernet_poll();
+    int n = net_stack->rx_poll ? net_stack->rx_poll() : ethernet_poll();
+    net_stack->backlog = n == NET_BURST;
+    work += n;
 #endif
+    driver_flush();
+    net_stack->tx_batch = batch;
+    return work;
 }
\ No newline at end of file
@@ -0,0 +1,593 @@
+#include <pthread.h>
+#include <sched.h>
+#include "pipeline.h"
+#include "ring.h"
+#include "driver.h"
+#include "ethernet.h"
+
+typedef enum pipeline_msg_type //流水线消息的类型
+{
+    PIPELINE_FRAME,     // 收包线程交给协议线程的帧
+    PIPELINE_TCP_WRITE, // 应用线程要发送的数据
+    PIPELINE_TCP_CLOSE, // 应用线程关闭连接
+    PIPELINE_TCP_EVENT, // 协议线程交给应用线程的连接事件，收到的数据随事件交付
+    PIPELINE_RELEASE,   // 把buf交还分配它的线程释放
+} pipeline_msg_type_t;
+
+typedef struct pipeline_msg //在流水线各级之间传递的消息
+{
+    uint8_t type;         // pipeline_msg_type_t
+    uint8_t state;        // PIPELINE_TCP_EVENT的connect_state_t
+    pipeline_conn_t conn; // 连接
+    buf_t buf;            // 帧或数据，所有权随消息转移，最终由分配它的线程释放，无数据时block为NULL
+} pipeline_msg_t;
+
+typedef struct pipeline_queue //一个连接未完成的命令，按到达顺序执行
+{
+    pipeline_msg_t msgs[PIPELINE_PENDING_MAX + 1]; // 多出的一个位置留给关闭命令
+    int head, num;
+} pipeline_queue_t;
+
+typedef struct pipeline_port //应用监听的端口
+{
+    uint16_t port;
+    pipeline_tcp_handler_t handler;
+} pipeline_port_t;
+
+static ring_t pipeline_inbox;  // 协议线程的收件箱，收包线程与应用线程都写入
+static ring_t pipeline_events; // 协议线程交给应用线程的事件与交还的buf
+static ring_t pipeline_done;   // 协议线程处理完、交还收包线程释放的帧，元素为buf_t
+static pipeline_port_t pipeline_ports[PIPELINE_PORT_MAX];
+static int pipeline_port_num;
+static net_stack_t *pipeline_owner;                // 收包线程的协议栈实例，协议线程与它共用网卡
+static net_stack_t *pipeline_stack;                // 协议线程的协议栈实例
+static buf_pool_t pipeline_app_pools[BUF_POOL_NUM]; // 应用线程的缓冲池，pipeline_tcp_write从中分配
+static pipeline_setup_t pipeline_setup;
+static pthread_t pipeline_proto_thread, pipeline_app_thread;
+static int pipeline_running;
+static int pipeline_alive;   // 尚未退出的线程数
+static int pipeline_threads; // 已创建的线程数，先创建协议线程
+
+// 以下只由协议线程访问
+static map_t pipeline_pending; // 有未完成命令的连接<pipeline_conn_t,pipeline_queue_t>，各连接互不阻塞
+static pipeline_msg_t *pipeline_outbox; // 事件队列满时暂存发往应用线程的消息，不阻塞协议线程
+static size_t pipeline_outbox_num, pipeline_outbox_cap;
+static int pipeline_starved; // 有连接的数据因事件队列满而留在接收缓存中
+
+// 以下只由应用线程访问
+static map_t pipeline_inflight; // 已发出、协议线程尚未完成的命令数<pipeline_conn_t,int>
+_Static_assert(sizeof(pipeline_conn_t) == sizeof(uint64_t), "pipeline maps use map64 lookups");
+
+/**
+ * @brief 内部函数，空闲时的退避，先自旋PIPELINE_IDLE_SPINS轮，之后每轮让出CPU
+ *
+ * @param idle 连续空闲的轮数
+ */
+static void pipeline_idle(int idle)
+{
+    if (idle < PIPELINE_IDLE_SPINS)
+        cpu_relax();
+    else
+        sched_yield();
+}
+
+/**
+ * @brief 内部函数，查找端口的应用处理程序
+ *
+ * @param port 本地端口
+ * @return pipeline_tcp_handler_t 处理程序，未监听为NULL
+ */
+static pipeline_tcp_handler_t pipeline_handler(uint16_t port)
+{
+    for (int i = 0; i < pipeline_port_num; i++)
+        if (pipeline_ports[i].port == port)
+            return pipeline_ports[i].handler;
+    return NULL;
+}
+
+/**
+ * @brief 内部函数，协议线程向应用线程发送消息，队列满时暂存，之后按顺序补发
+ *
+ * @param msg 消息
+ */
+static void pipeline_post(const pipeline_msg_t *msg)
+{
+    if (pipeline_outbox_num == 0 && ring_push_burst(&pipeline_events, msg, 1))
+        return;
+    if (pipeline_outbox_num == pipeline_outbox_cap)
+    {
+        size_t cap = pipeline_outbox_cap ? 2 * pipeline_outbox_cap : PIPELINE_PENDING_MAX;
+        pipeline_msg_t *outbox = realloc(pipeline_outbox, cap * sizeof(pipeline_msg_t));
+        if (outbox == NULL)
+        {
+            fprintf(stderr, "Error in pipeline_post, out of memory.\n");
+            return;
+        }
+        pipeline_outbox = outbox;
+        pipeline_outbox_cap = cap;
+    }
+    pipeline_outbox[pipeline_outbox_num++] = *msg;
+}
+
+/**
+ * @brief 内部函数，补发暂存的消息
+ *
+ * @return int 补发的消息数
+ */
+static int pipeline_flush()
+{
+    if (pipeline_outbox_num == 0)
+        return 0;
+    size_t n = ring_push_burst(&pipeline_events, pipeline_outbox, pipeline_outbox_num);
+    pipeline_outbox_num -= n;
+    memmove(pipeline_outbox, pipeline_outbox + n, pipeline_outbox_num * sizeof(pipeline_msg_t));
+    return n;
+}
+
+/**
+ * @brief 内部函数，协议线程中的tcp处理程序，把连接事件与收到的数据转交应用线程
+ *        事件队列满时数据留在连接的接收缓存中，由tcp窗口向对端施加背压，队列有空间后再交付
+ *
+ * @param connect 连接
+ * @param state 事件
+ */
+static void pipeline_tcp_proto_handler(tcp_connect_t *connect, connect_state_t state)
+{
+    pipeline_msg_t msg = {.type = PIPELINE_TCP_EVENT, .state = state};
+    memcpy(msg.conn.ip, connect->ip, NET_IP_LEN);
+    msg.conn.remote_port = connect->remote_port;
+    msg.conn.local_port = connect->local_port;
+    if (state == TCP_CONN_DATA_RECV)
+    {
+        size_t len = connect->rx_buf.len;
+        if (len == 0)
+            return;
+        if (pipeline_outbox_num || ring_space(&pipeline_events) == 0 || buf_alloc(&msg.buf, len) == -1)
+        {
+            pipeline_starved = 1;
+            return;
+        }
+        tcp_connect_read(connect, msg.buf.data, len);
+    }
+    pipeline_post(&msg);
+}
+
+/**
+ * @brief 内部函数，map_foreach的回调，交付留在接收缓存中的数据
+ *
+ */
+static void pipeline_feed(void *key, void *value, time_t *timestamp)
+{
+    tcp_connect_t *connect = value;
+    if (connect->state != TCP_LISTEN && connect->rx_buf.len && pipeline_handler(connect->local_port))
+        pipeline_tcp_proto_handler(connect, TCP_CONN_DATA_RECV);
+}
+
+/**
+ * @brief 内部函数，协议线程执行一条应用命令
+ *
+ * @param msg 命令，写入部分完成时data前移
+ * @return int 完成为1，发送缓存或窗口已满、需稍后重试为0
+ */
+static int pipeline_execute(pipeline_msg_t *msg)
+{
+    tcp_connect_t *connect = tcp_connect_find(msg->conn.ip, msg->conn.remote_port, msg->conn.local_port);
+    if (connect && msg->type == PIPELINE_TCP_WRITE)
+    {
+        size_t n = 1;
+        while (msg->buf.len && (n = tcp_connect_write(connect, msg->buf.data, min32(msg->buf.len, PIPELINE_WRITE_CHUNK))))
+            buf_remove_header(&msg->buf, n);
+        tcp_connect_flush(connect); // 不在处理程序中写入，没有随后的确认把数据带出去
+        if (n == 0)
+            return 0;
+    }
+    if (connect && msg->type == PIPELINE_TCP_CLOSE)
+        tcp_connect_close(connect);
+    // 完成的命令都交还应用线程，数据的buf由它释放，并减少该连接在途的命令数
+    pipeline_msg_t release = {.type = PIPELINE_RELEASE, .conn = msg->conn, .buf = msg->buf};
+    pipeline_post(&release);
+    return 1;
+}
+
+/**
+ * @brief 内部函数，pipeline_pending的值析构函数，释放连接剩余命令的buf
+ *
+ * @param value pipeline_queue_t指针
+ */
+static void pipeline_queue_release(void *value)
+{
+    pipeline_queue_t *queue = value;
+    for (; queue->num; queue->num--, queue->head = (queue->head + 1) % (PIPELINE_PENDING_MAX + 1))
+        buf_free(&queue->msgs[queue->head].buf);
+}
+
+static _Thread_local int pipeline_retried; // pipeline_retry_fn完成的命令数
+
+/**
+ * @brief 内部函数，map_foreach的回调，按顺序重试一个连接未完成的命令，全部完成后删除该连接
+ *
+ */
+static void pipeline_retry_fn(void *key, void *value, time_t *timestamp)
+{
+    pipeline_queue_t *queue = value;
+    while (queue->num && pipeline_execute(&queue->msgs[queue->head]))
+    {
+        queue->head = (queue->head + 1) % (PIPELINE_PENDING_MAX + 1);
+        queue->num--;
+        pipeline_retried++;
+    }
+    if (queue->num == 0)
+        map_delete(&pipeline_pending, key);
+}
+
+/**
+ * @brief 内部函数，重试各连接未完成的命令，一个连接的发送缓存满不影响其他连接
+ *
+ * @return int 完成的命令数
+ */
+static int pipeline_retry()
+{
+    if (map_size(&pipeline_pending) == 0)
+        return 0;
+    pipeline_retried = 0;
+    map_foreach(&pipeline_pending, pipeline_retry_fn);
+    return pipeline_retried;
+}
+
+/**
+ * @brief 内部函数，协议线程接收一条应用命令，该连接有未完成的命令时排在其后，保持同一连接上的顺序
+ *        应用线程限制了每个连接在途的命令数，队列不会溢出
+ *
+ * @param msg 命令
+ */
+static void pipeline_command(pipeline_msg_t *msg)
+{
+    static const pipeline_queue_t empty;
+    if (msg->type == PIPELINE_RELEASE)
+    {
+        buf_free(&msg->buf);
+        return;
+    }
+    pipeline_queue_t *queue = map64_get(&pipeline_pending, map64_key(&msg->conn));
+    if (queue == NULL && pipeline_execute(msg))
+        return;
+    if (queue == NULL && (map_set(&pipeline_pending, &msg->conn, &empty) != 0 ||
+                          (queue = map64_get(&pipeline_pending, map64_key(&msg->conn))) == NULL))
+    {
+        fprintf(stderr, "Error in pipeline_command, too many connections with pending commands.\n");
+        pipeline_msg_t release = {.type = PIPELINE_RELEASE, .conn = msg->conn, .buf = msg->buf};
+        pipeline_post(&release);
+        return;
+    }
+    queue->msgs[(queue->head + queue->num++) % (PIPELINE_PENDING_MAX + 1)] = *msg;
+}
+
+/**
+ * @brief 内部函数，协议线程的主循环：处理收件箱中的帧与命令，运行定时器，补发暂存的消息
+ *
+ * @param arg 未使用
+ * @return void* 总是NULL
+ */
+static void *pipeline_proto_main(void *arg)
+{
+    net_stack_enter(pipeline_stack);
+    net_init_shared(pipeline_owner);
+    net_stack->tx_batch = 1; // 每轮结束时driver_flush
+    for (int i = 0; i < pipeline_port_num; i++)
+        tcp_open(pipeline_ports[i].port, pipeline_tcp_proto_handler);
+    if (pipeline_setup)
+        pipeline_setup();
+    pipeline_msg_t msgs[NET_BURST];
+    buf_t *frames[NET_BURST];
+    buf_t done[NET_BURST];
+    int idle = 0;
+    while (__atomic_load_n(&pipeline_running, __ATOMIC_ACQUIRE))
+    {
+        net_clock_update();
+        int work = net_timer_run() + pipeline_flush() + pipeline_retry();
+        if (pipeline_starved && pipeline_outbox_num == 0)
+        {
+            pipeline_starved = 0;
+            map_foreach(&net_stack->connect_table, pipeline_feed);
+        }
+        size_t n = ring_pop_burst(&pipeline_inbox, msgs, NET_BURST);
+        for (size_t i = 0; i < n;)
+        {
+            if (msgs[i].type != PIPELINE_FRAME)
+            {
+                pipeline_command(&msgs[i++]);
+                continue;
+            }
+            int k = 0; // 连续的帧一起交给以太网层
+            for (; i < n && msgs[i].type == PIPELINE_FRAME; i++, k++)
+            {
+                done[k] = msgs[i].buf;
+                frames[k] = &done[k];
+            }
+            ethernet_in_burst(frames, k);
+            for (int pushed = 0; (pushed += ring_push_burst(&pipeline_done, done + pushed, k - pushed)) < k;)
+                cpu_relax(); // 交还队列的容量不小于在途的帧数，不会长时间等待
+        }
+        work += n;
+        driver_flush();
+        idle = work ? 0 : idle + 1;
+        if (!work)
+            pipeline_idle(idle);
+    }
+    __atomic_sub_fetch(&pipeline_alive, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/**
+ * @brief 内部函数，应用线程向协议线程发送消息，收件箱满时等待，协议线程从不等待应用线程，不会死锁
+ *
+ * @param msg 消息
+ * @return int 成功为0，流水线正在停止为-1，此时应用线程自己分配的buf就地释放
+ */
+static int pipeline_send(pipeline_msg_t *msg)
+{
+    while (ring_mp_push_burst(&pipeline_inbox, msg, 1) == 0)
+    {
+        if (!__atomic_load_n(&pipeline_running, __ATOMIC_ACQUIRE))
+        {
+            if (msg->type == PIPELINE_TCP_WRITE)
+                buf_free(&msg->buf);
+            return -1;
+        }
+        cpu_relax();
+    }
+    return 0;
+}
+
+/**
+ * @brief 内部函数，在应用线程中调整连接已发出、协议线程尚未完成的命令数
+ *
+ * @param conn 连接
+ * @param delta 增量
+ * @param limit 调整后的上限
+ * @return int 成功为0，超过上限为PIPELINE_AGAIN，内存不足为-1
+ */
+static int pipeline_inflight_add(const pipeline_conn_t *conn, int delta, int limit)
+{
+    int *count = map64_get(&pipeline_inflight, map64_key(conn));
+    int n = (count ? *count : 0) + delta;
+    if (n > limit)
+        return PIPELINE_AGAIN;
+    if (n <= 0)
+        map_delete(&pipeline_inflight, conn);
+    else if (count)
+        *count = n;
+    else
+        return map_set(&pipeline_inflight, conn, &n);
+    return 0;
+}
+
+/**
+ * @brief 内部函数，应用线程的主循环：调用应用的处理程序，交还事件中的数据
+ *
+ * @param arg 未使用
+ * @return void* 总是NULL
+ */
+static void *pipeline_app_main(void *arg)
+{
+    buf_pool_use(pipeline_app_pools);
+    pipeline_msg_t msgs[NET_BURST];
+    int idle = 0;
+    while (__atomic_load_n(&pipeline_running, __ATOMIC_ACQUIRE))
+    {
+        size_t n = ring_pop_burst(&pipeline_events, msgs, NET_BURST);
+        for (size_t i = 0; i < n; i++)
+        {
+            pipeline_msg_t *msg = &msgs[i];
+            if (msg->type == PIPELINE_RELEASE)
+            {
+                buf_free(&msg->buf);
+                pipeline_inflight_add(&msg->conn, -1, PIPELINE_PENDING_MAX + 1);
+                continue;
+            }
+            pipeline_tcp_handler_t handler = pipeline_handler(msg->conn.local_port);
+            if (handler)
+                handler(&msg->conn, msg->state, msg->buf.data, msg->buf.len);
+            if (msg->buf.block)
+            {
+                pipeline_msg_t release = {.type = PIPELINE_RELEASE, .buf = msg->buf};
+                pipeline_send(&release);
+            }
+        }
+        idle = n ? 0 : idle + 1;
+        if (!n)
+            pipeline_idle(idle);
+    }
+    __atomic_sub_fetch(&pipeline_alive, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/**
+ * @brief 收包线程的一次轮询，pipeline_start后代替ethernet_poll在net_poll中调用
+ *        收件箱满时丢弃收到的帧
+ *
+ * @return int 收到的帧数
+ */
+static int pipeline_io_poll()
+{
+    buf_t bufs[NET_BURST];
+    pipeline_msg_t msgs[NET_BURST];
+    size_t n;
+    while ((n = ring_pop_burst(&pipeline_done, bufs, NET_BURST)) > 0)
+        for (size_t i = 0; i < n; i++)
+            buf_free(&bufs[i]);
+    int m = driver_recv_burst_pooled(bufs, NET_BURST); // 帧交给协议线程，不能引用网卡内存
+    if (m <= 0)
+        return 0;
+    for (int i = 0; i < m; i++)
+    {
+        msgs[i].type = PIPELINE_FRAME;
+        msgs[i].buf = bufs[i];
+    }
+    for (int i = ring_mp_push_burst(&pipeline_inbox, msgs, m); i < m; i++)
+        buf_free(&bufs[i]);
+    return m;
+}
+
+/**
+ * @brief 在流水线模式下监听一个tcp端口，处理程序在应用线程中调用，需在pipeline_start之前调用
+ *
+ * @param port 端口
+ * @param handler 处理程序，收到的数据在返回后失效
+ * @return int 成功为0，端口数超过PIPELINE_PORT_MAX为-1
+ */
+int pipeline_tcp_open(uint16_t port, pipeline_tcp_handler_t handler)
+{
+    if (pipeline_port_num == PIPELINE_PORT_MAX)
+    {
+        fprintf(stderr, "Error in pipeline_tcp_open:%u\n", port);
+        return -1;
+    }
+    pipeline_ports[pipeline_port_num].port = port;
+    pipeline_ports[pipeline_port_num++].handler = handler;
+    return 0;
+}
+
+/**
+ * @brief 在应用线程中向连接发送数据，数据被拷贝，发送缓存满时由协议线程稍后继续写入
+ *        每个连接在途的命令不超过PIPELINE_PENDING_MAX个，超过时不排队而返回PIPELINE_AGAIN，由应用稍后重试
+ *
+ * @param conn 连接
+ * @param data 数据
+ * @param len 长度
+ * @return int 成功为0，该连接在途的命令已达上限为PIPELINE_AGAIN，缓冲池耗尽或流水线正在停止为-1
+ */
+int pipeline_tcp_write(const pipeline_conn_t *conn, const uint8_t *data, size_t len)
+{
+    pipeline_msg_t msg = {.type = PIPELINE_TCP_WRITE, .conn = *conn};
+    int ret = pipeline_inflight_add(conn, 1, PIPELINE_PENDING_MAX);
+    if (ret != 0)
+        return ret;
+    if (buf_alloc(&msg.buf, len) == -1)
+    {
+        pipeline_inflight_add(conn, -1, PIPELINE_PENDING_MAX);
+        return -1;
+    }
+    memcpy(msg.buf.data, data, len);
+    return pipeline_send(&msg);
+}
+
+/**
+ * @brief 在应用线程中关闭连接，在此之前写入的数据先发送，写入已达上限时仍可关闭
+ *
+ * @param conn 连接
+ * @return int 成功为0，已有在途的关闭命令且写入已达上限为PIPELINE_AGAIN，流水线正在停止为-1
+ */
+int pipeline_tcp_close(const pipeline_conn_t *conn)
+{
+    pipeline_msg_t msg = {.type = PIPELINE_TCP_CLOSE, .conn = *conn};
+    int ret = pipeline_inflight_add(conn, 1, PIPELINE_PENDING_MAX + 1); // 写入达到上限时仍可关闭
+    if (ret != 0)
+        return ret;
+    return pipeline_send(&msg);
+}
+
+/**
+ * @brief 启动协议线程与应用线程，此后当前线程的net_poll只收包，交给协议线程处理，
+ *        tcp事件再交给应用线程，应用处理得慢不会阻塞收包与协议处理
+ *        需在当前线程net_init之后调用，不能与rss_start同时使用
+ *
+ * @param setup 协议线程启动后在该线程中调用，用于注册udp等在协议线程中处理的协议，可为NULL
+ * @return int 成功为0，失败为-1
+ */
+int pipeline_start(pipeline_setup_t setup)
+{
+    if (pipeline_stack || net_stack->rx_poll)
+    {
+        fprintf(stderr, "Error in pipeline_start, already started.\n");
+        return -1;
+    }
+    if (ring_init(&pipeline_inbox, PIPELINE_RING_SIZE, sizeof(pipeline_msg_t)) == -1 ||
+        ring_init(&pipeline_events, PIPELINE_RING_SIZE, sizeof(pipeline_msg_t)) == -1 ||
+        ring_init(&pipeline_done, 2 * PIPELINE_RING_SIZE, sizeof(buf_t)) == -1 ||
+        buf_pool_create(pipeline_app_pools) == -1 ||
+        (pipeline_stack = net_stack_create(net_stack->if_mac, net_stack->if_ip)) == NULL)
+    {
+        fprintf(stderr, "Error in pipeline_start.\n");
+        pipeline_stop();
+        return -1;
+    }
+    map_init(&pipeline_pending, sizeof(pipeline_conn_t), sizeof(pipeline_queue_t), 0, 0, NULL, pipeline_queue_release);
+    map_init(&pipeline_inflight, sizeof(pipeline_conn_t), sizeof(int), 0, 0, NULL, NULL);
+    pipeline_owner = net_stack;
+    pipeline_setup = setup;
+    pipeline_running = 1;
+    pipeline_alive = 2;
+    if (pthread_create(&pipeline_proto_thread, NULL, pipeline_proto_main, NULL) == 0)
+        pipeline_threads++;
+    if (pipeline_threads == 1 && pthread_create(&pipeline_app_thread, NULL, pipeline_app_main, NULL) == 0)
+        pipeline_threads++;
+    if (pipeline_threads < 2)
+    {
+        fprintf(stderr, "Error in pipeline_start, pthread_create failed.\n");
+        __atomic_sub_fetch(&pipeline_alive, 2 - pipeline_threads, __ATOMIC_RELEASE);
+        pipeline_stop();
+        return -1;
+    }
+    net_stack->rx_poll = pipeline_io_poll;
+    return 0;
+}
+
+/**
+ * @brief 内部函数，释放一个队列中剩余消息的buf，只在各线程退出后调用
+ *
+ * @param ring 队列
+ */
+static void pipeline_drain(ring_t *ring)
+{
+    pipeline_msg_t msg;
+    if (ring->slots == NULL)
+        return;
+    while (ring_pop_burst(ring, &msg, 1))
+        buf_free(&msg.buf);
+    ring_free(ring);
+}
+
+/**
+ * @brief 停止协议线程与应用线程并释放其资源，当前线程恢复自行处理收到的帧，只能由调用pipeline_start的线程调用
+ *
+ */
+void pipeline_stop()
+{
+    __atomic_store_n(&pipeline_running, 0, __ATOMIC_RELEASE);
+    buf_t buf;
+    while (__atomic_load_n(&pipeline_alive, __ATOMIC_ACQUIRE))
+        sched_yield();
+    if (pipeline_threads > 0)
+        pthread_join(pipeline_proto_thread, NULL);
+    if (pipeline_threads > 1)
+        pthread_join(pipeline_app_thread, NULL);
+    pipeline_threads = 0;
+    if (pipeline_owner)
+        pipeline_owner->rx_poll = NULL;
+    // 线程都已退出，剩余的buf可以在这里归还各自的缓冲池
+    pipeline_drain(&pipeline_inbox);
+    pipeline_drain(&pipeline_events);
+    if (pipeline_done.slots)
+    {
+        while (ring_pop_burst(&pipeline_done, &buf, 1))
+            buf_free(&buf);
+        ring_free(&pipeline_done);
+    }
+    map_free(&pipeline_pending);
+    map_free(&pipeline_inflight);
+    for (size_t i = 0; i < pipeline_outbox_num; i++)
+        buf_free(&pipeline_outbox[i].buf);
+    free(pipeline_outbox);
+    pipeline_outbox = NULL;
+    pipeline_outbox_num = pipeline_outbox_cap = 0;
+    if (pipeline_stack)
+    {
+        pipeline_stack->driver = NULL; // 网卡由收包线程关闭
+        net_stack_destroy(pipeline_stack);
+        pipeline_stack = NULL;
+    }
+    if (pipeline_app_pools[BUF_POOL_MTU].arena)
+        buf_pool_destroy(pipeline_app_pools);
+    pipeline_owner = NULL;
+}
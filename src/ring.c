@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "ring.h"
+
+/**
+ * @brief 初始化环形队列
+ *
+ * @param ring 要初始化的队列
+ * @param count 槽数，须为2的幂
+ * @param elem_size 元素长度
+ * @return int 成功为0，槽数不合法或内存不足为-1
+ */
+int ring_init(ring_t *ring, size_t count, size_t elem_size)
+{
+    memset(ring, 0, sizeof(ring_t));
+    if (count == 0 || (count & (count - 1)) || elem_size == 0)
+    {
+        fprintf(stderr, "Error in ring_init:%zu\n", count);
+        return -1;
+    }
+    size_t len = (count * elem_size + 63) & ~(size_t)63;
+    if ((ring->slots = aligned_alloc(64, len)) == NULL)
+    {
+        fprintf(stderr, "Error in ring_init, out of memory.\n");
+        return -1;
+    }
+    ring->mask = count - 1;
+    ring->elem_size = elem_size;
+    return 0;
+}
+
+/**
+ * @brief 释放环形队列的槽，队列中剩余的元素被丢弃
+ *
+ * @param ring 队列
+ */
+void ring_free(ring_t *ring)
+{
+    free(ring->slots);
+    memset(ring, 0, sizeof(ring_t));
+}
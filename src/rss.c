@@ -0,0 +1,371 @@
+#include <pthread.h>
+#include <sched.h>
+#include "rss.h"
+#include "ring.h"
+#include "driver.h"
+#include "ethernet.h"
+#include "ip.h"
+
+#define RSS_TUPLE_LEN 12 //源ip、目的ip、源端口、目的端口
+
+typedef struct rss_worker //工作线程，运行一个独立的协议栈实例
+{
+    ring_t rx;                                      // 收包线程交给工作线程的帧，元素为buf_t
+    ring_t done;                                    // 工作线程处理完、交还收包线程释放的帧
+    net_stack_t *stack;                             // 工作线程运行的协议栈实例
+    pthread_t thread;                               // 线程
+    int id;                                         // 编号
+    uint64_t drops __attribute__((aligned(64)));    // 因队列满而丢弃的帧数，只由收包线程修改
+    uint64_t packets __attribute__((aligned(64)));  // 处理的帧数，只由工作线程修改
+} __attribute__((aligned(64))) rss_worker_t;
+
+/**
+ * @brief Toeplitz哈希的密钥，与常见网卡的默认密钥相同，软硬件分流的结果一致
+ *
+ */
+static const uint8_t rss_key[40] = {
+    0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67,
+    0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0, 0xd0, 0xca, 0x2b, 0xcb,
+    0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30,
+    0xf2, 0x0c, 0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa,
+};
+
+static uint32_t rss_table[RSS_TUPLE_LEN][256]; // 输入第i字节取值为v时对哈希值的贡献
+static uint8_t rss_reta[RSS_RETA_SIZE];        // 重定向表，哈希值的低位到工作线程
+static rss_worker_t *rss_workers;
+static int rss_worker_num;
+static int rss_running;              // 工作线程是否应继续运行
+static int rss_alive;                // 尚未退出的工作线程数
+static net_stack_t *rss_owner;       // 收包线程的协议栈实例，工作线程与它共用网卡
+static rss_setup_t rss_setup;        // 工作线程启动后调用，用于注册各自的处理程序
+
+/**
+ * @brief 内部函数，密钥中从第bit位开始的32位
+ *
+ * @param bit 起始位
+ * @return uint32_t 32位窗口
+ */
+static uint32_t rss_key_window(int bit)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++)
+        v = v << 8 | rss_key[bit / 8 + i];
+    return (uint32_t)(v >> (32 - bit % 8));
+}
+
+/**
+ * @brief 内部函数，预计算逐字节查表的Toeplitz哈希，输入的每一位贡献密钥中对应位置开始的32位
+ *
+ */
+static void rss_table_init()
+{
+    for (int i = 0; i < RSS_TUPLE_LEN; i++)
+        for (int v = 0; v < 256; v++)
+        {
+            uint32_t h = 0;
+            for (int b = 0; b < 8; b++)
+                if (v & (0x80 >> b))
+                    h ^= rss_key_window(i * 8 + b);
+            rss_table[i][v] = h;
+        }
+}
+
+/**
+ * @brief 计算Toeplitz哈希
+ *
+ * @param tuple 网络字节序的输入，依次为源ip、目的ip，以及可选的源端口、目的端口
+ * @param len 输入长度，不超过RSS_TUPLE_LEN
+ * @return uint32_t 哈希值
+ */
+uint32_t rss_hash(const uint8_t *tuple, size_t len)
+{
+    uint32_t h = 0;
+    for (size_t i = 0; i < len; i++)
+        h ^= rss_table[i][tuple[i]];
+    return h;
+}
+
+/**
+ * @brief 选择处理一帧的工作线程：
+ *        tcp/udp按4元组哈希，分片与其他ip协议按ip对哈希，同一条流总是交给同一个工作线程；
+ *        ARP交给每个工作线程，使各自的arp表都能学习，只有0号工作线程应答；其他以太网类型交给0号工作线程
+ *
+ * @param buf 以太网帧
+ * @return int 工作线程编号，或RSS_ALL
+ */
+int rss_worker_of(const buf_t *buf)
+{
+    if (buf->len < sizeof(ether_hdr_t))
+        return 0;
+    ether_hdr_t *eth = (ether_hdr_t *)buf->data;
+    uint16_t type = swap16(eth->protocol16);
+    if (type == NET_PROTOCOL_ARP)
+        return RSS_ALL;
+    if (type != NET_PROTOCOL_IP || buf->len < sizeof(ether_hdr_t) + sizeof(ip_hdr_t))
+        return 0;
+    ip_hdr_t *ip = (ip_hdr_t *)(eth + 1);
+    size_t hdr_len = ip->hdr_len * IP_HDR_LEN_PER_BYTE;
+    uint8_t tuple[RSS_TUPLE_LEN];
+    size_t len = 2 * NET_IP_LEN;
+    memcpy(tuple, ip->src_ip, 2 * NET_IP_LEN);
+    if ((ip->protocol == NET_PROTOCOL_TCP || ip->protocol == NET_PROTOCOL_UDP) &&
+        (swap16(ip->flags_fragment16) & (IP_MORE_FRAGMENT | 0x1fff)) == 0 &&
+        buf->len >= sizeof(ether_hdr_t) + hdr_len + 4)
+    {
+        memcpy(tuple + len, (uint8_t *)ip + hdr_len, 4); // tcp与udp头部都以源端口、目的端口开始
+        len += 4;
+    }
+    return rss_reta[rss_hash(tuple, len) & (RSS_RETA_SIZE - 1)];
+}
+
+/**
+ * @brief 内部函数，把一组帧交给一个工作线程，队列满时丢弃放不下的帧
+ *
+ * @param worker 工作线程
+ * @param bufs 帧
+ * @param n 帧数
+ */
+static void rss_push(rss_worker_t *worker, buf_t *bufs, int n)
+{
+    int pushed = ring_push_burst(&worker->rx, bufs, n);
+    for (int i = pushed; i < n; i++)
+        buf_free(&bufs[i]);
+    worker->drops += n - pushed;
+}
+
+/**
+ * @brief 内部函数，把一帧的副本交给每个工作线程，原帧交给0号工作线程
+ *
+ * @param buf 帧
+ */
+static void rss_broadcast(buf_t *buf)
+{
+    for (int w = 1; w < rss_worker_num; w++)
+    {
+        buf_t copy;
+        if (buf_alloc(&copy, buf->len) == -1)
+        {
+            rss_workers[w].drops++;
+            continue;
+        }
+        memcpy(copy.data, buf->data, buf->len);
+        rss_push(&rss_workers[w], &copy, 1);
+    }
+    rss_push(&rss_workers[0], buf, 1);
+}
+
+/**
+ * @brief 由收包线程把一组帧分给工作线程，每个工作线程按原顺序收到属于它的帧
+ *        帧须从收包线程的缓冲池分配，其所有权转交给本函数，由rss_reclaim在处理后释放
+ *
+ * @param bufs 帧
+ * @param n 帧数
+ * @return int 分发的帧数，包括因队列满丢弃的帧
+ */
+int rss_steer(buf_t *bufs, int n)
+{
+    int ids[NET_BURST];
+    buf_t batch[NET_BURST];
+    for (int base = 0; base < n; base += NET_BURST)
+    {
+        int m = n - base < NET_BURST ? n - base : NET_BURST;
+        buf_t *group = bufs + base;
+        for (int i = 0; i < m; i++)
+            ids[i] = rss_worker_of(&group[i]);
+        for (int i = 0; i < m; i++)
+        {
+            int id = ids[i];
+            if (id == RSS_ALL)
+                rss_broadcast(&group[i]);
+            if (id < 0)
+                continue;
+            int k = 0; // 一次收集同一工作线程的全部帧，减少对队列下标的写入
+            for (int j = i; j < m; j++)
+                if (ids[j] == id)
+                {
+                    batch[k++] = group[j];
+                    ids[j] = -2;
+                }
+            rss_push(&rss_workers[id], batch, k);
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief 由收包线程释放工作线程处理完的帧
+ *
+ */
+void rss_reclaim()
+{
+    buf_t bufs[NET_BURST];
+    for (int w = 0; w < rss_worker_num; w++)
+    {
+        size_t n;
+        while ((n = ring_pop_burst(&rss_workers[w].done, bufs, NET_BURST)) > 0)
+            for (size_t i = 0; i < n; i++)
+                buf_free(&bufs[i]);
+    }
+}
+
+/**
+ * @brief 收包线程的一次轮询，rss_start后代替ethernet_poll在net_poll中调用
+ *
+ * @return int 收到的帧数
+ */
+int rss_poll()
+{
+    buf_t bufs[NET_BURST];
+    rss_reclaim();
+    int n = driver_recv_burst_pooled(bufs, NET_BURST); // 帧交给工作线程，不能引用网卡内存
+    if (n <= 0)
+        return 0;
+    return rss_steer(bufs, n);
+}
+
+/**
+ * @brief 内部函数，工作线程的主循环：取出分给自己的帧交给自己的协议栈实例，处理完交还收包线程
+ *        队列空时先自旋RSS_IDLE_SPINS轮，之后每轮让出CPU
+ *
+ * @param arg 工作线程
+ * @return void* 总是NULL
+ */
+static void *rss_worker_main(void *arg)
+{
+    rss_worker_t *worker = arg;
+    net_stack_enter(worker->stack);
+    net_init_shared(rss_owner);
+    net_stack->tx_batch = 1; // 每轮开始时driver_flush
+    if (rss_setup)
+        rss_setup(worker->id);
+    buf_t bufs[NET_BURST];
+    buf_t *vec[NET_BURST];
+    int idle = 0;
+    while (__atomic_load_n(&rss_running, __ATOMIC_ACQUIRE))
+    {
+        net_clock_update();
+        net_timer_run();
+        driver_flush(); // 上一轮处理与定时器发送的帧
+        size_t n = ring_pop_burst(&worker->rx, bufs, NET_BURST);
+        if (n == 0)
+        {
+            if (++idle < RSS_IDLE_SPINS)
+                cpu_relax();
+            else
+                sched_yield();
+            continue;
+        }
+        idle = 0;
+        for (size_t i = 0; i < n; i++)
+            vec[i] = &bufs[i];
+        ethernet_in_burst(vec, n);
+        __atomic_store_n(&worker->packets, worker->packets + n, __ATOMIC_RELAXED);
+        for (size_t done = 0; (done += ring_push_burst(&worker->done, bufs + done, n - done)) < n;)
+            cpu_relax(); // 等收包线程回收
+    }
+    worker->stack->driver = NULL; // 网卡由收包线程关闭
+    net_stack_destroy(worker->stack);
+    __atomic_sub_fetch(&rss_alive, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/**
+ * @brief 启动工作线程，此后当前线程的net_poll只收包并按流分发，协议处理在工作线程中进行
+ *        每个工作线程运行一个独立的协议栈实例，有各自的连接表、arp表与缓冲池，与当前实例共用网卡发送
+ *        需在当前线程net_init之后调用
+ *
+ * @param workers 工作线程数，1到RSS_WORKER_MAX
+ * @param setup 每个工作线程启动后在该线程中调用，参数为工作线程编号，可为NULL
+ * @return int 成功为0，失败为-1
+ */
+int rss_start(int workers, rss_setup_t setup)
+{
+    if (rss_workers || workers < 1 || workers > RSS_WORKER_MAX)
+    {
+        fprintf(stderr, "Error in rss_start:%d\n", workers);
+        return -1;
+    }
+    rss_table_init();
+    for (int i = 0; i < RSS_RETA_SIZE; i++)
+        rss_reta[i] = i % workers;
+    if ((rss_workers = aligned_alloc(64, workers * sizeof(rss_worker_t))) == NULL)
+    {
+        fprintf(stderr, "Error in rss_start, out of memory.\n");
+        return -1;
+    }
+    memset(rss_workers, 0, workers * sizeof(rss_worker_t));
+    rss_owner = net_stack;
+    rss_setup = setup;
+    rss_running = 1;
+    for (rss_worker_num = 0; rss_worker_num < workers; rss_worker_num++)
+    {
+        rss_worker_t *worker = &rss_workers[rss_worker_num];
+        worker->id = rss_worker_num;
+        if (ring_init(&worker->rx, RSS_RING_SIZE, sizeof(buf_t)) == -1 ||
+            ring_init(&worker->done, 2 * RSS_RING_SIZE, sizeof(buf_t)) == -1 ||
+            (worker->stack = net_stack_create(net_stack->if_mac, net_stack->if_ip)) == NULL)
+            break;
+        worker->stack->arp_learn_only = rss_worker_num != 0; // 否则每个工作线程都应答同一个arp请求
+        __atomic_add_fetch(&rss_alive, 1, __ATOMIC_RELAXED);
+        if (pthread_create(&worker->thread, NULL, rss_worker_main, worker) != 0)
+        {
+            __atomic_sub_fetch(&rss_alive, 1, __ATOMIC_RELAXED);
+            net_stack_destroy(worker->stack);
+            break;
+        }
+    }
+    if (rss_worker_num < workers)
+    {
+        fprintf(stderr, "Error in rss_start, worker %d failed.\n", rss_worker_num);
+        ring_free(&rss_workers[rss_worker_num].rx);
+        ring_free(&rss_workers[rss_worker_num].done);
+        rss_stop();
+        return -1;
+    }
+    net_stack->rx_poll = rss_poll;
+    return 0;
+}
+
+/**
+ * @brief 获取一个工作线程的统计，可在收包线程中调用
+ *
+ * @param worker 工作线程编号
+ * @param stats 出口参数，统计数据
+ */
+void rss_get_stats(int worker, rss_stats_t *stats)
+{
+    stats->packets = __atomic_load_n(&rss_workers[worker].packets, __ATOMIC_RELAXED);
+    stats->drops = rss_workers[worker].drops;
+}
+
+/**
+ * @brief 停止并回收全部工作线程，当前线程恢复自行处理收到的帧，只能由调用rss_start的线程调用
+ *
+ */
+void rss_stop()
+{
+    if (rss_workers == NULL)
+        return;
+    __atomic_store_n(&rss_running, 0, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&rss_alive, __ATOMIC_ACQUIRE)) // 工作线程可能在等待交还帧
+    {
+        rss_reclaim();
+        sched_yield();
+    }
+    rss_reclaim();
+    buf_t bufs[NET_BURST];
+    for (int w = 0; w < rss_worker_num; w++)
+    {
+        size_t n;
+        pthread_join(rss_workers[w].thread, NULL);
+        while ((n = ring_pop_burst(&rss_workers[w].rx, bufs, NET_BURST)) > 0)
+            for (size_t i = 0; i < n; i++)
+                buf_free(&bufs[i]);
+        ring_free(&rss_workers[w].rx);
+        ring_free(&rss_workers[w].done);
+    }
+    free(rss_workers);
+    rss_workers = NULL;
+    rss_worker_num = 0;
+    rss_owner->rx_poll = NULL;
+}
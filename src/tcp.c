@@ -24,15 +24,14 @@ static void display_flags(tcp_flags_t flags)
            flags.fin ? " fin" : "");
 }
 
-// dst-port -> handler
-static map_t tcp_table; // tcp_table里面放了一个dst_port的回调函数
-
-// tcp_key_t[IP, src port, dst port] -> tcp_connect_t
-
-/* Connect_table放置了一堆TCP连接，
-    KEY为[IP，src port，dst port], 即tcp_key_t，VALUE为tcp_connect_t。
-*/
-static map_t connect_table;
+// net_stack->tcp_table: dst-port -> handler
+// net_stack->connect_table: tcp_key_t[IP, src port, dst port] -> tcp_connect_t，即一堆TCP连接
+static void release_tcp_connect_value(void *value);
+static int tcp_connect_detached(void *key, void *value);
+static void tcp_connect_evict(void *key, void *value);
+static void tcp_send(buf_t *buf, tcp_connect_t *connect, tcp_flags_t flags);
+_Static_assert(sizeof(tcp_key_t) == sizeof(uint64_t), "connect_table uses map64 lookups");
+_Static_assert(BUF_POOL_JUMBO_NUM >= 2 * TCP_MAX_CONNECT, "each tcp connection pins a jumbo rx_buf and tx_buf");
 
 /**
  * @brief 生成一个用于 connect_table 的 key
@@ -58,23 +57,37 @@ static tcp_key_t new_tcp_key(uint8_t ip[NET_IP_LEN], uint16_t src_port, uint16_t
  */
 void tcp_init()
 {
-    map_init(&tcp_table, sizeof(uint16_t), sizeof(tcp_handler_t), 0, 0, NULL);
-    map_init(&connect_table, sizeof(tcp_key_t), sizeof(tcp_connect_t), 0, 0, NULL);
+    map_init(&net_stack->tcp_table, sizeof(uint16_t), sizeof(tcp_handler_t), 0, 0, NULL, NULL);
+    map_init(&net_stack->connect_table, sizeof(tcp_key_t), sizeof(tcp_connect_t), TCP_MAX_CONNECT, 0, NULL, release_tcp_connect_value);
+    map_set_policy(&net_stack->connect_table, MAP_EVICT_LRU);
+    map_set_evict_handler(&net_stack->connect_table, tcp_connect_detached, tcp_connect_evict);
     net_add_protocol(NET_PROTOCOL_TCP, tcp_in);
 }
 
 /**
  * @brief 向 port 注册一个 TCP 连接以及关联的回调函数
- *        供应用层使用
+ *        供应用层使用，巨型缓冲池已不足以建立一个连接时失败
  *
  * @param port
  * @param handler
- * @return int
+ * @return int 成功为0，失败为-1
  */
 int tcp_open(uint16_t port, tcp_handler_t handler)
 {
+    buf_pool_stats_t stats;
+    buf_pool_stats(BUF_POOL_JUMBO, &stats);
+    if (stats.total - stats.in_use < 2)
+    {
+        fprintf(stderr, "Error in tcp_open:%u, %zu of %zu jumbo bufs in use\n", port, stats.in_use, stats.total);
+        return -1;
+    }
+    if (map16_set(&net_stack->tcp_table, port, &handler) != 0)
+    {
+        fprintf(stderr, "Error in tcp_open:%u\n", port);
+        return -1;
+    }
     printf("tcp open\n");
-    return map_set(&tcp_table, &port, &handler);
+    return 0;
 }
 
 /**
@@ -82,22 +95,29 @@ int tcp_open(uint16_t port, tcp_handler_t handler)
  *        rx_buf和tx_buf在触及边界时会把数据重新移动到头部，防止溢出。
  *
  * @param connect
+ * @return int 成功为0，缓冲池耗尽为-1
  */
-static void init_tcp_connect_rcvd(tcp_connect_t *connect)
+static int init_tcp_connect_rcvd(tcp_connect_t *connect)
 {
     if (connect->state == TCP_LISTEN)
     {
-        connect->rx_buf = malloc(sizeof(buf_t));
-        connect->tx_buf = malloc(sizeof(buf_t));
+        if (buf_alloc_pool(&connect->rx_buf, BUF_POOL_JUMBO, 0) == -1)
+            return -1;
+        if (buf_alloc_pool(&connect->tx_buf, BUF_POOL_JUMBO, 0) == -1)
+        {
+            buf_free(&connect->rx_buf);
+            return -1;
+        }
     }
-    buf_init(connect->rx_buf, 0);
-    buf_init(connect->tx_buf, 0);
+    buf_init(&connect->rx_buf, 0);
+    buf_init(&connect->tx_buf, 0);
     connect->state = TCP_SYN_RCVD;
+    return 0;
 }
 
 /**
  * @brief 释放TCP连接，这会释放分配的空间，并把状态变回LISTEN。
- *        一般这个后边都会跟个map_delete(&connect_table, &key)把状态变回CLOSED
+ *        一般这个后边都会跟个map_delete(&net_stack->connect_table, &key)把状态变回CLOSED
  *
  * @param connect
  */
@@ -105,25 +125,74 @@ static void release_tcp_connect(tcp_connect_t *connect)
 {
     if (connect->state == TCP_LISTEN)
         return;
-    free(connect->rx_buf);
-    free(connect->tx_buf);
+    buf_free(&connect->rx_buf);
+    buf_free(&connect->tx_buf);
     connect->state = TCP_LISTEN;
 }
 
-static uint16_t tcp_checksum(buf_t *buf, uint8_t *src_ip, uint8_t *dst_ip)
+/**
+ * @brief connect_table的值析构函数，连接被删除或淘汰时释放其缓存
+ *
+ * @param value tcp_connect_t指针
+ */
+static void release_tcp_connect_value(void *value)
+{
+    release_tcp_connect(value);
+}
+
+/**
+ * @brief connect_table的淘汰判断，应用尚未得知（握手未完成）或已主动关闭的连接可直接淘汰
+ *
+ * @param key tcp_key_t指针
+ * @param value tcp_connect_t指针
+ * @return int 可直接淘汰为1，应用仍持有该连接为0
+ */
+static int tcp_connect_detached(void *key, void *value)
 {
-    uint16_t len = (uint16_t)buf->len;
-    tcp_peso_hdr_t *peso_hdr = (tcp_peso_hdr_t *)(buf->data - sizeof(tcp_peso_hdr_t));
-    tcp_peso_hdr_t pre; // 暂存被覆盖的IP头
-    memcpy(&pre, peso_hdr, sizeof(tcp_peso_hdr_t));
-    memcpy(peso_hdr->src_ip, src_ip, NET_IP_LEN);
-    memcpy(peso_hdr->dst_ip, dst_ip, NET_IP_LEN);
-    peso_hdr->placeholder = 0;
-    peso_hdr->protocol = NET_PROTOCOL_TCP;
-    peso_hdr->total_len16 = swap16(len);
-    uint16_t checksum = checksum16((uint16_t *)peso_hdr, len + sizeof(tcp_peso_hdr_t));
-    memcpy(peso_hdr, &pre, sizeof(tcp_peso_hdr_t));
-    return checksum;
+    tcp_state_t state = ((tcp_connect_t *)value)->state;
+    return state != TCP_ESTABLISHED && state != TCP_CLOSE_WAIT && state != TCP_LAST_ACK;
+}
+
+/**
+ * @brief connect_table淘汰应用仍持有的连接前的回调，向对端发送rst，并通知应用连接已关闭
+ *        与正常关闭一样以LAST_ACK状态通知，应用此时调用tcp_connect_close只会释放连接
+ *
+ * @param key tcp_key_t指针
+ * @param value tcp_connect_t指针
+ */
+static void tcp_connect_evict(void *key, void *value)
+{
+    tcp_connect_t *connect = value;
+    buf_init(&net_stack->txbuf, 0);
+    tcp_send(&net_stack->txbuf, connect, tcp_flags_ack_rst);
+    connect->state = TCP_LAST_ACK;
+    tcp_handler_t *handler = (tcp_handler_t *)map16_get(&net_stack->tcp_table, ((tcp_key_t *)key)->dst_port);
+    if (handler)
+        (*handler)(connect, TCP_CONN_CLOSED);
+}
+
+/**
+ * @brief tcp伪校验和计算，伪头部直接累加，不改动buf
+ *
+ * @param buf 要计算的包
+ * @param src_ip 源ip地址
+ * @param dst_ip 目的ip地址
+ * @param payload 负载（tcp头部之后的数据）已知的累加和，为NULL则从buf中计算
+ * @return uint16_t 伪校验和
+ */
+static uint16_t tcp_checksum(buf_t *buf, uint8_t *src_ip, uint8_t *dst_ip, const checksum_ctx_t *payload)
+{
+    checksum_ctx_t ctx;
+    checksum_init(&ctx);
+    checksum_pseudo(&ctx, src_ip, dst_ip, NET_PROTOCOL_TCP, (uint16_t)buf_chain_len(buf));
+    if (payload)
+    {
+        checksum_add(&ctx, buf->data, sizeof(tcp_hdr_t));
+        checksum_merge(&ctx, payload);
+    }
+    else
+        buf_checksum_add(&ctx, buf);
+    return checksum_finish(&ctx);
 }
 
 static _Thread_local uint16_t delete_port;
@@ -152,8 +221,8 @@ static void close_port_fn(void *key, void *value, time_t *timestamp)
 void tcp_close(uint16_t port)
 {
     delete_port = port;
-    map_foreach(&connect_table, close_port_fn);
-    map_delete(&tcp_table, &port);
+    map_foreach(&net_stack->connect_table, close_port_fn);
+    map16_delete(&net_stack->tcp_table, port);
 }
 
 /**
@@ -165,8 +234,8 @@ void tcp_close(uint16_t port)
  */
 static uint16_t tcp_read_from_buf(tcp_connect_t *connect, buf_t *buf)
 {
-    uint8_t *dst = connect->rx_buf->data + connect->rx_buf->len;
-    buf_add_padding(connect->rx_buf, buf->len);
+    uint8_t *dst = connect->rx_buf.data + connect->rx_buf.len;
+    buf_add_padding(&connect->rx_buf, buf->len);
     memcpy(dst, buf->data, buf->len);
     connect->ack += buf->len;
     return buf->len;
@@ -174,17 +243,37 @@ static uint16_t tcp_read_from_buf(tcp_connect_t *connect, buf_t *buf)
 
 /**
  * @brief 把connect内tx_buf的数据写入到buf里面供tcp_send使用，buf原来的内容会无效。
+ *        数据较多时不拷贝，buf只作为头部段，以链的下一段引用tx_buf中的数据。
+ *        两种情况下负载都只读一遍，累加和交给tcp_send_csum，计算校验和时不再读取。
+ *        校验和由驱动填写时不累加。
  *
  * @param connect
  * @param buf
+ * @param payload 输出，负载的累加和
  * @return uint16_t 字节数
  */
-static uint16_t tcp_write_to_buf(tcp_connect_t *connect, buf_t *buf)
+static uint16_t tcp_write_to_buf(tcp_connect_t *connect, buf_t *buf, checksum_ctx_t *payload)
 {
     uint16_t sent = connect->next_seq - connect->unack_seq;
-    uint16_t size = min32(connect->tx_buf->len - sent, connect->remote_win);
-    buf_init(buf, size);
-    memcpy(buf->data, connect->tx_buf->data + sent, size);
+    uint16_t size = min32(connect->tx_buf.len - sent, connect->remote_win);
+    int offload = net_stack->if_caps & NET_CAP_TX_CSUM;
+    checksum_init(payload);
+    if (size <= BUF_COPYBREAK)
+    {
+        buf_init(buf, size);
+        if (offload)
+            memcpy(buf->data, connect->tx_buf.data + sent, size);
+        else
+            checksum_add_copy(payload, buf->data, connect->tx_buf.data + sent, size);
+    }
+    else
+    {
+        buf_init(buf, 0);
+        buf_slice(&connect->tx_buf, sent, size, &net_stack->tcp_tx_seg, 1);
+        buf->next = &net_stack->tcp_tx_seg;
+        if (!offload)
+            checksum_add(payload, net_stack->tcp_tx_seg.data, size);
+    }
     connect->next_seq += size;
     return size;
 }
@@ -192,16 +281,18 @@ static uint16_t tcp_write_to_buf(tcp_connect_t *connect, buf_t *buf)
 /**
  * @brief 发送TCP包, seq_number32 = connect->next_seq - buf->len
  *        buf里的数据将作为负载，加上tcp头发送出去。如果flags包含syn或fin，seq会递增。
+ *        驱动能填写校验和时只写入伪头部的累加和。
  *
  * @param buf
  * @param connect
  * @param flags
+ * @param payload 负载已知的累加和，为NULL则计算校验和时读取负载
  */
-static void tcp_send(buf_t *buf, tcp_connect_t *connect, tcp_flags_t flags)
+static void tcp_send_csum(buf_t *buf, tcp_connect_t *connect, tcp_flags_t flags, const checksum_ctx_t *payload)
 {
     // printf("<< tcp send >> sz=%zu\n", buf->len);
     display_flags(flags);
-    size_t prev_len = buf->len;
+    size_t prev_len = buf_chain_len(buf);
     buf_add_header(buf, sizeof(tcp_hdr_t));
     tcp_hdr_t *hdr = (tcp_hdr_t *)buf->data;
     hdr->src_port16 = swap16(connect->local_port);
@@ -214,7 +305,16 @@ static void tcp_send(buf_t *buf, tcp_connect_t *connect, tcp_flags_t flags)
     hdr->window_size16 = swap16(connect->remote_win);
     hdr->chunksum16 = 0;
     hdr->urgent_pointer16 = 0;
-    hdr->chunksum16 = tcp_checksum(buf, connect->ip, net_if_ip);
+    if (net_stack->if_caps & NET_CAP_TX_CSUM)
+    {
+        checksum_ctx_t ctx;
+        checksum_init(&ctx);
+        checksum_pseudo(&ctx, net_stack->if_ip, connect->ip, NET_PROTOCOL_TCP, (uint16_t)buf_chain_len(buf));
+        hdr->chunksum16 = checksum_fold(ctx.sum);
+        buf_checksum_partial(buf, 0, offsetof(tcp_hdr_t, chunksum16));
+    }
+    else
+        hdr->chunksum16 = tcp_checksum(buf, connect->ip, net_stack->if_ip, payload);
     ip_out(buf, connect->ip, NET_PROTOCOL_TCP);
     if (flags.syn || flags.fin)
     {
@@ -222,6 +322,18 @@ static void tcp_send(buf_t *buf, tcp_connect_t *connect, tcp_flags_t flags)
     }
 }
 
+/**
+ * @brief 发送TCP包，负载的校验和在发送时计算
+ *
+ * @param buf
+ * @param connect
+ * @param flags
+ */
+static void tcp_send(buf_t *buf, tcp_connect_t *connect, tcp_flags_t flags)
+{
+    tcp_send_csum(buf, connect, flags, NULL);
+}
+
 /**
  * @brief 从外部关闭一个TCP连接, 会发送剩余数据
  *        供应用层使用
@@ -232,14 +344,15 @@ void tcp_connect_close(tcp_connect_t *connect)
 {
     if (connect->state == TCP_ESTABLISHED)
     {
-        tcp_write_to_buf(connect, &txbuf);
-        tcp_send(&txbuf, connect, tcp_flags_ack_fin);
+        checksum_ctx_t payload;
+        tcp_write_to_buf(connect, &net_stack->txbuf, &payload);
+        tcp_send_csum(&net_stack->txbuf, connect, tcp_flags_ack_fin, &payload);
         connect->state = TCP_FIN_WAIT_1;
         return;
     }
     tcp_key_t key = new_tcp_key(connect->ip, connect->remote_port, connect->local_port);
     release_tcp_connect(connect);
-    map_delete(&connect_table, &key);
+    map_delete(&net_stack->connect_table, &key);
 }
 
 /**
@@ -253,7 +366,7 @@ void tcp_connect_close(tcp_connect_t *connect)
  */
 size_t tcp_connect_read(tcp_connect_t *connect, uint8_t *data, size_t len)
 {
-    buf_t *rx_buf = connect->rx_buf;
+    buf_t *rx_buf = &connect->rx_buf;
     size_t size = min32(rx_buf->len, len);
     memcpy(data, rx_buf->data, size);
     if (buf_remove_header(rx_buf, size) != 0)
@@ -264,6 +377,21 @@ size_t tcp_connect_read(tcp_connect_t *connect, uint8_t *data, size_t len)
     return size;
 }
 
+/**
+ * @brief 按地址与端口查找一个连接，供不在处理程序中持有连接指针的应用层使用
+ *
+ * @param ip 对端ip
+ * @param remote_port 对端端口
+ * @param local_port 本地端口
+ * @return tcp_connect_t* 连接，不存在或尚在监听时为NULL
+ */
+tcp_connect_t *tcp_connect_find(uint8_t *ip, uint16_t remote_port, uint16_t local_port)
+{
+    tcp_key_t key = new_tcp_key(ip, remote_port, local_port);
+    tcp_connect_t *connect = map64_get(&net_stack->connect_table, map64_key(&key));
+    return connect && connect->state != TCP_LISTEN ? connect : NULL;
+}
+
 /**
  * @brief 往connect的tx_buf里面写东西，返回成功的字节数，这里要判断窗口够不够，否则图片显示不全。
  *        供应用层使用
@@ -275,10 +403,10 @@ size_t tcp_connect_read(tcp_connect_t *connect, uint8_t *data, size_t len)
 size_t tcp_connect_write(tcp_connect_t *connect, const uint8_t *data, size_t len)
 {
     // printf("tcp_connect_write size: %zu\n", len);
-    buf_t *tx_buf = connect->tx_buf;
+    buf_t *tx_buf = &connect->tx_buf;
 
     uint8_t *dst = tx_buf->data + tx_buf->len;
-    size_t size = min32(&tx_buf->payload[BUF_MAX_LEN] - dst, len);
+    size_t size = min32(tx_buf->payload + tx_buf->size - dst, len);
 
     if (connect->next_seq - connect->unack_seq + len >= connect->remote_win)
     {
@@ -288,9 +416,10 @@ size_t tcp_connect_write(tcp_connect_t *connect, const uint8_t *data, size_t len
     {
         memmove(tx_buf->payload, tx_buf->data, tx_buf->len);
         tx_buf->data = tx_buf->payload;
-        if (tcp_write_to_buf(connect, &txbuf))
+        checksum_ctx_t payload;
+        if (tcp_write_to_buf(connect, &net_stack->txbuf, &payload))
         {
-            tcp_send(&txbuf, connect, tcp_flags_ack);
+            tcp_send_csum(&net_stack->txbuf, connect, tcp_flags_ack, &payload);
         }
         return 0;
     }
@@ -298,6 +427,24 @@ size_t tcp_connect_write(tcp_connect_t *connect, const uint8_t *data, size_t len
     return size;
 }
 
+/**
+ * @brief 立即发送tx_buf中尚未发送的数据，供不在处理程序中写入的应用层使用
+ *        在处理程序中写入的数据随对收到数据的确认一起发送，不需要调用
+ *
+ * @param connect
+ * @return size_t 发送的字节数
+ */
+size_t tcp_connect_flush(tcp_connect_t *connect)
+{
+    if (connect->state != TCP_ESTABLISHED)
+        return 0;
+    checksum_ctx_t payload;
+    uint16_t size = tcp_write_to_buf(connect, &net_stack->txbuf, &payload);
+    if (size)
+        tcp_send_csum(&net_stack->txbuf, connect, tcp_flags_ack, &payload);
+    return size;
+}
+
 /**
  * @brief 服务器端TCP收包
  *
@@ -312,18 +459,21 @@ void tcp_in(buf_t *buf, uint8_t *src_ip)
         return;
     }
 
-    // 检查checksum字段，如果checksum出错，则丢弃
+    // 检查checksum字段，如果checksum出错，则丢弃；驱动已校验或本机生成待填写的不再校验
     tcp_hdr_t *hdr = (tcp_hdr_t *)buf->data;
-    uint16_t chk = hdr->chunksum16;
-    hdr->chunksum16 = 0;
-    uint16_t rlt = tcp_checksum(buf, src_ip, net_if_ip);
-    if (rlt == chk)
-    {
-        hdr->chunksum16 = chk;
-    }
-    else
+    if (buf->csum == BUF_CSUM_NONE)
     {
-        return;
+        uint16_t chk = hdr->chunksum16;
+        hdr->chunksum16 = 0;
+        uint16_t rlt = tcp_checksum(buf, src_ip, net_stack->if_ip, NULL);
+        if (rlt == chk)
+        {
+            hdr->chunksum16 = chk;
+        }
+        else
+        {
+            return;
+        }
     }
 
     // 从tcp头部字段中获取必要数据
@@ -334,7 +484,7 @@ void tcp_in(buf_t *buf, uint8_t *src_ip)
     tcp_flags_t flags = hdr->flags;
 
     // 调用map_get函数，根据destination port查找对应的handler函数
-    tcp_handler_t *handler = (tcp_handler_t *)map_get(&tcp_table, &dstPort);
+    tcp_handler_t *handler = (tcp_handler_t *)map16_get(&net_stack->tcp_table, dstPort);
     if (!handler)
     {
         return;
@@ -344,11 +494,12 @@ void tcp_in(buf_t *buf, uint8_t *src_ip)
     tcp_key_t key = new_tcp_key(src_ip, srcPort, dstPort);
 
     // 调用map_get函数，根据key查找一个tcp_connect_t* connect，
-    tcp_connect_t *connect = map_get(&connect_table, &key);
+    tcp_connect_t *connect = map64_get(&net_stack->connect_table, map64_key(&key));
     if (!connect)
     {
-        map_set(&connect_table, &key, &CONNECT_LISTEN);
-        connect = map_get(&connect_table, &key);
+        if (map_set(&net_stack->connect_table, &key, &CONNECT_LISTEN) != 0)
+            return;
+        connect = map64_get(&net_stack->connect_table, map64_key(&key));
     }
 
     // 从TCP头部字段中获取对方的窗口大小，注意大小端转换
@@ -361,7 +512,7 @@ void tcp_in(buf_t *buf, uint8_t *src_ip)
         {
             // 收到的flag带有rst
             release_tcp_connect(connect);
-            map_delete(&connect_table, &key);
+            map_delete(&net_stack->connect_table, &key);
             return;
         }
         if (!flags.syn)
@@ -369,23 +520,28 @@ void tcp_in(buf_t *buf, uint8_t *src_ip)
             // 收到的flag不是syn
             connect->next_seq = 0;
             connect->ack = getSeq + 1;
-            buf_init(&txbuf, 0);
-            tcp_send(&txbuf, connect, tcp_flags_ack_rst);
+            buf_init(&net_stack->txbuf, 0);
+            tcp_send(&net_stack->txbuf, connect, tcp_flags_ack_rst);
         }
         // 初始化connect并填充connect字段
-        init_tcp_connect_rcvd(connect);
+        if (init_tcp_connect_rcvd(connect) == -1)
+        {
+            fprintf(stderr, "Error in tcp_in: jumbo pool exhausted, connection to port %u dropped\n", dstPort);
+            map_delete(&net_stack->connect_table, &key);
+            return;
+        }
         connect->local_port = dstPort;
         connect->remote_port = srcPort;
         memcpy(connect->ip, src_ip, NET_IP_LEN);
-        srand(time(NULL));
+        srand(net_now_ns());
         uint32_t rnd = rand() % MAX_SQE_RND;
         connect->unack_seq = rnd;
         connect->next_seq = rnd;
         connect->ack = getSeq + 1;
         connect->remote_win = windowSize;
         // 处理发送信息
-        buf_init(&txbuf, 0);
-        tcp_send(&txbuf, connect, tcp_flags_ack_syn);
+        buf_init(&net_stack->txbuf, 0);
+        tcp_send(&net_stack->txbuf, connect, tcp_flags_ack_syn);
         return;
     }
 
@@ -394,15 +550,15 @@ void tcp_in(buf_t *buf, uint8_t *src_ip)
     {
         connect->next_seq = 0;
         connect->ack = getSeq + 1;
-        buf_init(&txbuf, 0);
-        tcp_send(&txbuf, connect, tcp_flags_ack_rst);
+        buf_init(&net_stack->txbuf, 0);
+        tcp_send(&net_stack->txbuf, connect, tcp_flags_ack_rst);
     }
 
     // 检查flags的rst标志
     if (flags.rst)
     {
         release_tcp_connect(connect);
-        map_delete(&connect_table, &key);
+        map_delete(&net_stack->connect_table, &key);
         return;
     }
 
@@ -441,7 +597,7 @@ void tcp_in(buf_t *buf, uint8_t *src_ip)
             connect->unack_seq < getAck &&
             connect->next_seq >= getAck)
         {
-            buf_remove_header(connect->tx_buf, min32(getAck - connect->unack_seq, connect->next_seq - connect->unack_seq));
+            buf_remove_header(&connect->tx_buf, min32(getAck - connect->unack_seq, connect->next_seq - connect->unack_seq));
             connect->unack_seq = min32(getAck, connect->next_seq);
         }
 
@@ -449,19 +605,20 @@ void tcp_in(buf_t *buf, uint8_t *src_ip)
         tcp_read_from_buf(connect, buf);
 
         // 根据当前的标志位进一步处理
-        buf_init(&txbuf, 0);
+        buf_init(&net_stack->txbuf, 0);
         if (flags.fin)
         {
             connect->state = TCP_LAST_ACK;
             connect->ack++;
-            tcp_send(&txbuf, connect, tcp_flags_ack_fin);
+            tcp_send(&net_stack->txbuf, connect, tcp_flags_ack_fin);
             break;
         }
         if (buf->len > 0)
         {
             (*handler)(connect, TCP_CONN_DATA_RECV);
-            tcp_write_to_buf(connect, &txbuf);
-            tcp_send(&txbuf, connect, tcp_flags_ack);
+            checksum_ctx_t payload;
+            tcp_write_to_buf(connect, &net_stack->txbuf, &payload);
+            tcp_send_csum(&net_stack->txbuf, connect, tcp_flags_ack, &payload);
         }
         break;
 
@@ -475,7 +632,7 @@ void tcp_in(buf_t *buf, uint8_t *src_ip)
         if (flags.fin && flags.ack)
         {
             release_tcp_connect(connect);
-            map_delete(&connect_table, &key);
+            map_delete(&net_stack->connect_table, &key);
             return;
         }
         if (flags.ack)
@@ -489,10 +646,10 @@ void tcp_in(buf_t *buf, uint8_t *src_ip)
         if (flags.fin)
         {
             connect->ack++;
-            buf_init(&txbuf, 0);
-            tcp_send(&txbuf, connect, tcp_flags_ack);
+            buf_init(&net_stack->txbuf, 0);
+            tcp_send(&net_stack->txbuf, connect, tcp_flags_ack);
             release_tcp_connect(connect);
-            map_delete(&connect_table, &key);
+            map_delete(&net_stack->connect_table, &key);
             return;
         }
         break;
@@ -502,7 +659,7 @@ void tcp_in(buf_t *buf, uint8_t *src_ip)
         {
             (*handler)(connect, TCP_CONN_CLOSED);
             release_tcp_connect(connect);
-            map_delete(&connect_table, &key);
+            map_delete(&net_stack->connect_table, &key);
             return;
         }
 
@@ -4,42 +4,94 @@
 #include "utils.h"
 
 /**
- * @brief udp处理程序表
- *
- */
-map_t udp_table;
-
-/**
- * @brief udp伪校验和计算
+ * @brief udp伪校验和计算，伪头部直接累加，不改动buf
  *
  * @param buf 要计算的包
  * @param src_ip 源ip地址
  * @param dst_ip 目的ip地址
- * @param protocol ip头部的协议号，由于执行udp_out时ip头部不存在，因此需手动传入
+ * @param payload 负载（udp头部之后的数据）已知的累加和，为NULL则从buf中计算
  * @return uint16_t 伪校验和
  */
-static uint16_t udp_checksum(buf_t *buf, uint8_t *src_ip, uint8_t *dst_ip)
+static uint16_t udp_checksum(buf_t *buf, uint8_t *src_ip, uint8_t *dst_ip, const checksum_ctx_t *payload)
 {
-    // 添加UDP伪头部
     udp_hdr_t *hdr = (udp_hdr_t *)buf->data;
-    buf_add_header(buf, sizeof(udp_peso_hdr_t));
-    // 拷贝伪头部
-    udp_peso_hdr_t *peso_hdr = (udp_peso_hdr_t *)malloc(sizeof(udp_peso_hdr_t));
-    memcpy(peso_hdr, buf->data, sizeof(udp_peso_hdr_t));
-    // 填写伪头部信息
-    udp_peso_hdr_t *p = (udp_peso_hdr_t *)buf->data;
-    memcpy(p->src_ip, src_ip, NET_IP_LEN);
-    memcpy(p->dst_ip, dst_ip, NET_IP_LEN);
-    p->placeholder = 0;
-    p->protocol = NET_PROTOCOL_UDP;
-    p->total_len16 = hdr->total_len16;
-    // 计算校验和
-    uint16_t sum = checksum16((uint16_t *)buf->data, buf->len);
-    // 复原UDP头部
-    memcpy(buf->data, peso_hdr, sizeof(udp_peso_hdr_t));
-    buf_remove_header(buf, sizeof(udp_peso_hdr_t));
-    // 返回校验和的值
-    return sum;
+    checksum_ctx_t ctx;
+    checksum_init(&ctx);
+    checksum_pseudo(&ctx, src_ip, dst_ip, NET_PROTOCOL_UDP, swap16(hdr->total_len16));
+    if (payload)
+    {
+        checksum_add(&ctx, hdr, sizeof(udp_hdr_t));
+        checksum_merge(&ctx, payload);
+    }
+    else
+        buf_checksum_add(&ctx, buf);
+    return checksum_finish(&ctx);
+}
+
+/**
+ * @brief 处理一组收到的udp数据包
+ *        先逐个检查报头与校验和，再用map_get_batch一次查找全部目的端口，最后依次交给回调函数
+ *
+ * @param bufs 要处理的包
+ * @param src_ips 各数据包的源ip地址
+ * @param n 数据包数
+ */
+void udp_in_burst(buf_t **bufs, uint8_t **src_ips, int n)
+{
+    buf_t *vec[NET_BURST];
+    uint8_t *srcs[NET_BURST];
+    const void *keys[NET_BURST];
+    void *handlers[NET_BURST];
+    while (n > 0)
+    {
+        int m = 0, l = n < NET_BURST ? n : NET_BURST;
+        for (int i = 0; i < l; i++)
+        {
+            buf_t *buf = bufs[i];
+            // 检查报头信息
+            if (buf->len < sizeof(udp_hdr_t))
+            {
+                continue;
+            }
+            udp_hdr_t *hdr = (udp_hdr_t *)buf->data;
+            if (buf->len < swap16(hdr->total_len16))
+            {
+                continue;
+            }
+            // 检查校验和，驱动已校验或本机生成待填写的不再校验
+            if (buf->csum == BUF_CSUM_NONE && udp_checksum(buf, src_ips[i], net_stack->if_ip, NULL))
+            {
+                continue;
+            }
+            hdr->dst_port16 = swap16(hdr->dst_port16);
+            vec[m] = buf;
+            srcs[m] = src_ips[i];
+            keys[m++] = &hdr->dst_port16;
+        }
+        // 检查端口号，回调函数可能打开或关闭端口，先取出全部函数指针
+        map_get_batch(&net_stack->udp_table, keys, m, handlers);
+        udp_handler_t fns[NET_BURST];
+        for (int i = 0; i < m; i++)
+            fns[i] = handlers[i] ? *(udp_handler_t *)handlers[i] : NULL;
+        for (int i = 0; i < m; i++)
+        {
+            buf_t *buf = vec[i];
+            udp_hdr_t *hdr = (udp_hdr_t *)buf->data;
+            if (fns[i])
+            {
+                // 如果找到回调函数，则交给回调函数处理
+                buf_remove_header(buf, sizeof(udp_hdr_t));
+                fns[i](buf->data, buf->len, srcs[i], swap16(hdr->src_port16));
+            }
+            else
+            {
+                // 如果没有找到回调函数，ICMP不可达
+                buf_add_header(buf, sizeof(ip_hdr_t));
+                icmp_unreachable(buf, srcs[i], ICMP_CODE_PORT_UNREACH);
+            }
+        }
+        bufs += l, src_ips += l, n -= l;
+    }
 }
 
 /**
@@ -50,47 +102,20 @@ static uint16_t udp_checksum(buf_t *buf, uint8_t *src_ip, uint8_t *dst_ip)
  */
 void udp_in(buf_t *buf, uint8_t *src_ip)
 {
-    // 检查报头信息
-    if (buf->len < sizeof(udp_hdr_t))
-    {
-        return;
-    }
-    udp_hdr_t *hdr = (udp_hdr_t *)buf->data;
-    if (buf->len < swap16(hdr->total_len16))
-    {
-        return;
-    }
-    // 检查校验和
-    if (udp_checksum(buf, src_ip, net_if_ip))
-    {
-        return;
-    }
-    // 检查端口号
-    hdr->dst_port16 = swap16(hdr->dst_port16);
-    udp_handler_t *handler = (udp_handler_t *)map_get(&udp_table, &hdr->dst_port16);
-    if (handler)
-    {
-        // 如果找到回调函数，则交给回调函数处理
-        buf_remove_header(buf, sizeof(udp_hdr_t));
-        (*handler)(buf->data, buf->len, src_ip, swap16(hdr->src_port16));
-    }
-    else
-    {
-        // 如果没有找到回调函数，ICMP不可达
-        buf_add_header(buf, sizeof(ip_hdr_t));
-        icmp_unreachable(buf, src_ip, ICMP_CODE_PORT_UNREACH);
-    }
+    udp_in_burst(&buf, &src_ip, 1);
 }
 
 /**
- * @brief 处理一个要发送的数据包
+ * @brief 内部函数，添加udp头部并发送
+ *        驱动能填写校验和时只写入伪头部的累加和，负载不在此读取
  *
- * @param buf 要处理的包
+ * @param buf 要处理的包，可以是链式buf
  * @param src_port 源端口号
  * @param dst_ip 目的ip地址
  * @param dst_port 目的端口号
+ * @param payload 负载已知的累加和，为NULL则计算校验和时读取负载
  */
-void udp_out(buf_t *buf, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port)
+static void udp_out_csum(buf_t *buf, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port, const checksum_ctx_t *payload)
 {
     // 添加UDP报头
     buf_add_header(buf, sizeof(udp_hdr_t));
@@ -99,20 +124,43 @@ void udp_out(buf_t *buf, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port)
     hdr->checksum16 = 0;
     hdr->src_port16 = swap16(src_port);
     hdr->dst_port16 = swap16(dst_port);
-    hdr->total_len16 = swap16(buf->len);
-    hdr->checksum16 = udp_checksum(buf, net_if_ip, dst_ip);
+    hdr->total_len16 = swap16(buf_chain_len(buf));
+    if (net_stack->if_caps & NET_CAP_TX_CSUM)
+    {
+        checksum_ctx_t ctx;
+        checksum_init(&ctx);
+        checksum_pseudo(&ctx, net_stack->if_ip, dst_ip, NET_PROTOCOL_UDP, swap16(hdr->total_len16));
+        hdr->checksum16 = checksum_fold(ctx.sum);
+        buf_checksum_partial(buf, 0, offsetof(udp_hdr_t, checksum16));
+    }
+    else
+        hdr->checksum16 = udp_checksum(buf, net_stack->if_ip, dst_ip, payload);
     // 发送数据报
     ip_out(buf, dst_ip, NET_PROTOCOL_UDP);
 }
 
+/**
+ * @brief 处理一个要发送的数据包
+ *
+ * @param buf 要处理的包，可以是链式buf
+ * @param src_port 源端口号
+ * @param dst_ip 目的ip地址
+ * @param dst_port 目的端口号
+ */
+void udp_out(buf_t *buf, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port)
+{
+    udp_out_csum(buf, src_port, dst_ip, dst_port, NULL);
+}
+
 /**
  * @brief 初始化udp协议
  *
  */
 void udp_init()
 {
-    map_init(&udp_table, sizeof(uint16_t), sizeof(udp_handler_t), 0, 0, NULL);
+    map_init(&net_stack->udp_table, sizeof(uint16_t), sizeof(udp_handler_t), 0, 0, NULL, NULL);
     net_add_protocol(NET_PROTOCOL_UDP, udp_in);
+    net_add_protocol_burst(NET_PROTOCOL_UDP, udp_in_burst);
 }
 
 /**
@@ -124,7 +172,7 @@ void udp_init()
  */
 int udp_open(uint16_t port, udp_handler_t handler)
 {
-    return map_set(&udp_table, &port, &handler);
+    return map16_set(&net_stack->udp_table, port, &handler);
 }
 
 /**
@@ -134,7 +182,7 @@ int udp_open(uint16_t port, udp_handler_t handler)
  */
 void udp_close(uint16_t port)
 {
-    map_delete(&udp_table, &port);
+    map16_delete(&net_stack->udp_table, port);
 }
 
 /**
@@ -148,7 +196,23 @@ void udp_close(uint16_t port)
  */
 void udp_send(uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port)
 {
-    buf_init(&txbuf, len);
-    memcpy(txbuf.data, data, len);
-    udp_out(&txbuf, src_port, dst_ip, dst_port);
+    if (len <= BUF_COPYBREAK)
+    {
+        // 拷贝的同时累加校验和，计算校验和时不再读取负载；校验和由驱动填写时直接拷贝
+        checksum_ctx_t payload;
+        checksum_init(&payload);
+        buf_init(&net_stack->txbuf, len);
+        if (net_stack->if_caps & NET_CAP_TX_CSUM)
+            memcpy(net_stack->txbuf.data, data, len);
+        else
+            checksum_add_copy(&payload, net_stack->txbuf.data, data, len);
+        udp_out_csum(&net_stack->txbuf, src_port, dst_ip, dst_port, &payload);
+        return;
+    }
+    // 较大的负载不拷贝，txbuf只装载头部，数据以链的下一段引用
+    buf_t seg = BUF_VIEW(data, len);
+    buf_init(&net_stack->txbuf, 0);
+    net_stack->txbuf.next = &seg;
+    udp_out(&net_stack->txbuf, src_port, dst_ip, dst_port);
+    net_stack->txbuf.next = NULL;
 }
\ No newline at end of file
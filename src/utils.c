@@ -1,6 +1,33 @@
 #include "utils.h"
 #include <stdio.h>
 #include <string.h>
+/**
+ * @brief 协议栈时钟的缓存值，以及单调时钟到墙上时钟的偏移
+ * 
+ */
+_Thread_local uint64_t net_clock_ns;
+static _Thread_local int64_t net_clock_offset;
+
+/**
+ * @brief 刷新协议栈时钟
+ *        读取单调时钟，首次调用时记录其与墙上时钟的偏移，
+ *        使得net_now()与time(NULL)同基准，同时不受系统改时的影响
+ * 
+ */
+void net_clock_update()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t mono = (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    if (!net_clock_offset)
+    {
+        struct timespec wall;
+        clock_gettime(CLOCK_REALTIME, &wall);
+        net_clock_offset = (int64_t)wall.tv_sec * 1000000000 + wall.tv_nsec - mono;
+    }
+    net_clock_ns = mono + net_clock_offset;
+}
+
 /**
  * @brief ip转字符串
  * 
@@ -9,7 +36,7 @@
  */
 char *iptos(uint8_t *ip)
 {
-    static char output[3 * 4 + 3 + 1];
+    static _Thread_local char output[3 * 4 + 3 + 1];
     sprintf(output, "%d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
     return output;
 }
@@ -22,7 +49,7 @@ char *iptos(uint8_t *ip)
  */
 char *mactos(uint8_t *mac)
 {
-    static char output[2 * 6 + 5 + 1];
+    static _Thread_local char output[2 * 6 + 5 + 1];
     sprintf(output, "%02X-%02X-%02X-%02X-%02X-%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
     return output;
 }
@@ -35,7 +62,7 @@ char *mactos(uint8_t *mac)
  */
 char *timetos(time_t timestamp)
 {
-    static char output[20];
+    static _Thread_local char output[20];
     struct tm *utc_time = gmtime(&timestamp);
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wformat-overflow"
@@ -67,28 +94,3 @@ uint8_t ip_prefix_match(uint8_t *ipa, uint8_t *ipb)
     }
     return count;
 }
-
-/**
- * @brief 计算16位校验和
- * 
- * @param buf 要计算的数据包
- * @param len 要计算的长度
- * @return uint16_t 校验和
- */
-uint16_t checksum16(uint16_t *data, size_t len)
-{
-    uint32_t sum = 0;
-    for (size_t i = 0; i < (len / 2); i++)
-    {
-        sum += data[i];
-    }
-    if (len & 1)
-    {
-        sum += ((uint8_t *)(data))[len - 1];
-    }
-    while (sum >> 16)
-    {
-        sum = (sum & 0xFFFF) + (sum >> 16);
-    }
-    return (uint16_t)(~sum);
-}
\ No newline at end of file
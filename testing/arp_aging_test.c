@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <string.h>
+#include "net.h"
+#include "map.h"
+#include "driver.h"
+#include "ethernet.h"
+#include "arp.h"
+
+#define TEST_PAYLOAD 64 //缓存在arp_buf中的数据包长度
+
+static uint8_t known_ip[NET_IP_LEN] = {192, 168, 163, 10};
+static uint8_t known_mac[NET_MAC_LEN] = {0x21, 0x32, 0x43, 0x54, 0x65, 0x06};
+static uint8_t unknown_ip[NET_IP_LEN] = {192, 168, 163, 110};
+
+//测试不收发真实的帧，驱动只接受发送
+int driver_open() { return 0; }
+int driver_recv(buf_t *buf) { return 0; }
+int driver_recv_burst(buf_t *bufs, int n) { return 0; }
+int driver_recv_burst_pooled(buf_t *bufs, int n) { return 0; }
+int driver_send(buf_t *buf) { return 0; }
+void driver_flush() {}
+int driver_caps() { return 0; }
+int driver_mtu() { return ETHERNET_MAX_TRANSPORT_UNIT; }
+int driver_get_fd() { return -1; }
+void driver_close() {}
+
+/**
+ * @brief 拨快协议栈时钟并运行到期的定时器，不经net_poll，否则时钟会被重新读取
+ *
+ * @param ms 拨快的毫秒数
+ */
+static void advance(uint64_t ms)
+{
+    net_clock_ns += ms * 1000000;
+    net_timer_run();
+}
+
+/**
+ * @brief 检查两张表的大小与缓冲池中正在使用的buf数
+ *
+ * @param stage 阶段名
+ * @param table arp表的期望大小
+ * @param parked arp缓存的期望大小
+ * @param in_use 期望正在使用的buf数
+ * @return int 错误数
+ */
+static int check(const char *stage, size_t table, size_t parked, size_t in_use)
+{
+    buf_pool_stats_t stats;
+    buf_pool_stats(BUF_POOL_MTU, &stats);
+    if (map_size(&net_stack->arp_table) == table && map_size(&net_stack->arp_buf) == parked && stats.in_use == in_use)
+        return 0;
+    printf("\e[1;31m%s: arp table %zu (expect %zu), arp buf %zu (expect %zu), %zu bufs in use (expect %zu)\n", stage,
+           map_size(&net_stack->arp_table), table, map_size(&net_stack->arp_buf), parked, stats.in_use, in_use);
+    return 1;
+}
+
+/**
+ * @brief 检查arp老化由定时器完成：没有任何查找时，超时的arp表项与缓存的数据包也会被回收，未超时的保留
+ *
+ */
+int main(int argc, char *argv[])
+{
+    int errors = 0;
+    buf_pool_stats_t stats;
+    if (net_init() != 0)
+        return -1;
+    buf_pool_stats(BUF_POOL_MTU, &stats);
+    size_t base = stats.in_use;
+    map_set(&net_stack->arp_table, known_ip, known_mac);
+    buf_t *buf = &net_stack->txbuf;
+    buf_init(buf, TEST_PAYLOAD);
+    memset(buf->data, 0, TEST_PAYLOAD);
+    arp_out(buf, unknown_ip); // 缓存数据包并发出arp请求
+    errors += check("parked", 1, 1, base + 1);
+    advance(ARP_AGING_MS);
+    errors += check("before timeout", 1, 1, base + 1);
+    advance(ARP_MIN_INTERVAL * 1000 + ARP_AGING_MS);
+    errors += check("parked packet aged", 1, 0, base);
+    advance(ARP_TIMEOUT_SEC * 1000 + ARP_AGING_MS);
+    errors += check("arp entry aged", 0, 0, base);
+    printf(errors ? "\e[1;31mArp aging test failed, %d errors\e[0m\n" : "\e[1;32mArp aging test passed\e[0m\n", errors);
+    return errors ? -1 : 0;
+}
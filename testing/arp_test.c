@@ -25,7 +25,8 @@ int check_pcap();
 FILE* open_file(char * path, char * name, char * mode);
 void log_tab_buf();
 
-buf_t buf;
+uint8_t buf_payload[BUF_MAX_LEN];
+buf_t buf = BUF_INITIALIZER(buf_payload);
 int main(int argc, char* argv[]){
         int ret;
         printf("\e[0;34mTest begin.\n");
@@ -58,6 +59,7 @@ int main(int argc, char* argv[]){
                         uint8_t * ip = buf.data + 30;
                         // net_protocol_t pro = buf.data[13] ? NET_PROTOCOL_ARP : NET_PROTOCOL_IP;
                         arp_out(&buf2, ip);
+                        buf_free(&buf2);
                 }else{
                         ethernet_in(&buf);
                 }
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "checksum.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define BENCH_BYTES (256 * 1024 * 1024) //每个长度累计计算的字节数
+
+static uint8_t data[65536] __attribute__((aligned(64)));
+static uint8_t copy[65536] __attribute__((aligned(64)));
+
+/**
+ * @brief 读取时间戳计数器，非x86平台退化为纳秒
+ *
+ * @return uint64_t 周期数
+ */
+static uint64_t bench_cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/**
+ * @brief 测量指定长度的吞吐量
+ *
+ * @param len 每次计算的长度
+ * @param mode 0为只计算校验和，1为memcpy后计算，2为checksum_copy
+ * @return double 每周期处理的字节数
+ */
+static double bench_size(size_t len, int mode)
+{
+    size_t rounds = BENCH_BYTES / len;
+    volatile uint16_t sink = 0;
+    uint64_t start = bench_cycles();
+    for (size_t i = 0; i < rounds; i++)
+        if (mode == 0)
+            sink += checksum16((uint16_t *)data, len);
+        else if (mode == 1)
+        {
+            memcpy(copy, data, len);
+            sink += checksum16((uint16_t *)copy, len);
+        }
+        else
+            sink += checksum_fold(checksum_copy(copy, data, len));
+    (void)sink;
+    return (double)rounds * len / (bench_cycles() - start);
+}
+
+int main(int argc, char *argv[])
+{
+    static const size_t sizes[] = {20, 40, 64, 128, 256, 576, 1024, 1500, 4096, 9000, 16384, 65535};
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = i * 7;
+    printf("bytes/cycle\n%8s", "size");
+    for (checksum_impl_t impl = CHECKSUM_SCALAR; impl < CHECKSUM_IMPL_NUM; impl++)
+        if (checksum_impl_supported(impl))
+            printf(" %10s", checksum_impl_name(impl));
+    printf("\n");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        printf("%8zu", sizes[i]);
+        for (checksum_impl_t impl = CHECKSUM_SCALAR; impl < CHECKSUM_IMPL_NUM; impl++)
+            if (checksum_select(impl) == 0)
+                printf(" %10.2f", bench_size(sizes[i], 0));
+        printf("\n");
+    }
+
+    for (checksum_impl_t impl = CHECKSUM_IMPL_NUM - 1; checksum_select(impl) != 0; impl--)
+        ;
+    printf("\ncopy + checksum, %s, bytes/cycle\n%8s %12s %12s\n", checksum_impl_name(checksum_current()),
+           "size", "memcpy+sum", "fused");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        printf("%8zu %12.2f %12.2f\n", sizes[i], bench_size(sizes[i], 1), bench_size(sizes[i], 2));
+    return 0;
+}
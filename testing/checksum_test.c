@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <string.h>
+#include "checksum.h"
+
+#define TEST_MAX_LEN 65536                 //与参照实现对比的最大长度，更长时参照实现的32位累加会溢出
+#define TEST_ALIGN 16                      //测试的起始偏移数
+#define TEST_BIG_LEN (3 * 512 * 1024 + 7)  //跨越多次64位扩展的长度，只在各实现之间对比
+
+/**
+ * @brief 最初的逐字累加实现，作为参照
+ */
+static uint16_t checksum16_reference(uint16_t *data, size_t len)
+{
+    uint32_t sum = 0;
+    for (size_t i = 0; i < (len / 2); i++)
+    {
+        sum += data[i];
+    }
+    if (len & 1)
+    {
+        sum += ((uint8_t *)(data))[len - 1];
+    }
+    while (sum >> 16)
+    {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (uint16_t)(~sum);
+}
+
+static uint8_t data[TEST_BIG_LEN + TEST_ALIGN] __attribute__((aligned(64)));
+static uint8_t ref[TEST_MAX_LEN] __attribute__((aligned(64)));
+static uint8_t copy[TEST_MAX_LEN + TEST_ALIGN] __attribute__((aligned(64)));
+
+/**
+ * @brief 用指定的实现校验一种数据模式下的所有长度与偏移
+ *
+ * @param name 数据模式名称
+ * @return int 不一致的次数
+ */
+static int check_pattern(const char *name)
+{
+    int errors = 0;
+    for (size_t len = 0; len <= TEST_MAX_LEN; len += len < 1024 ? 1 : 251)
+        for (size_t off = 0; off < TEST_ALIGN; off++)
+        {
+            memcpy(ref, data + off, len); // 参照实现按字读取，需要对齐的副本
+            uint16_t expect = checksum16_reference((uint16_t *)ref, len);
+            uint16_t got = checksum16((uint16_t *)(data + off), len);
+            if (got != expect && errors++ < 10)
+                printf("\e[1;31m%s: %s len %zu offset %zu: got %04x, expect %04x\n",
+                       checksum_impl_name(checksum_current()), name, len, off, got, expect);
+            uint8_t *dst = copy + TEST_ALIGN - 1 - off % TEST_ALIGN; // 目的地址与源地址的对齐不同
+            got = ~checksum_fold(checksum_copy(dst, data + off, len));
+            if ((got != expect || memcmp(dst, ref, len)) && errors++ < 10)
+                printf("\e[1;31m%s: %s copy len %zu offset %zu: got %04x, expect %04x\n",
+                       checksum_impl_name(checksum_current()), name, len, off, got, expect);
+        }
+    checksum_impl_t impl = checksum_current();
+    checksum_select(CHECKSUM_SCALAR);
+    uint64_t expect = checksum_sum(data + 1, TEST_BIG_LEN);
+    checksum_select(impl);
+    if (checksum_sum(data + 1, TEST_BIG_LEN) != expect)
+    {
+        printf("\e[1;31m%s: %s len %d: sum differs from scalar\n", checksum_impl_name(impl), name, TEST_BIG_LEN);
+        errors++;
+    }
+    return errors;
+}
+
+/**
+ * @brief 校验分段累加与伪头部累加，与拼接后一次计算的结果对比
+ *
+ * @return int 不一致的次数
+ */
+static int check_partial()
+{
+    int errors = 0;
+    uint32_t seed = 7;
+    uint8_t ip_a[4] = {192, 168, 1, 3}, ip_b[4] = {10, 0, 0, 255};
+    for (int round = 0; round < 10000; round++)
+    {
+        size_t len = (seed = seed * 1103515245 + 12345) % 4096;
+        checksum_ctx_t ctx;
+        checksum_init(&ctx);
+        checksum_pseudo(&ctx, ip_a, ip_b, 17, len);
+        for (size_t off = 0; off < len;)
+        {
+            size_t part = (seed = seed * 1103515245 + 12345) % 97;
+            part = part < len - off ? part : len - off;
+            checksum_add(&ctx, data + 12 + off, part);
+            off += part;
+        }
+        memcpy(ref, ip_a, 4);
+        memcpy(ref + 4, ip_b, 4);
+        ref[8] = 0, ref[9] = 17, ref[10] = len >> 8, ref[11] = len & 0xFF;
+        memcpy(ref + 12, data + 12, len);
+        uint16_t expect = checksum16_reference((uint16_t *)ref, len + 12);
+        uint16_t got = checksum_finish(&ctx);
+        if (got != expect && errors++ < 10)
+            printf("\e[1;31mpartial: len %zu: got %04x, expect %04x\n", len, got, expect);
+    }
+    return errors;
+}
+
+int main(int argc, char *argv[])
+{
+    int errors = 0;
+    uint32_t seed = 1;
+    for (checksum_impl_t impl = CHECKSUM_SCALAR; impl < CHECKSUM_IMPL_NUM; impl++)
+    {
+        if (checksum_select(impl) != 0)
+        {
+            printf("\e[0;33m%s: not supported, skipped\n", checksum_impl_name(impl));
+            continue;
+        }
+        for (size_t i = 0; i < sizeof(data); i++)
+            data[i] = (seed = seed * 1103515245 + 12345) >> 16;
+        errors += check_pattern("random");
+        memset(data, 0xFF, sizeof(data)); // 每个字都是最大值，检验进位折叠
+        errors += check_pattern("all-ones");
+        memset(data, 0, sizeof(data));
+        errors += check_pattern("zero");
+        for (size_t i = 0; i < sizeof(data); i++)
+            data[i] = (seed = seed * 1103515245 + 12345) >> 16;
+        errors += check_partial();
+        printf("\e[0;34m%s: checked\n", checksum_impl_name(impl));
+    }
+    printf(errors ? "\e[1;31mChecksum test failed, %d mismatches\e[0m\n" : "\e[1;32mChecksum test passed\e[0m\n", errors);
+    return errors ? -1 : 0;
+}
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <string.h>
+#include <pcap.h>
+#include "net.h"
+#include "map.h"
+#include "driver.h"
+#include "ethernet.h"
+#include "ip.h"
+#include "udp.h"
+
+#define TEST_OUT "csum_offload.pcap" //驱动写出的帧，位于运行目录
+#define TEST_FRAMES 16               //每种模式最多记录的ip帧数
+#define TEST_PORT 6000               //收发双方的udp端口
+
+static const uint8_t peer_ip[NET_IP_LEN] = {192, 168, 163, 10};
+static const uint8_t peer_mac[NET_MAC_LEN] = {0x21, 0x32, 0x43, 0x54, 0x65, 0x06};
+static const uint16_t lens[] = {BUF_COPYBREAK / 2, BUF_COPYBREAK * 4, ETHERNET_MAX_TRANSPORT_UNIT * 2}; // 拷贝、链式、分片
+static uint8_t payload[ETHERNET_MAX_TRANSPORT_UNIT * 2];
+static uint8_t frames[2 * TEST_FRAMES][ETHERNET_MAX_TRANSPORT_UNIT + sizeof(ether_hdr_t)]; // 先卸载、后软件
+static size_t frame_lens[2 * TEST_FRAMES];
+
+extern FILE *pcap_in;
+extern FILE *pcap_out;
+extern FILE *control_flow;
+extern int faker_caps;
+
+/**
+ * @brief 发送每种长度的udp数据报各一个
+ *
+ */
+static void test_send()
+{
+    for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++)
+        udp_send(payload, lens[i], TEST_PORT, (uint8_t *)peer_ip, TEST_PORT);
+}
+
+/**
+ * @brief 读回驱动写出的ip帧，前一半是卸载时发出的，后一半是关闭卸载后发出的
+ *
+ * @return int 每种模式的帧数，失败为-1
+ */
+static int test_read()
+{
+    char errbuf[PCAP_ERRBUF_SIZE];
+    FILE *f = fopen(TEST_OUT, "rb");
+    pcap_t *pcap = f ? pcap_fopen_offline(f, errbuf) : NULL;
+    if (pcap == NULL)
+    {
+        if (f)
+            fclose(f);
+        return -1;
+    }
+    struct pcap_pkthdr *hdr;
+    const uint8_t *data;
+    int n = 0;
+    while (pcap_next_ex(pcap, &hdr, &data) == 1)
+    {
+        if (hdr->len < sizeof(ether_hdr_t) || swap16(((ether_hdr_t *)data)->protocol16) != NET_PROTOCOL_IP)
+            continue; // 打开网卡时的arp宣告
+        if (n >= 2 * TEST_FRAMES || hdr->len > sizeof(frames[0]))
+        {
+            n = -1;
+            break;
+        }
+        memcpy(frames[n], data, hdr->len);
+        frame_lens[n] = hdr->len;
+        n++;
+    }
+    pcap_close(pcap);
+    return n < 0 || n % 2 ? -1 : n / 2;
+}
+
+/**
+ * @brief 检查网卡声明发送校验和卸载时，udp只填写伪头部并由驱动补全校验和，
+ *        发出的帧与关闭卸载、由软件计算校验和时相同，分片的数据报也由软件补全
+ *        两种模式的ip标识不同，只比较ip头部之后的内容
+ *
+ */
+int main(int argc, char *argv[])
+{
+    // 没有输入的帧，只需一个合法的pcap文件头
+    static const uint32_t header[] = {0xa1b2c3d4, 0x00040002, 0, 0, 65535, 1};
+    int errors = 0;
+    pcap_in = tmpfile();
+    pcap_out = fopen(TEST_OUT, "wb");
+    control_flow = tmpfile();
+    if (pcap_in == NULL || pcap_out == NULL || control_flow == NULL)
+    {
+        printf("\e[1;31mFailed to open files\e[0m\n");
+        return -1;
+    }
+    fwrite(header, sizeof(header), 1, pcap_in);
+    rewind(pcap_in);
+    for (size_t i = 0; i < sizeof(payload); i++)
+        payload[i] = i * 7 + 1;
+    faker_caps = NET_CAP_TX_CSUM;
+    if (net_init() != 0)
+        return -1;
+    if (!(net_stack->if_caps & NET_CAP_TX_CSUM) && ++errors)
+        printf("\e[1;31mtx checksum offload not enabled\n");
+    map_set(&net_stack->arp_table, peer_ip, peer_mac);
+    test_send();
+    net_stack->if_caps = 0; // 清零关闭卸载，同样的数据报改由软件计算校验和
+    test_send();
+    driver_close();
+    fclose(control_flow);
+
+    int n = test_read();
+    if (n <= 0)
+    {
+        printf("\e[1;31mFailed to read %s\e[0m\n", TEST_OUT);
+        return -1;
+    }
+    size_t skip = sizeof(ether_hdr_t) + sizeof(ip_hdr_t);
+    for (int i = 0; i < n; i++)
+    {
+        uint8_t *on = frames[i], *off = frames[i + n];
+        size_t len = frame_lens[i];
+        if ((len != frame_lens[i + n] || len < skip || memcmp(on + skip, off + skip, len - skip)) && ++errors)
+            printf("\e[1;31mframe %d: offloaded checksum differs from software\n", i);
+    }
+    printf(errors ? "\e[1;31mChecksum offload test failed, %d errors\e[0m\n" : "\e[1;32mChecksum offload test passed\e[0m\n", errors);
+    return errors ? -1 : 0;
+}
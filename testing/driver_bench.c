@@ -0,0 +1,223 @@
+#define _GNU_SOURCE // sendmmsg
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include "net.h"
+#include "driver.h"
+#include "ethernet.h"
+
+#define BENCH_FRAME_LEN 60     //每帧的长度，以太网最小帧
+#define BENCH_PROTOCOL 0x88B5  //帧的协议类型，本地实验用，两端内核都直接丢弃
+#define BENCH_SEC 2.0          //每个后端收与发各自的测量时长（秒）
+
+static const char *bench_default_peer; // 未指定对端的后端所用的veth对端
+static const char *bench_peer;  // 对端的网卡名，接收测试时由它发出帧，发送测试时统计它收到的帧
+static uint8_t bench_mac[NET_MAC_LEN]; // 本机MAC，发包线程不在协议栈实例中运行
+static int bench_running;
+static uint64_t bench_generated;
+
+/**
+ * @brief 获取单调时钟的秒数
+ *
+ * @return double 秒数
+ */
+static double bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief 读取网卡的一项统计
+ *
+ * @param if_name 网卡名
+ * @param name 统计项，如rx_packets
+ * @return uint64_t 统计值，读取失败为0
+ */
+static uint64_t bench_if_stat(const char *if_name, const char *name)
+{
+    char path[128];
+    unsigned long long value = 0;
+    snprintf(path, sizeof(path), "/sys/class/net/%s/statistics/%s", if_name, name);
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return 0;
+    if (fscanf(fp, "%llu", &value) != 1)
+        value = 0;
+    fclose(fp);
+    return value;
+}
+
+/**
+ * @brief 构造一帧
+ *
+ * @param frame 输出的帧
+ * @param dst 目的MAC
+ * @param src 源MAC
+ */
+static void bench_frame(uint8_t *frame, const uint8_t *dst, const uint8_t *src)
+{
+    ether_hdr_t *eth = (ether_hdr_t *)frame;
+    memset(frame, 0, BENCH_FRAME_LEN);
+    memcpy(eth->dst, dst, NET_MAC_LEN);
+    memcpy(eth->src, src, NET_MAC_LEN);
+    eth->protocol16 = swap16(BENCH_PROTOCOL);
+}
+
+/**
+ * @brief 发包线程：从对端网卡尽快发出发往本机MAC的帧，直到bench_running清零
+ *
+ * @param arg 未使用
+ * @return void* 总是NULL
+ */
+static void *bench_generator(void *arg)
+{
+    static const uint8_t src[NET_MAC_LEN] = {0x02, 0x42, 0x42, 0x42, 0x42, 0x42};
+    uint8_t frame[BENCH_FRAME_LEN];
+    bench_frame(frame, bench_mac, src);
+    int fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    struct sockaddr_ll addr = {.sll_family = AF_PACKET, .sll_ifindex = if_nametoindex(bench_peer)};
+    if (fd == -1 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        fprintf(stderr, "Error in bench_generator: %s: %s\n", bench_peer, strerror(errno));
+        return NULL;
+    }
+    struct iovec iov = {.iov_base = frame, .iov_len = sizeof(frame)};
+    struct mmsghdr msgs[NET_BURST];
+    for (int i = 0; i < NET_BURST; i++)
+        msgs[i] = (struct mmsghdr){.msg_hdr = {.msg_iov = &iov, .msg_iovlen = 1}};
+    while (__atomic_load_n(&bench_running, __ATOMIC_ACQUIRE))
+    {
+        int n = sendmmsg(fd, msgs, NET_BURST, 0);
+        if (n > 0)
+            __atomic_add_fetch(&bench_generated, n, __ATOMIC_RELAXED);
+        sched_yield(); // 与收包线程共用CPU时每组之后让出，测的是每包的开销而不是时间片内积压能否放进环
+    }
+    close(fd);
+    return NULL;
+}
+
+/**
+ * @brief 接收测试：对端持续发帧BENCH_SEC秒，测量后端每秒收到的帧数
+ *
+ * @param generated 出口参数，对端发出的帧数
+ * @return double 每秒收到的帧数
+ */
+static double bench_rx(uint64_t *generated)
+{
+    pthread_t generator;
+    buf_t bufs[NET_BURST];
+    uint64_t received = 0;
+    memcpy(bench_mac, net_stack->if_mac, NET_MAC_LEN);
+    bench_running = 1;
+    if (pthread_create(&generator, NULL, bench_generator, NULL) != 0)
+        return 0;
+    double start = bench_now(), elapsed;
+    while ((elapsed = bench_now() - start) < BENCH_SEC)
+    {
+        int n = driver_recv_burst(bufs, NET_BURST);
+        for (int i = 0; i < n; i++)
+            buf_free(&bufs[i]);
+        if (n <= 0)
+            sched_yield();
+        received += n > 0 ? n : 0;
+    }
+    __atomic_store_n(&bench_running, 0, __ATOMIC_RELEASE);
+    pthread_join(generator, NULL);
+    for (int n; (n = driver_recv_burst(bufs, NET_BURST)) > 0;) // 交还最后一批借出的内存
+        for (int i = 0; i < n; i++)
+            buf_free(&bufs[i]);
+    *generated = bench_generated;
+    return received / elapsed;
+}
+
+/**
+ * @brief 发送测试：连续按组发送BENCH_SEC秒，测量后端每秒接受的帧数与对端每秒实际收到的帧数
+ *
+ * @param delivered 出口参数，对端每秒收到的帧数
+ * @return double 每秒接受的帧数
+ */
+static double bench_tx(double *delivered)
+{
+    static const uint8_t broadcast[NET_MAC_LEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    buf_t buf, *bufs[NET_BURST];
+    if (buf_alloc(&buf, BENCH_FRAME_LEN) == -1)
+        return 0;
+    bench_frame(buf.data, broadcast, net_stack->if_mac);
+    for (int i = 0; i < NET_BURST; i++)
+        bufs[i] = &buf;
+    uint64_t sent = 0, peer = bench_if_stat(bench_peer, "rx_packets");
+    double start = bench_now(), elapsed;
+    while ((elapsed = bench_now() - start) < BENCH_SEC)
+    {
+        sent += driver_send_burst(bufs, NET_BURST);
+        driver_flush();
+    }
+    usleep(100000); // 等对端处理完在途的帧
+    *delivered = (bench_if_stat(bench_peer, "rx_packets") - peer) / elapsed;
+    buf_free(&buf);
+    return sent / elapsed;
+}
+
+/**
+ * @brief 在子进程中测量一个后端，每个后端使用新的协议栈与网卡，退出时卸下后端的全部资源
+ *
+ * @param spec 后端名，可用"后端名:网卡名"指定该后端的对端，如tap后端的对端是内核一侧的tap网卡
+ */
+static void bench_run(const char *spec)
+{
+    char name[32];
+    const char *peer = strchr(spec, ':');
+    snprintf(name, sizeof(name), "%.*s", peer ? (int)(peer - spec) : (int)strlen(spec), spec);
+    bench_peer = peer ? peer + 1 : bench_default_peer;
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        if (driver_select(name) != 0 || net_init() != 0)
+            _exit(1);
+        uint64_t generated;
+        double delivered, rx = bench_rx(&generated), tx = bench_tx(&delivered);
+        printf("%-12s %12.0f %12.0f %12.0f %12.0f\n", name, rx, generated / BENCH_SEC, tx, delivered);
+        driver_close();
+        fflush(stdout);
+        _exit(0);
+    }
+    int status;
+    if (pid == -1 || waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        printf("%-12s %12s\n", name, "skipped");
+}
+
+int main(int argc, char const *argv[])
+{
+    static const char *defaults[] = {"pcap", "packet", "xdp", "tap:" DRIVER_TAP_NAME, "uring-packet", "uring-tap:" DRIVER_TAP_NAME};
+    if (argc < 2)
+    {
+        printf("usage: %s <peer-interface> [backend[:peer-interface]...]\n"
+               "the backends open the interface matching NET_IF_IP (or DRIVER_IF_NAME), "
+               "which should be the veth peer of <peer-interface>; needs root\n",
+               argv[0]);
+        return -1;
+    }
+    bench_default_peer = argv[1];
+    printf("%d byte frames, %.1fs each, peer %s\n", BENCH_FRAME_LEN, BENCH_SEC, bench_default_peer);
+    printf("%-12s %12s %12s %12s %12s\n", "backend", "rx pps", "offered pps", "tx pps", "peer rx pps");
+    if (argc > 2)
+        for (int i = 2; i < argc; i++)
+            bench_run(argv[i]);
+    else
+        for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++)
+            bench_run(defaults[i]);
+    return 0;
+}
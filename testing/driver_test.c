@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <string.h>
+#include "net.h"
+#include "driver.h"
+#include "ethernet.h"
+
+#define TEST_BURST 3 //定时器在一次net_poll中发送的帧数
+
+static int test_sent;    // 后端收到的帧数
+static int test_flushed; // 后端被通知发送的次数
+static int test_pending; // 暂存、尚未通知发送的帧数
+
+//暂存发送的帧，flush时才算发出，模拟按批通知网卡的后端
+static int test_open()
+{
+    static int dev;
+    net_stack->driver = &dev;
+    return 0;
+}
+static int test_recv_burst(buf_t *bufs, int n) { return 0; }
+static int test_send_burst(buf_t **bufs, int n)
+{
+    test_sent += n;
+    test_pending += n;
+    return n;
+}
+static void test_flush()
+{
+    test_flushed++;
+    test_pending = 0;
+}
+static int test_get_fd() { return -1; }
+static int test_caps() { return 0; }
+static int test_mtu() { return ETHERNET_MAX_TRANSPORT_UNIT; }
+static void test_close() { net_stack->driver = NULL; }
+
+static const driver_ops_t test_driver = {
+    .name = "test",
+    .open = test_open,
+    .recv_burst = test_recv_burst,
+    .send_burst = test_send_burst,
+    .flush = test_flush,
+    .get_fd = test_get_fd,
+    .caps = test_caps,
+    .mtu = test_mtu,
+    .close = test_close,
+};
+
+/**
+ * @brief 发送一个最短的以太网帧
+ *
+ * @return int 成功为0，失败为-1
+ */
+static int test_send()
+{
+    buf_t *buf = &net_stack->txbuf;
+    buf_init(buf, ETHERNET_MIN_TRANSPORT_UNIT);
+    memset(buf->data, 0, buf->len);
+    return driver_send(buf);
+}
+
+/**
+ * @brief 定时器回调，在net_poll中连续发送TEST_BURST帧
+ *
+ */
+static void test_timer(void *arg)
+{
+    for (int i = 0; i < TEST_BURST; i++)
+        test_send();
+}
+
+/**
+ * @brief 检查net_poll之外发送的帧立即通知网卡，net_poll中发送的帧在返回前一起通知
+ *
+ * @return int 错误数
+ */
+static int check_flush()
+{
+    int errors = 0;
+    test_sent = test_flushed = 0;
+    test_send();
+    if ((test_sent != 1 || test_pending != 0 || test_flushed != 1) && ++errors)
+        printf("\e[1;31mflush: outside net_poll, %d sent, %d pending, %d flushes\n", test_sent, test_pending, test_flushed);
+    test_sent = test_flushed = 0;
+    net_timer_add(0, 0, test_timer, NULL);
+    net_poll();
+    if ((test_sent != TEST_BURST || test_pending != 0 || test_flushed != 1) && ++errors)
+        printf("\e[1;31mflush: in net_poll, %d sent, %d pending, %d flushes\n", test_sent, test_pending, test_flushed);
+    printf("\e[0;34mflush: checked\n");
+    return errors;
+}
+
+/**
+ * @brief 检查按名选择内存网卡：未知的名字失败且不改变选择，选中后帧经发送与接收往返不变，网卡打开后不能再选择
+ *
+ * @return int 错误数
+ */
+static int check_memory()
+{
+    int errors = 0;
+    uint8_t frame[ETHERNET_MIN_TRANSPORT_UNIT + sizeof(ether_hdr_t)], out[sizeof(frame)];
+    net_stack_t *current = net_stack, *stack = net_stack_create(current->if_mac, current->if_ip);
+    if (stack == NULL)
+        return 1;
+    net_stack_enter(stack);
+    for (size_t i = 0; i < sizeof(frame); i++)
+        frame[i] = i;
+    if ((driver_select("no-such-driver") != -1 || net_stack->driver_ops != NULL) && ++errors)
+        printf("\e[1;31mmemory: unknown backend selected\n");
+    if ((driver_lookup("memory") != &driver_memory || driver_select("memory") != 0 || strcmp(driver_name(), "memory")) && ++errors)
+        printf("\e[1;31mmemory: backend not selected by name\n");
+    if (errors || net_init() != 0)
+    {
+        net_stack_destroy(stack);
+        net_stack_enter(current);
+        return errors + 1;
+    }
+    while (driver_memory_take(net_stack, out, sizeof(out))) // 打开时发出的arp宣告
+        ;
+    buf_t *buf = &net_stack->txbuf;
+    buf_init(buf, sizeof(frame));
+    memcpy(buf->data, frame, sizeof(frame));
+    if ((driver_send(buf) != 0 || driver_memory_take(net_stack, out, sizeof(out)) != sizeof(frame) ||
+         memcmp(out, frame, sizeof(frame))) && ++errors)
+        printf("\e[1;31mmemory: sent frame not taken back intact\n");
+    buf_t rx;
+    if (driver_memory_inject(net_stack, frame, sizeof(frame)) != 0 || driver_recv_burst(&rx, 1) != 1)
+    {
+        printf("\e[1;31mmemory: injected frame not received\n");
+        errors++;
+    }
+    else
+    {
+        if ((rx.len != sizeof(frame) || memcmp(rx.data, frame, sizeof(frame))) && ++errors)
+            printf("\e[1;31mmemory: received frame differs\n");
+        buf_free(&rx);
+    }
+    if (driver_recv_burst(&rx, 1) != 0 && ++errors)
+        printf("\e[1;31mmemory: frame received twice\n");
+    if ((driver_select("memory") != -1 || net_stack->driver_ops != &driver_memory) && ++errors)
+        printf("\e[1;31mmemory: backend changed after open\n");
+    net_stack_destroy(stack);
+    net_stack_enter(current);
+    printf("\e[0;34mmemory: checked\n");
+    return errors;
+}
+
+int main(int argc, char *argv[])
+{
+    net_stack->driver_ops = &test_driver;
+    if (net_init() != 0)
+        return -1;
+    int errors = check_flush() + check_memory();
+    driver_close();
+    printf(errors ? "\e[1;31mDriver test failed, %d errors\e[0m\n" : "\e[1;32mDriver test passed\e[0m\n", errors);
+    return errors ? -1 : 0;
+}
@@ -13,7 +13,8 @@ extern FILE *out_log;
 int check_log();
 FILE* open_file(char * path, char * name, char * mode);
 
-buf_t buf;
+uint8_t buf_payload[BUF_MAX_LEN];
+buf_t buf = BUF_INITIALIZER(buf_payload);
 int main(int argc, char* argv[]){
         int ret;
         pcap_in = open_file(argv[1], "in.pcap", "r");
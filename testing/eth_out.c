@@ -15,7 +15,8 @@ int check_pcap();
 char* print_mac(uint8_t *mac);
 FILE* open_file(char * path, char * name, char * mode);
 
-buf_t buf,buf2;
+uint8_t buf_payload[BUF_MAX_LEN];
+buf_t buf = BUF_INITIALIZER(buf_payload), buf2;
 int main(int argc, char* argv[]){
         int ret;
         pcap_in = open_file(argv[1], "in.pcap","r");
@@ -43,6 +44,7 @@ int main(int argc, char* argv[]){
                 proto <<= 8;
                 proto |= buf2.data[13];
                 ethernet_out(&buf,buf2.data,proto);
+                buf_free(&buf2);
         }
         if(ret < 0){
                 fprintf(stderr,"\e[1;31m\nError occur on loading input,exiting\n");
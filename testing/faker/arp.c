@@ -11,9 +11,6 @@ char* print_ip(uint8_t *ip);
 char* print_mac(uint8_t *mac);
 void fprint_buf(FILE* f, buf_t* buf);
 
-map_t arp_table;
-map_t arp_buf;
-
 // void arp_update(uint8_t *ip, uint8_t *mac, arp_state_t state)
 // {
 //         fprintf(arp_fout,"arp update:\t");
@@ -38,7 +35,8 @@ void arp_out(buf_t *buf, uint8_t *ip)
 
 void arp_init()
 {
-    map_init(&arp_table, NET_IP_LEN, NET_MAC_LEN, 0, ARP_TIMEOUT_SEC, NULL);
-    map_init(&arp_buf, NET_IP_LEN, sizeof(buf_t), 0, ARP_MIN_INTERVAL, buf_copy);
+    map_init(&net_stack->arp_table, NET_IP_LEN, NET_MAC_LEN, 0, ARP_TIMEOUT_SEC, NULL, NULL);
+    map_set_policy(&net_stack->arp_table, MAP_EVICT_LRU);
+    map_init(&net_stack->arp_buf, NET_IP_LEN, sizeof(buf_t), 0, ARP_MIN_INTERVAL, buf_copy, buf_free);
     net_add_protocol(NET_PROTOCOL_ARP, arp_in);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <utils.h>
 #include "config.h"
 #include "buf.h"
+#include "net.h"
 
 static pcap_t *pcap;
 static pcap_dumper_t *pdump;
@@ -11,6 +12,8 @@ extern FILE* pcap_in;
 extern FILE* pcap_out;
 extern FILE *control_flow;
 
+int faker_caps = 0; // 模拟的网卡卸载能力，默认没有，使对比日志的测试走软件校验和
+
 #ifdef _WIN32
 #include <tchar.h>
 BOOL LoadNpcapDlls()
@@ -77,16 +80,62 @@ int driver_recv(buf_t *buf)
         }
 }
 
+int driver_recv_burst(buf_t *bufs, int n)
+{
+        int i = 0;
+        while (i < n){
+                struct pcap_pkthdr *pkt_hdr;
+                const uint8_t *pkt_data;
+                int ret = pcap_next_ex(pcap, &pkt_hdr, &pkt_data);
+                if (ret == PCAP_ERROR_BREAK){
+                        break;
+                }else if (ret != 1){
+                        fprintf(stderr, "Error in driver_recv_burst: %s\n", pcap_geterr(pcap));
+                        return i ? i : -1;
+                }
+                if (buf_alloc(&bufs[i], pkt_hdr->len) == -1)
+                        continue;
+                memcpy(bufs[i].data, pkt_data, pkt_hdr->len);
+                i++;
+        }
+        return i;
+}
+
 int driver_send(buf_t *buf)
 {
+        static uint8_t frame[BUF_MTU_SIZE];
         struct pcap_pkthdr header;
         memset(&header.ts,0,sizeof(header.ts));
-        header.caplen = buf->len;
-        header.len = buf->len;
-        pcap_dump((u_char *)pdump,&header,buf->data);
+        header.caplen = buf_chain_len(buf);
+        header.len = header.caplen;
+        if(buf->next || buf->csum == BUF_CSUM_PARTIAL){
+                buf_gather_complete(buf, frame);
+                pcap_dump((u_char *)pdump,&header,frame);
+        }else{
+                pcap_dump((u_char *)pdump,&header,buf->data);
+        }
         return 0;
 }
 
+int driver_caps()
+{
+        return faker_caps;
+}
+
+void driver_flush()
+{
+}
+
+int driver_mtu()
+{
+        return ETHERNET_MAX_TRANSPORT_UNIT;
+}
+
+int driver_get_fd()
+{
+        return -1;
+}
+
 void driver_close()
 {
         fprintf(control_flow,"\ndriver closed\n");
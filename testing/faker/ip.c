@@ -40,4 +40,9 @@ void ip_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol)
 void ip_init()
 {
     net_add_protocol(NET_PROTOCOL_IP, ip_in);
-}
\ No newline at end of file
+}
+void ip_in_burst(buf_t **bufs, uint8_t **src_macs, int n)
+{
+        for (int i = 0; i < n; i++)
+                ip_in(bufs[i], src_macs[i]);
+}
@@ -19,7 +19,7 @@ void udp_out(buf_t *buf, uint16_t src_port, uint8_t *dest_ip, uint16_t dest_port
 
 void udp_init()
 {
-//     map_init(&udp_table, sizeof(uint16_t), sizeof(udp_handler_t), 0, 0, NULL);
+//     map_init(&udp_table, sizeof(uint16_t), sizeof(udp_handler_t), 0, 0, NULL, NULL);
     net_add_protocol(NET_PROTOCOL_UDP, udp_in);
 }
 
@@ -56,4 +56,9 @@ void udp_in(buf_t *buf, uint8_t *src_ip)
 {
         fprintf(udp_fout,"udp_in:\n\tsrc_ip:%s\n",print_ip(src_ip));
         fprint_buf(udp_fout, buf);
-}
\ No newline at end of file
+}
+void udp_in_burst(buf_t **bufs, uint8_t **src_ips, int n)
+{
+        for (int i = 0; i < n; i++)
+                udp_in(bufs[i], src_ips[i]);
+}
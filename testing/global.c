@@ -29,9 +29,6 @@ FILE *udp_fout;
 FILE *out_log;
 FILE *demo_log;
 
-extern map_t arp_table;
-extern map_t arp_buf;
-
 // char* state[16] = {
 //         [ARP_PENDING] "pending",
 //         [ARP_VALID]   "valid  ",
@@ -127,50 +124,36 @@ void fprint_buf(FILE* f, buf_t* buf)
         if(buf == 0){
                 fprintf(f,"(null)\n");
         }else{
-                for(int i = 0; i < buf->len; i++){
-                        fprintf(f," %02x",buf->data[i]);
+                for(; buf; buf = buf->next){
+                        for(int i = 0; i < buf->len; i++){
+                                fprintf(f," %02x",buf->data[i]);
+                        }
                 }
                 fprintf(f,"\n");
         }
 }
 
-static inline void *map_entry_get(map_t *map, size_t pos)
+static void log_arp_entry(void *ip, void *mac, time_t *timestamp)
 {
-        if (pos >= map->max_size)
-                return NULL;
-        return map->data + pos * (map->key_len + map->value_len + sizeof(time_t));
+        fprintf(arp_log_f, "%s -> %s\n", print_ip(ip), print_mac(mac));
 }
 
-static inline int map_entry_valid(map_t *map, const void *entry)
+static void log_buf_entry(void *ip, void *value, time_t *timestamp)
 {
-        time_t entry_time = *(time_t *)((uint8_t *)entry + map->key_len + map->value_len);
-        return entry_time && (!map->timeout || entry_time + map->timeout >= time(NULL));
+        buf_t * buf = (buf_t*) value;
+        fprintf(arp_log_f, "%s -> ", print_ip(ip));
+        for(int i = 0; i < buf->len; i++){
+                fprintf(arp_log_f," %02x",buf->data[i]);
+        }
+        fputc('\n', arp_log_f);
 }
 
 void log_tab_buf(){
         fprintf(arp_log_f, "<====== arp table =======>\n");
-        for (size_t i = 0; i < arp_table.max_size; i++)
-        {
-                uint8_t *entry = (uint8_t*) map_entry_get(&arp_table, i);
-                if (map_entry_valid(&arp_table, entry))
-                        fprintf(arp_log_f, "%s -> %s\n",
-                                print_ip(entry),
-                                print_mac(entry + arp_table.key_len));
-        }
+        map_foreach(&net_stack->arp_table, log_arp_entry);
 
         fprintf(arp_log_f, "<====== arp buf =======>\n");
-        for (size_t i = 0; i < arp_buf.max_size; i++)
-        {
-                uint8_t *entry = (uint8_t*) map_entry_get(&arp_buf, i);
-                if (map_entry_valid(&arp_buf, entry)) {
-                        fprintf(arp_log_f, "%s -> ", print_ip(entry));
-                        buf_t * buf = (buf_t*) (entry + arp_buf.key_len);
-                        for(int i = 0; i < buf->len; i++){
-                                fprintf(arp_log_f," %02x",buf->data[i]);
-                        }
-                        fputc('\n', arp_log_f);
-                }
-        }
+        map_foreach(&net_stack->arp_buf, log_buf_entry);
 }
 
 
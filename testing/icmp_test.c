@@ -26,7 +26,8 @@ FILE* open_file(char * path, char * name, char * mode);
 
 void log_tab_buf();
 
-buf_t buf;
+uint8_t buf_payload[BUF_MAX_LEN];
+buf_t buf = BUF_INITIALIZER(buf_payload);
 int main(int argc, char* argv[]){
         int ret;
         printf("\e[0;34mTest begin.\n");
@@ -61,6 +62,7 @@ int main(int argc, char* argv[]){
                         memset(buf2.data,0,sizeof(len));
                         buf_remove_header(&buf2, len);
                         ip_out(&buf2,ip,pro);
+                        buf_free(&buf2);
                 }else{
                         ethernet_in(&buf);
                 }
@@ -10,7 +10,8 @@ extern FILE *arp_fout;
 
 FILE* open_file(char * path, char * name, char * mode);
 
-buf_t buf;
+uint8_t buf_payload[BUF_MAX_LEN];
+buf_t buf = BUF_INITIALIZER(buf_payload);
 int main(int argc, char* argv[])
 {
         FILE *in = open_file(argv[1], "in.txt","r");
@@ -31,7 +32,7 @@ int main(int argc, char* argv[])
                 buf.len++;
         }
         printf("\e[0;34mFeeding input.\n");
-        ip_out(&buf,net_if_ip,NET_PROTOCOL_TCP);
+        ip_out(&buf,net_stack->if_ip,NET_PROTOCOL_TCP);
 
         fclose(in);
         fclose(control_flow);
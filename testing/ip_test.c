@@ -28,7 +28,8 @@ int check_pcap();
 void log_tab_buf();
 FILE* open_file(char * path, char * name, char * mode);
 
-buf_t buf;
+uint8_t buf_payload[BUF_MAX_LEN];
+buf_t buf = BUF_INITIALIZER(buf_payload);
 int main(int argc, char* argv[]){
         int ret;
         printf("\e[0;34mTest begin.\n");
@@ -66,6 +67,7 @@ int main(int argc, char* argv[]){
                         buf_remove_header(&buf2, len);
                         // printf("ip_out: hd_len:%d\tip:%s\tpro:%d\n",len,print_ip(ip),pro);
                         ip_out(&buf2,ip,pro);
+                        buf_free(&buf2);
                 }else{
                         ethernet_in(&buf);
                 }
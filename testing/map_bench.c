@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "map.h"
+#include "net.h"
+
+#define BENCH_LOOKUPS 1000000               //每个装载率下的查找次数
+#define BENCH_BATCH_ENTRIES (1 << 20)       //批量查找测试的表大小，远超缓存以体现预取效果
+#define BENCH_BATCH_BUDGET (64 * 1024 * 1024) //批量查找测试的内存预算
+
+static map_t bench_map;
+
+/**
+ * @brief 获取单调时钟的纳秒数
+ *
+ * @return double 纳秒数
+ */
+static double bench_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief 生成第i个键，模拟同一网段内的IP地址
+ *
+ * @param i 序号
+ * @param key 输出的4字节键
+ */
+static void bench_key(uint32_t i, uint8_t *key)
+{
+    key[0] = 10;
+    key[1] = i >> 16;
+    key[2] = i >> 8;
+    key[3] = i;
+}
+
+/**
+ * @brief 测量查找n次的平均耗时
+ *
+ * @param fill 表中已有的键数
+ * @param miss 为1则查找不存在的键
+ * @param typed 为1则使用map32特化版本查找
+ * @return double 每次查找的纳秒数
+ */
+static double bench_lookup(size_t fill, int miss, int typed)
+{
+    uint8_t key[NET_IP_LEN];
+    volatile uintptr_t sink = 0;
+    double start = bench_now_ns();
+    for (uint32_t i = 0; i < BENCH_LOOKUPS; i++)
+    {
+        bench_key(miss ? fill + i % fill : i % fill, key);
+        sink += (uintptr_t)(typed ? map32_get(&bench_map, map32_key(key)) : map_get(&bench_map, key));
+    }
+    (void)sink;
+    return (bench_now_ns() - start) / BENCH_LOOKUPS;
+}
+
+/**
+ * @brief 测量随机顺序下逐个查找与按突发批量查找的平均耗时
+ *
+ * @param burst 每批的键数，为0则逐个调用map_get
+ * @param keys 预先生成的随机键
+ * @return double 每次查找的纳秒数
+ */
+static double bench_batch(size_t burst, uint8_t (*keys)[NET_IP_LEN])
+{
+    const void *ptrs[MAP_BATCH_MAX];
+    void *values[MAP_BATCH_MAX];
+    volatile size_t sink = 0;
+    double start = bench_now_ns();
+    if (burst == 0)
+        for (size_t i = 0; i < BENCH_LOOKUPS; i++)
+            sink += map_get(&bench_map, keys[i]) != NULL;
+    else
+        for (size_t i = 0; i + burst <= BENCH_LOOKUPS; i += burst)
+        {
+            for (size_t j = 0; j < burst; j++)
+                ptrs[j] = keys[i + j];
+            sink += map_get_batch(&bench_map, ptrs, burst, values);
+        }
+    (void)sink;
+    return (bench_now_ns() - start) / BENCH_LOOKUPS;
+}
+
+int main(int argc, char *argv[])
+{
+    static const int fills[] = {1, 10, 25, 50, 75, 90, 100};
+    uint8_t key[NET_IP_LEN];
+    uint8_t value[NET_MAC_LEN] = {0};
+
+    map_init(&bench_map, NET_IP_LEN, NET_MAC_LEN, 0, 0, NULL, NULL);
+    printf("key %d bytes, value %d bytes, max size %zu\n", NET_IP_LEN, NET_MAC_LEN, bench_map.max_size);
+    printf("%8s %10s %12s %12s %12s %12s %12s\n", "fill(%)", "entries", "memory(KB)",
+           "hit(ns)", "miss(ns)", "map32 hit", "map32 miss");
+    for (size_t i = 0; i < sizeof(fills) / sizeof(fills[0]); i++)
+    {
+        size_t n = bench_map.max_size * fills[i] / 100;
+        if (n == 0)
+            n = 1;
+        for (uint32_t k = map_size(&bench_map); k < n; k++)
+        {
+            bench_key(k, key);
+            if (map_set(&bench_map, key, value) != 0)
+            {
+                fprintf(stderr, "Error in map_bench: map_set failed at %u\n", k);
+                return -1;
+            }
+        }
+        printf("%8d %10zu %12zu %12.1f %12.1f %12.1f %12.1f\n", fills[i], n, map_memory(&bench_map) / 1024,
+               bench_lookup(n, 0, 0), bench_lookup(n, 1, 0), bench_lookup(n, 0, 1), bench_lookup(n, 1, 1));
+    }
+    map_free(&bench_map);
+
+    static const size_t bursts[] = {0, 16, 32, 64};
+    static uint8_t keys[BENCH_LOOKUPS][NET_IP_LEN];
+    uint32_t seed = 1;
+    map_set_budget(&bench_map, BENCH_BATCH_BUDGET);
+    for (uint32_t k = 0; k < BENCH_BATCH_ENTRIES; k++)
+    {
+        bench_key(k, key);
+        if (map_set(&bench_map, key, value) != 0)
+        {
+            fprintf(stderr, "Error in map_bench: map_set failed at %u\n", k);
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < BENCH_LOOKUPS; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        bench_key((seed >> 8) % BENCH_BATCH_ENTRIES, keys[i]);
+    }
+    printf("\nrandom hits over %d entries, memory %zu KB\n", BENCH_BATCH_ENTRIES, map_memory(&bench_map) / 1024);
+    printf("%8s %12s\n", "burst", "lookup(ns)");
+    for (size_t i = 0; i < sizeof(bursts) / sizeof(bursts[0]); i++)
+    {
+        if (bursts[i])
+            printf("%8zu %12.1f\n", bursts[i], bench_batch(bursts[i], keys));
+        else
+            printf("%8s %12.1f\n", "single", bench_batch(0, keys));
+    }
+    map_free(&bench_map);
+    return 0;
+}
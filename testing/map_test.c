@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <string.h>
+#include "map.h"
+
+#define TEST_KEYS 8    //每轮插入的键数，等于容量，使删除留下的墓碑很快越过重建索引的阈值
+#define TEST_ROUNDS 64 //删除全部键再插入新键的轮数
+#define TEST_GROW 4096 //扩容测试插入的键数，从MAP_INIT_SIZE起扩容多次
+#define TEST_EVICT 4   //淘汰测试的容量，不超过MAP_EVICT_SCAN
+
+static int destroyed; // 值析构函数的调用次数
+static int notified;  // 淘汰回调的调用次数
+static map_t *evicting; // 淘汰回调中自行删除键值对的map，为NULL则不删除
+
+/**
+ * @brief 计数的值析构函数，同一个值被析构两次即为错误
+ *
+ * @param value 值指针
+ */
+static void test_destructor(void *value)
+{
+    destroyed++;
+}
+
+/**
+ * @brief 反复删除全部键再插入新键，使插入越过墓碑阈值触发索引重建，
+ *        检查每个键只被索引一次：大小正确、删除后查不到、析构次数与删除次数一致
+ *
+ * @return int 错误数
+ */
+static int check_rehash()
+{
+    map_t map;
+    int errors = 0;
+    uint32_t next = 0;
+    map_init(&map, sizeof(uint32_t), sizeof(uint32_t), TEST_KEYS, 0, NULL, test_destructor);
+    destroyed = 0;
+    for (int round = 0; round < TEST_ROUNDS; round++)
+    {
+        uint32_t base = next;
+        for (int i = 0; i < TEST_KEYS; i++, next++)
+            if (map_set(&map, &next, &next) != 0 && errors++ < 10)
+                printf("\e[1;31mrehash: round %d, insert %u failed\n", round, next);
+        if (map_size(&map) != TEST_KEYS && errors++ < 10)
+            printf("\e[1;31mrehash: round %d, size %zu after insert\n", round, map_size(&map));
+        for (uint32_t key = base; key < next; key++)
+        {
+            uint32_t *value = map_get(&map, &key);
+            if ((value == NULL || *value != key) && errors++ < 10)
+                printf("\e[1;31mrehash: round %d, key %u lost\n", round, key);
+            map_delete(&map, &key);
+            if (map_get(&map, &key) != NULL && errors++ < 10)
+                printf("\e[1;31mrehash: round %d, key %u still indexed after delete\n", round, key);
+        }
+        if (map_size(&map) != 0 && errors++ < 10)
+            printf("\e[1;31mrehash: round %d, size %zu after delete\n", round, map_size(&map));
+    }
+    if (destroyed != TEST_KEYS * TEST_ROUNDS && errors++ < 10)
+        printf("\e[1;31mrehash: %d values destroyed, expect %d\n", destroyed, TEST_KEYS * TEST_ROUNDS);
+    map_free(&map);
+    printf("\e[0;34mrehash: checked\n");
+    return errors;
+}
+
+/**
+ * @brief 插入每个键后立即取得其值指针，继续插入使map多次扩容，检查先前取得的指针仍指向原来的值
+ *
+ * @return int 错误数
+ */
+static int check_stable()
+{
+    static uint32_t *values[TEST_GROW];
+    map_t map;
+    int errors = 0;
+    map_init(&map, sizeof(uint32_t), sizeof(uint32_t), 0, 0, NULL, NULL);
+    for (uint32_t key = 0; key < TEST_GROW; key++)
+    {
+        uint32_t value = ~key;
+        if (map_set(&map, &key, &value) != 0 || (values[key] = map32_get(&map, key)) == NULL)
+        {
+            printf("\e[1;31mstable: insert %u failed\n", key);
+            map_free(&map);
+            return 1;
+        }
+    }
+    for (uint32_t key = 0; key < TEST_GROW; key++)
+        if ((map_get(&map, &key) != values[key] || *values[key] != ~key) && errors++ < 10)
+            printf("\e[1;31mstable: value of key %u moved after grow\n", key);
+    map_free(&map);
+    printf("\e[0;34mstable: checked\n");
+    return errors;
+}
+
+/**
+ * @brief 淘汰判断，值为奇数的键值对可直接淘汰
+ *
+ * @param key 键指针
+ * @param value 值指针
+ * @return int 可直接淘汰为1
+ */
+static int test_evict_check(void *key, void *value)
+{
+    return *(uint32_t *)value & 1;
+}
+
+/**
+ * @brief 淘汰回调，计数，并按需像tcp的应用那样在回调中自行删除该键值对
+ *
+ * @param key 键指针
+ * @param value 值指针
+ */
+static void test_evict_handler(void *key, void *value)
+{
+    notified++;
+    if (evicting)
+        map_delete(evicting, key);
+}
+
+/**
+ * @brief 填满一个LRU的map后再插入一个键，返回被淘汰的键
+ *
+ * @param map 要测试的map
+ * @param idle 可直接淘汰的键，超出范围则全部不可
+ * @return uint32_t 被淘汰的键，没有淘汰或淘汰了多个为UINT32_MAX
+ */
+static uint32_t evict_one(map_t *map, uint32_t idle)
+{
+    uint32_t evicted = UINT32_MAX;
+    for (uint32_t key = 0; key <= TEST_EVICT; key++)
+    {
+        uint32_t value = 2 * key + (key == idle);
+        if (map_set(map, &key, &value) != 0)
+            return UINT32_MAX;
+    }
+    if (map_size(map) != TEST_EVICT)
+        return UINT32_MAX;
+    for (uint32_t key = 0; key < TEST_EVICT; key++)
+        if (map_get(map, &key) == NULL)
+        {
+            if (evicted != UINT32_MAX)
+                return UINT32_MAX;
+            evicted = key;
+        }
+    return evicted;
+}
+
+/**
+ * @brief 检查淘汰优先选择可直接淘汰的键值对且不通知，都不可时淘汰链表头部并在析构前通知，
+ *        通知中自行删除键值对也只析构一次
+ *
+ * @return int 错误数
+ */
+static int check_evict()
+{
+    int errors = 0;
+    for (int round = 0; round < 3; round++)
+    {
+        map_t map;
+        uint32_t idle = round == 0 ? TEST_EVICT / 2 : UINT32_MAX, expect = round == 0 ? idle : 0;
+        map_init(&map, sizeof(uint32_t), sizeof(uint32_t), TEST_EVICT, 0, NULL, test_destructor);
+        map_set_policy(&map, MAP_EVICT_LRU);
+        map_set_evict_handler(&map, test_evict_check, test_evict_handler);
+        destroyed = notified = 0;
+        evicting = round == 2 ? &map : NULL;
+        uint32_t evicted = evict_one(&map, idle);
+        if (evicted != expect && errors++ < 10)
+            printf("\e[1;31mevict: round %d, key %u evicted, expect %u\n", round, evicted, expect);
+        if ((notified != (round != 0) || destroyed != 1) && errors++ < 10)
+            printf("\e[1;31mevict: round %d, %d notified, %d destroyed\n", round, notified, destroyed);
+        map_free(&map);
+    }
+    printf("\e[0;34mevict: checked\n");
+    return errors;
+}
+
+int main(int argc, char *argv[])
+{
+    int errors = check_rehash() + check_stable() + check_evict();
+    printf(errors ? "\e[1;31mMap test failed, %d errors\e[0m\n" : "\e[1;32mMap test passed\e[0m\n", errors);
+    return errors ? -1 : 0;
+}
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include "net.h"
+#include "pipeline.h"
+#include "driver.h"
+#include "ethernet.h"
+#include "arp.h"
+#include "ip.h"
+#include "icmp.h"
+
+#define TEST_WAIT 1000000  //等待协议线程处理帧的最大轮数
+#define TEST_RECLAIM 10000 //处理后等待帧交还并释放的最大轮数，远短于arp缓存的超时，不会等到协议线程自行释放
+
+static const uint8_t peer_mac[NET_MAC_LEN] = {0x21, 0x32, 0x43, 0x54, 0x65, 0x06};
+static const uint8_t unknown_ip[NET_IP_LEN] = {192, 168, 163, 110}; // 协议线程未学习过的对端
+static int pending;                                                  // 尚未被收走的ping请求数
+static int requests;                                                 // 发出的arp请求数，只有协议线程发送
+
+//测试不收发真实的帧，收包时交出构造的ping请求，发送时统计arp请求
+int driver_open() { return 0; }
+int driver_recv(buf_t *buf) { return 0; }
+int driver_recv_burst(buf_t *bufs, int n) { return 0; }
+void driver_flush() {}
+int driver_caps() { return 0; }
+int driver_mtu() { return ETHERNET_MAX_TRANSPORT_UNIT; }
+int driver_get_fd() { return -1; }
+void driver_close() {}
+
+int driver_send(buf_t *buf)
+{
+    ether_hdr_t *eth = (ether_hdr_t *)buf->data;
+    arp_pkt_t *pkt = (arp_pkt_t *)(eth + 1);
+    if (buf->len >= sizeof(ether_hdr_t) + sizeof(arp_pkt_t) && swap16(eth->protocol16) == NET_PROTOCOL_ARP &&
+        swap16(pkt->opcode16) == ARP_REQUEST && !memcmp(pkt->target_ip, unknown_ip, NET_IP_LEN))
+        __atomic_add_fetch(&requests, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/**
+ * @brief 构造未解析的对端发来的ping请求，帧从收包线程的缓冲池分配
+ *
+ * @param bufs 出口参数，收到的帧
+ * @param n 最多收取的帧数
+ * @return int 收到的帧数
+ */
+int driver_recv_burst_pooled(buf_t *bufs, int n)
+{
+    size_t len = sizeof(ip_hdr_t) + sizeof(icmp_hdr_t) + 32;
+    if (pending == 0 || n < 1 || buf_alloc(bufs, sizeof(ether_hdr_t) + len) == -1)
+        return 0;
+    pending--;
+    memset(bufs->data, 0, bufs->len);
+    ether_hdr_t *eth = (ether_hdr_t *)bufs->data;
+    ip_hdr_t *ip = (ip_hdr_t *)(eth + 1);
+    icmp_hdr_t *icmp = (icmp_hdr_t *)(ip + 1);
+    memcpy(eth->dst, net_stack->if_mac, NET_MAC_LEN);
+    memcpy(eth->src, peer_mac, NET_MAC_LEN);
+    eth->protocol16 = swap16(NET_PROTOCOL_IP);
+    ip->hdr_len = sizeof(ip_hdr_t) / IP_HDR_LEN_PER_BYTE;
+    ip->version = IP_VERSION_4;
+    ip->total_len16 = swap16(len);
+    ip->ttl = IP_DEFALUT_TTL;
+    ip->protocol = NET_PROTOCOL_ICMP;
+    memcpy(ip->src_ip, unknown_ip, NET_IP_LEN);
+    memcpy(ip->dst_ip, net_stack->if_ip, NET_IP_LEN);
+    ip->hdr_checksum16 = checksum16((uint16_t *)ip, sizeof(ip_hdr_t));
+    icmp->type = ICMP_TYPE_ECHO_REQUEST;
+    icmp->id16 = swap16(1);
+    icmp->seq16 = swap16(1);
+    icmp->checksum16 = checksum16((uint16_t *)icmp, len - sizeof(ip_hdr_t));
+    return 1;
+}
+
+/**
+ * @brief 收包线程交给协议线程一个来自未解析对端的ping请求，应答在协议线程的arp缓存中等待解析，
+ *        检查缓存的是协议线程自己的拷贝：帧交还收包线程释放之后，收包线程的缓冲池中不再有被占用的帧
+ *
+ */
+int main(int argc, char *argv[])
+{
+    int errors = 0;
+    buf_pool_stats_t stats;
+    if (net_init() != 0 || pipeline_start(NULL) != 0)
+        return -1;
+    buf_pool_stats(BUF_POOL_MTU, &stats);
+    size_t base = stats.in_use;
+    pending = 1;
+    for (int wait = 0; wait < TEST_WAIT && __atomic_load_n(&requests, __ATOMIC_RELAXED) == 0; wait++)
+    {
+        net_poll();
+        sched_yield();
+    }
+    for (int wait = 0; wait < TEST_RECLAIM; wait++)
+    {
+        net_poll();
+        buf_pool_stats(BUF_POOL_MTU, &stats);
+        if (stats.in_use == base)
+            break;
+        sched_yield();
+    }
+    int n = __atomic_load_n(&requests, __ATOMIC_RELAXED);
+    if (pending || n != 1 || stats.in_use != base)
+    {
+        printf("\e[1;31mparked: %d arp requests (expect 1), %zu rx bufs still in use\n", n, stats.in_use - base);
+        errors++;
+    }
+    pipeline_stop();
+    printf(errors ? "\e[1;31mPipeline test failed, %d errors\e[0m\n" : "\e[1;32mPipeline test passed\e[0m\n", errors);
+    return errors ? -1 : 0;
+}
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include "ring.h"
+
+#define TEST_COUNT 1000000 //每个生产者写入的元素数
+#define TEST_PRODUCERS 4   //多生产者测试的生产者数
+#define TEST_SLOTS 64      //队列槽数，远小于元素数，使生产者经常遇到队列满
+#define TEST_BURST 7       //每次写入与读出的最大元素数，与槽数互质，覆盖回绕
+
+typedef struct test_elem
+{
+    uint32_t producer; // 生产者序号
+    uint32_t seq;      // 该生产者写入的序号
+} test_elem_t;
+
+static ring_t ring;
+
+/**
+ * @brief 生产者线程，按序号写入TEST_COUNT个元素
+ *
+ * @param arg 生产者序号
+ * @return void* 总是NULL
+ */
+static void *producer(void *arg)
+{
+    uint32_t id = (uintptr_t)arg, seq = 0;
+    test_elem_t elems[TEST_BURST];
+    while (seq < TEST_COUNT)
+    {
+        size_t n = TEST_COUNT - seq < TEST_BURST ? TEST_COUNT - seq : TEST_BURST;
+        for (size_t i = 0; i < n; i++)
+            elems[i] = (test_elem_t){id, seq + i};
+        n = id == TEST_PRODUCERS ? ring_push_burst(&ring, elems, n) : ring_mp_push_burst(&ring, elems, n);
+        if (n == 0)
+            sched_yield(); // 测试机的CPU可能少于线程数，不自旋
+        seq += n;
+    }
+    return NULL;
+}
+
+/**
+ * @brief 启动生产者并在当前线程消费，检查每个生产者的元素按写入顺序到达且不丢不重
+ *
+ * @param producers 生产者数，为1时使用单生产者写入
+ * @return int 错误数
+ */
+static int check(int producers)
+{
+    uint32_t next[TEST_PRODUCERS + 1] = {0};
+    pthread_t threads[TEST_PRODUCERS];
+    int errors = 0;
+    if (ring_init(&ring, TEST_SLOTS, sizeof(test_elem_t)) != 0)
+        return 1;
+    for (int i = 0; i < producers; i++)
+        pthread_create(&threads[i], NULL, producer, (void *)(uintptr_t)(producers == 1 ? TEST_PRODUCERS : i));
+    test_elem_t elems[TEST_BURST];
+    for (uint64_t total = 0; total < (uint64_t)producers * TEST_COUNT;)
+    {
+        size_t n = ring_pop_burst(&ring, elems, TEST_BURST);
+        if (n == 0)
+            sched_yield();
+        for (size_t i = 0; i < n; i++)
+        {
+            test_elem_t *elem = &elems[i];
+            if ((elem->producer > TEST_PRODUCERS || elem->seq != next[elem->producer]) && errors++ < 10)
+                printf("\e[1;31m%d producers: got %u:%u, expect seq %u\n", producers, elem->producer, elem->seq,
+                       elem->producer > TEST_PRODUCERS ? 0 : next[elem->producer]);
+            if (elem->producer <= TEST_PRODUCERS)
+                next[elem->producer] = elem->seq + 1;
+        }
+        total += n;
+    }
+    for (int i = 0; i < producers; i++)
+        pthread_join(threads[i], NULL);
+    if (ring_count(&ring) != 0 && errors++ < 10)
+        printf("\e[1;31m%d producers: %zu extra elements\n", producers, ring_count(&ring));
+    ring_free(&ring);
+    printf("\e[0;34m%d producers: checked\n", producers);
+    return errors;
+}
+
+int main(int argc, char *argv[])
+{
+    int errors = check(1) + check(TEST_PRODUCERS);
+    printf(errors ? "\e[1;31mRing test failed, %d errors\e[0m\n" : "\e[1;32mRing test passed\e[0m\n", errors);
+    return errors ? -1 : 0;
+}
@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include "net.h"
+#include "rss.h"
+#include "driver.h"
+#include "ethernet.h"
+#include "ip.h"
+#include "udp.h"
+
+#define BENCH_FLOWS 4096  //不同的udp流数，模拟多流负载
+#define BENCH_PAYLOAD 512 //每个数据报的负载长度，udp_in校验时遍历负载
+#define BENCH_PORT 60000  //接收的端口
+#define BENCH_SEC 1.0     //每种工作线程数的测量时长（秒）
+
+static uint8_t bench_frames[BENCH_FLOWS][sizeof(ether_hdr_t) + sizeof(ip_hdr_t) + sizeof(udp_hdr_t) + BENCH_PAYLOAD];
+static uint64_t bench_sent;
+
+//基准测试不收发真实的帧，驱动只接受发送
+int driver_open() { return 0; }
+int driver_recv(buf_t *buf) { return 0; }
+int driver_recv_burst(buf_t *bufs, int n) { return 0; }
+int driver_recv_burst_pooled(buf_t *bufs, int n) { return 0; }
+int driver_send(buf_t *buf) { return 0; }
+void driver_flush() {}
+int driver_caps() { return 0; }
+int driver_mtu() { return ETHERNET_MAX_TRANSPORT_UNIT; }
+int driver_get_fd() { return -1; }
+void driver_close() {}
+
+/**
+ * @brief 获取单调时钟的秒数
+ *
+ * @return double 秒数
+ */
+static double bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief 构造第i条流的一帧，源地址与源端口随流变化，校验和正确
+ *
+ * @param i 流序号
+ * @param frame 输出的帧
+ */
+static void bench_frame(int i, uint8_t *frame)
+{
+    ether_hdr_t *eth = (ether_hdr_t *)frame;
+    ip_hdr_t *ip = (ip_hdr_t *)(eth + 1);
+    udp_hdr_t *udp = (udp_hdr_t *)(ip + 1);
+    uint8_t *payload = (uint8_t *)(udp + 1);
+    uint16_t len = sizeof(udp_hdr_t) + BENCH_PAYLOAD;
+    for (int k = 0; k < BENCH_PAYLOAD; k++)
+        payload[k] = i + k;
+    uint8_t src_ip[NET_IP_LEN] = {10, 0, i >> 8, i};
+    udp->src_port16 = swap16(1024 + i);
+    udp->dst_port16 = swap16(BENCH_PORT);
+    udp->total_len16 = swap16(len);
+    udp->checksum16 = 0;
+    checksum_ctx_t ctx;
+    checksum_init(&ctx);
+    checksum_pseudo(&ctx, src_ip, net_stack->if_ip, NET_PROTOCOL_UDP, len);
+    checksum_add(&ctx, udp, len);
+    udp->checksum16 = checksum_finish(&ctx);
+    memset(ip, 0, sizeof(ip_hdr_t));
+    ip->version = IP_VERSION_4;
+    ip->hdr_len = sizeof(ip_hdr_t) / IP_HDR_LEN_PER_BYTE;
+    ip->total_len16 = swap16(sizeof(ip_hdr_t) + len);
+    ip->ttl = IP_DEFALUT_TTL;
+    ip->protocol = NET_PROTOCOL_UDP;
+    memcpy(ip->src_ip, src_ip, NET_IP_LEN);
+    memcpy(ip->dst_ip, net_stack->if_ip, NET_IP_LEN);
+    ip->hdr_checksum16 = checksum16((uint16_t *)ip, sizeof(ip_hdr_t));
+    memcpy(eth->dst, net_stack->if_mac, NET_MAC_LEN);
+    memset(eth->src, 0x42, NET_MAC_LEN);
+    eth->protocol16 = swap16(NET_PROTOCOL_IP);
+}
+
+static void bench_handler(uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port)
+{
+}
+
+static void bench_setup(int worker)
+{
+    udp_open(BENCH_PORT, bench_handler);
+}
+
+/**
+ * @brief 汇总全部工作线程的统计
+ *
+ * @param workers 工作线程数
+ * @param total 出口参数，处理与丢弃的总帧数
+ * @param min 出口参数，可为NULL，处理帧数最少的工作线程的帧数
+ * @param max 出口参数，可为NULL，处理帧数最多的工作线程的帧数
+ */
+static void bench_stats(int workers, rss_stats_t *total, uint64_t *min, uint64_t *max)
+{
+    memset(total, 0, sizeof(rss_stats_t));
+    for (int w = 0; w < workers; w++)
+    {
+        rss_stats_t stats;
+        rss_get_stats(w, &stats);
+        total->packets += stats.packets;
+        total->drops += stats.drops;
+        if (min && (w == 0 || stats.packets < *min))
+            *min = stats.packets;
+        if (max && (w == 0 || stats.packets > *max))
+            *max = stats.packets;
+    }
+}
+
+/**
+ * @brief 以当前线程作为收包线程，持续向工作线程分发帧BENCH_SEC秒
+ *        在途的帧不超过全部队列的容量，测量工作线程不丢包时的处理能力
+ *
+ * @param workers 工作线程数
+ */
+static void bench_run(int workers)
+{
+    if (rss_start(workers, bench_setup) != 0)
+        return;
+    buf_t bufs[NET_BURST];
+    rss_stats_t total;
+    uint64_t sent = 0, min, max;
+    double start = bench_now(), elapsed;
+    while ((elapsed = bench_now() - start) < BENCH_SEC)
+    {
+        rss_reclaim();
+        bench_stats(workers, &total, NULL, NULL);
+        if (sent - total.packets - total.drops + NET_BURST > (uint64_t)workers * RSS_RING_SIZE)
+        {
+            sched_yield();
+            continue;
+        }
+        int n = 0;
+        for (; n < NET_BURST; n++) // 在途的帧占满收包线程的缓冲池时，等工作线程交还
+        {
+            uint8_t *frame = bench_frames[(bench_sent + n) % BENCH_FLOWS];
+            if (buf_alloc(&bufs[n], sizeof(bench_frames[0])) == -1)
+                break;
+            memcpy(bufs[n].data, frame, sizeof(bench_frames[0]));
+        }
+        bench_sent += n;
+        sent += n;
+        rss_steer(bufs, n);
+    }
+    bench_stats(workers, &total, &min, &max);
+    rss_stop();
+    printf("%7d %12.0f %12llu %12llu %10.2f\n", workers, total.packets / elapsed, (unsigned long long)sent,
+           (unsigned long long)total.drops, min ? (double)max / min : 0.0);
+}
+
+int main(int argc, char const *argv[])
+{
+    if (net_init() != 0)
+        return -1;
+    for (int i = 0; i < BENCH_FLOWS; i++)
+        bench_frame(i, bench_frames[i]);
+    printf("%d flows, %d bytes payload, %.1fs each\n", BENCH_FLOWS, BENCH_PAYLOAD, BENCH_SEC);
+    printf("%7s %12s %12s %12s %10s\n", "workers", "pps", "sent", "drops", "max/min");
+    for (int workers = 1; workers <= 8; workers *= 2)
+        bench_run(workers);
+    return 0;
+}
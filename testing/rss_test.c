@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include "net.h"
+#include "rss.h"
+#include "map.h"
+#include "driver.h"
+#include "ethernet.h"
+#include "arp.h"
+#include "ip.h"
+#include "icmp.h"
+
+#define TEST_WORKERS 4      //工作线程数，多于1个才能看出重复应答
+#define TEST_WAIT 100000000 //等待工作线程处理完的最大轮数
+#define TEST_RECLAIM 100000 //等待收包线程回收处理完的帧的最大轮数，帧在处理计数增加之后才交还
+
+static const uint8_t peer_ip[NET_IP_LEN] = {192, 168, 163, 10};
+static const uint8_t peer_mac[NET_MAC_LEN] = {0x21, 0x32, 0x43, 0x54, 0x65, 0x06};
+static const uint8_t unknown_ip[NET_IP_LEN] = {192, 168, 163, 110}; // 各工作线程都未学习过的对端
+static net_stack_t *worker_stacks[TEST_WORKERS]; // 各工作线程的协议栈实例，由rss_setup记录
+static int replies;                              // 发出的arp应答数，各工作线程都可能发送
+
+//测试不收发真实的帧，驱动只统计发出的arp应答
+int driver_open() { return 0; }
+int driver_recv(buf_t *buf) { return 0; }
+int driver_recv_burst(buf_t *bufs, int n) { return 0; }
+int driver_recv_burst_pooled(buf_t *bufs, int n) { return 0; }
+void driver_flush() {}
+int driver_caps() { return 0; }
+int driver_mtu() { return ETHERNET_MAX_TRANSPORT_UNIT; }
+int driver_get_fd() { return -1; }
+void driver_close() {}
+
+int driver_send(buf_t *buf)
+{
+    ether_hdr_t *eth = (ether_hdr_t *)buf->data;
+    arp_pkt_t *pkt = (arp_pkt_t *)(eth + 1);
+    if (buf->len >= sizeof(ether_hdr_t) + sizeof(arp_pkt_t) && swap16(eth->protocol16) == NET_PROTOCOL_ARP &&
+        swap16(pkt->opcode16) == ARP_REPLY)
+        __atomic_add_fetch(&replies, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+static void test_setup(int worker)
+{
+    worker_stacks[worker] = net_stack;
+}
+
+/**
+ * @brief 构造对端询问本机mac地址的arp请求
+ *
+ * @param buf 输出的帧，从当前线程的缓冲池分配
+ * @return int 成功为0，失败为-1
+ */
+static int test_request(buf_t *buf)
+{
+    if (buf_alloc(buf, sizeof(ether_hdr_t) + sizeof(arp_pkt_t)) == -1)
+        return -1;
+    ether_hdr_t *eth = (ether_hdr_t *)buf->data;
+    arp_pkt_t *pkt = (arp_pkt_t *)(eth + 1);
+    memset(eth->dst, 0xff, NET_MAC_LEN);
+    memcpy(eth->src, peer_mac, NET_MAC_LEN);
+    eth->protocol16 = swap16(NET_PROTOCOL_ARP);
+    pkt->hw_type16 = swap16(ARP_HW_ETHER);
+    pkt->pro_type16 = swap16(NET_PROTOCOL_IP);
+    pkt->hw_len = NET_MAC_LEN;
+    pkt->pro_len = NET_IP_LEN;
+    pkt->opcode16 = swap16(ARP_REQUEST);
+    memcpy(pkt->sender_mac, peer_mac, NET_MAC_LEN);
+    memcpy(pkt->sender_ip, peer_ip, NET_IP_LEN);
+    memset(pkt->target_mac, 0, NET_MAC_LEN);
+    memcpy(pkt->target_ip, net_stack->if_ip, NET_IP_LEN);
+    return 0;
+}
+
+/**
+ * @brief 构造未解析的对端发来的ping请求
+ *
+ * @param buf 输出的帧，从当前线程的缓冲池分配
+ * @return int 成功为0，失败为-1
+ */
+static int test_echo(buf_t *buf)
+{
+    size_t len = sizeof(ip_hdr_t) + sizeof(icmp_hdr_t) + 32;
+    if (buf_alloc(buf, sizeof(ether_hdr_t) + len) == -1)
+        return -1;
+    memset(buf->data, 0, buf->len);
+    ether_hdr_t *eth = (ether_hdr_t *)buf->data;
+    ip_hdr_t *ip = (ip_hdr_t *)(eth + 1);
+    icmp_hdr_t *icmp = (icmp_hdr_t *)(ip + 1);
+    memcpy(eth->dst, net_stack->if_mac, NET_MAC_LEN);
+    memcpy(eth->src, peer_mac, NET_MAC_LEN);
+    eth->protocol16 = swap16(NET_PROTOCOL_IP);
+    ip->hdr_len = sizeof(ip_hdr_t) / IP_HDR_LEN_PER_BYTE;
+    ip->version = IP_VERSION_4;
+    ip->total_len16 = swap16(len);
+    ip->ttl = IP_DEFALUT_TTL;
+    ip->protocol = NET_PROTOCOL_ICMP;
+    memcpy(ip->src_ip, unknown_ip, NET_IP_LEN);
+    memcpy(ip->dst_ip, net_stack->if_ip, NET_IP_LEN);
+    ip->hdr_checksum16 = checksum16((uint16_t *)ip, sizeof(ip_hdr_t));
+    icmp->type = ICMP_TYPE_ECHO_REQUEST;
+    icmp->id16 = swap16(1);
+    icmp->seq16 = swap16(1);
+    icmp->checksum16 = checksum16((uint16_t *)icmp, len - sizeof(ip_hdr_t));
+    return 0;
+}
+
+/**
+ * @brief 工作线程处理完的帧总数
+ *
+ * @return uint64_t 帧数
+ */
+static uint64_t test_packets()
+{
+    uint64_t packets = 0;
+    for (int w = 0; w < TEST_WORKERS; w++)
+    {
+        rss_stats_t stats;
+        rss_get_stats(w, &stats);
+        packets += stats.packets;
+    }
+    return packets;
+}
+
+/**
+ * @brief 向未解析的对端回应ping时，应答在工作线程的arp缓存中等待解析，
+ *        检查缓存的是工作线程自己的拷贝：收包线程回收之后，其缓冲池中不再有被占用的帧
+ *
+ * @return int 错误数
+ */
+static int check_parked()
+{
+    buf_t buf;
+    buf_pool_stats_t stats;
+    buf_pool_stats(BUF_POOL_MTU, &stats);
+    size_t base = stats.in_use;
+    uint64_t packets = test_packets();
+    if (test_echo(&buf) != 0)
+        return 1;
+    rss_steer(&buf, 1);
+    int wait = 0;
+    while (test_packets() == packets && ++wait < TEST_WAIT)
+    {
+        rss_reclaim();
+        sched_yield();
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    size_t parked = 0;
+    for (int w = 0; w < TEST_WORKERS; w++)
+        parked += map_size(&worker_stacks[w]->arp_buf);
+    for (wait = 0; wait < TEST_RECLAIM; wait++)
+    {
+        rss_reclaim();
+        buf_pool_stats(BUF_POOL_MTU, &stats);
+        if (stats.in_use == base)
+            break;
+        sched_yield();
+    }
+    if (parked != 1 || stats.in_use != base)
+    {
+        printf("\e[1;31mparked: %zu replies parked (expect 1), %zu rx bufs still in use\n", parked, stats.in_use - base);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 向TEST_WORKERS个工作线程分发一个arp请求，检查每个工作线程都学习了对端的映射，且只应答一次，
+ *        再检查向未解析的对端回应的ping不与收包线程共享缓冲池中的帧
+ *
+ * @return int 错误数
+ */
+int main(int argc, char const *argv[])
+{
+    int errors = 0;
+    buf_t buf;
+    if (net_init() != 0 || rss_start(TEST_WORKERS, test_setup) != 0)
+        return -1;
+    if (test_request(&buf) != 0)
+    {
+        rss_stop();
+        return -1;
+    }
+    rss_steer(&buf, 1);
+    for (int w = 0; w < TEST_WORKERS; w++)
+    {
+        rss_stats_t stats;
+        int wait = 0;
+        do
+        {
+            rss_reclaim();
+            rss_get_stats(w, &stats);
+            sched_yield();
+        } while (stats.packets + stats.drops == 0 && ++wait < TEST_WAIT);
+        // packets在处理完之后才增加，此后空闲的工作线程不再访问arp表
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        uint64_t packets = stats.packets;
+        if (packets != 1 || map32_get(&worker_stacks[w]->arp_table, map32_key(peer_ip)) == NULL)
+        {
+            printf("\e[1;31mworker %d: %llu packets, mapping %s\n", w, (unsigned long long)packets,
+                   packets ? "not learned" : "not delivered");
+            errors++;
+        }
+    }
+    errors += check_parked();
+    rss_stop();
+    int n = __atomic_load_n(&replies, __ATOMIC_RELAXED);
+    if (n != 1)
+    {
+        printf("\e[1;31m%d workers sent %d arp replies, expect 1\n", TEST_WORKERS, n);
+        errors++;
+    }
+    printf(errors ? "\e[1;31mRss test failed, %d errors\e[0m\n" : "\e[1;32mRss test passed\e[0m\n", errors);
+    return errors ? -1 : 0;
+}